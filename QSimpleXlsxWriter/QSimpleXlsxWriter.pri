@@ -18,12 +18,24 @@ INCLUDEPATH += \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}
 
 HEADERS += \
-$${SIMPLE_XLSX_WRITER_PARENTPATH}XMLWriter.hpp
-$${SIMPLE_XLSX_WRITER_PARENTPATH}UTF8Encoder.hpp
-$${SIMPLE_XLSX_WRITER_PARENTPATH}PathManager.hpp
+$${SIMPLE_XLSX_WRITER_PARENTPATH}XMLWriter.hpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}UTF8Encoder.hpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}PathManager.hpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}Compression.hpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}NumberFormatter.hpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}OutputSink.hpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}PartStore.hpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}StaticPart.hpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}TaskPool.hpp
 
 SOURCES += \
-$${SIMPLE_XLSX_WRITER_PARENTPATH}PathManager.cpp
+$${SIMPLE_XLSX_WRITER_PARENTPATH}PathManager.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}NumberFormatter.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}OutputSink.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}PartStore.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}StaticPart.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}TaskPool.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}XMLWriter.cpp
 
 # simplexlsx-code/Xlsx
 
@@ -34,6 +46,9 @@ HEADERS += \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Chart.h \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Chartsheet.h \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Drawing.h \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Records.h \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/RowBlock.h \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/SharedStrings.h \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/SimpleXlsxDef.h \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Workbook.h \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Worksheet.h \
@@ -43,6 +58,8 @@ SOURCES += \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Chart.cpp \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Chartsheet.cpp \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Drawing.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/RowBlock.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/SharedStrings.cpp \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/SimpleXlsxDef.cpp \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Workbook.cpp \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Xlsx/Worksheet.cpp \
@@ -70,7 +87,15 @@ HEADERS += \
 $${SIMPLE_XLSX_WRITER_PARENTPATH}Zip/zip.h
 
 SOURCES += \
-$${SIMPLE_XLSX_WRITER_PARENTPATH}Zip/zip.cpp
+$${SIMPLE_XLSX_WRITER_PARENTPATH}Zip/zip.cpp \
+$${SIMPLE_XLSX_WRITER_PARENTPATH}Zip/zipcodec.cpp
+
+# deflate engines of other libraries (see ZipSetCodec in zip.h), and the default one
+# DEFINES += ZIP_WITH_ZLIB
+# LIBS += -lz
+# DEFINES += ZIP_WITH_LIBDEFLATE
+# LIBS += -ldeflate
+# DEFINES += ZIP_CODEC_DEFAULT=ZIP_CODEC_ZLIB
 
 
 
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+#include <Zip/zip.h>
+
+// Microbenchmark of the crc-32 of the zip items: the bytewise table loop which was used
+// before against ZipCrc32 (PCLMULQDQ or slicing-by-16, see Zip/zip.h; build the library
+// with ZIP_NO_PCLMUL to measure the slicing), and the share of it in adding a stored item.
+
+static unsigned long Table[ 256 ];
+
+static unsigned long BytewiseCrc32( unsigned long crc, const unsigned char * buf, size_t len )
+{
+    crc = crc ^ 0xffffffffUL;
+    while( len-- ) crc = Table[ ( crc ^ * buf++ ) & 0xff ] ^ ( crc >> 8 );
+    return crc ^ 0xffffffffUL;
+}
+
+static double Seconds( clock_t Start )
+{
+    return double( clock() - Start ) / CLOCKS_PER_SEC;
+}
+
+int main( int argc, char * argv[] )
+{
+    const size_t Size = ( ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 256 ) << 20;
+    const unsigned int Piece = 16384;   // as the zip reads its input
+    const int Repeat = 4;
+
+    for( unsigned long n = 0; n < 256; n++ )
+    {
+        unsigned long c = n;
+        for( int k = 0; k < 8; k++ ) c = ( c & 1 ) ? 0xedb88320UL ^ ( c >> 1 ) : c >> 1;
+        Table[ n ] = c;
+    }
+    std::vector<unsigned char> Data( Size );
+    srand( 1 );
+    for( size_t i = 0; i < Size; i++ ) Data[ i ] = ( unsigned char )rand();
+
+    unsigned long Expected = 0, Crc = 0;
+    clock_t Start = clock();
+    for( int r = 0; r < Repeat; r++ ) Expected = BytewiseCrc32( 0, & Data[ 0 ], Size );
+    const double Bytewise = Seconds( Start );
+
+    Start = clock();
+    for( int r = 0; r < Repeat; r++ ) Crc = ZipCrc32( 0, & Data[ 0 ], ( unsigned int )Size );
+    const double Whole = Seconds( Start );
+    if( Crc != Expected ) return printf( "ZipCrc32 mismatch: %08lx instead of %08lx\n", Crc, Expected ), 1;
+
+    Start = clock();
+    for( int r = 0; r < Repeat; r++ )
+    {
+        Crc = 0;
+        for( size_t i = 0; i < Size; i += Piece ) Crc = ZipCrc32( Crc, & Data[ i ], ( unsigned int )( Size - i < Piece ? Size - i : Piece ) );
+    }
+    const double Pieces = Seconds( Start );
+    if( Crc != Expected ) return printf( "ZipCrc32 by pieces mismatch: %08lx instead of %08lx\n", Crc, Expected ), 1;
+
+    const double MB = double( Size ) * Repeat / ( 1 << 20 );
+    printf( "bytewise table:          %8.0f MB/s\n", MB / Bytewise );
+    printf( "ZipCrc32:                %8.0f MB/s\n", MB / Whole );
+    printf( "ZipCrc32, 16 KiB pieces: %8.0f MB/s\n", MB / Pieces );
+
+    Start = clock();
+    HZIP hz = CreateZip( "CRC32.zip", NULL );
+    ZipSetLevel( hz, ZIP_LEVEL_STORE );
+    ZRESULT res = ZipAdd( hz, "data.bin", & Data[ 0 ], ( unsigned int )Size );
+    CloseZip( hz );
+    const double Store = Seconds( Start );
+    remove( "CRC32.zip" );
+    if( res != ZR_OK ) return printf( "ZipAdd failed: %lx\n", res ), 1;
+    printf( "stored item:             %8.0f MB/s, crc %.0f%% of it (%.0f%% before)\n", Size / Store / ( 1 << 20 ),
+            100 * Pieces / Repeat / Store, 100 * Bytewise / Repeat / ( Store - Pieces / Repeat + Bytewise / Repeat ) );
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <Xlsx/Chart.h>
+#include <Xlsx/Workbook.h>
+
+// Benchmark of workbooks produced on several threads at once: every thread builds its own
+// workbooks and saves them into memory, one after another. Reports the aggregate throughput
+// as the number of threads grows, up to twice the number of CPUs.
+// The first argument sets the number of workbooks of every thread, the second the rows of every workbook.
+
+using namespace SimpleXlsx;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Worker
+{
+    size_t      Books, Rows;
+    unsigned    Seed;
+    size_t      Failed, Bytes;
+};
+
+// Pseudo-random numbers of the thread (rand() is shared by all threads)
+static inline unsigned Next( unsigned & Seed )
+{
+    Seed = Seed * 1103515245 + 12345;
+    return ( Seed >> 16 ) & 0x7FFF;
+}
+
+static void Produce( Worker * Work )
+{
+    static const char * Items[] = { "Alpha", "Bravo", "Charlie", "Delta", "Echo", "Foxtrot", "Golf", "Hotel" };
+    std::vector<char> Data;
+    for( size_t i = 0; i < Work->Books; i++ )
+    {
+        CWorkbook Book( "Concurrent" );
+        Book.SetSaveThreads( 1 );
+        Style style;
+        style.numFormat.numberStyle = NUMSTYLE_MONEY;
+        const size_t Money = Book.AddStyle( style );
+        CWorksheet & Sheet = Book.AddSheet( "Report" );
+        for( size_t r = 0; r < Work->Rows; r++ )
+        {
+            const int Quantity = Next( Work->Seed ) % 100;
+            const double Price = Next( Work->Seed ) % 10000 / 100.0;
+            Sheet.BeginRow().AddCell( Items[ Next( Work->Seed ) % 8 ] ).AddCell( Quantity );
+            Sheet.AddCell( Price, Money ).AddCell( Quantity * Price, Money ).EndRow();
+        }
+        CChart::Series Series;
+        Series.valSheet = & Sheet;
+        Series.valAxisFrom = CellCoord( 1, 3 );
+        Series.valAxisTo = CellCoord( ( uint32_t )Work->Rows, 3 );
+        Book.AddChart( Sheet, DrawingPoint( 6, 1 ), DrawingPoint( 14, 16 ) ).AddSeries( Series );
+        if( Book.Save( Data ) ) Work->Bytes += Data.size();
+        else Work->Failed++;
+    }
+}
+
+static bool Measure( unsigned Threads, size_t Books, size_t Rows )
+{
+    std::vector<Worker> Works( Threads );
+    std::vector<std::thread> Pool;
+    Clock::time_point Start = Clock::now();
+    for( unsigned i = 0; i < Threads; i++ )
+    {
+        Worker & Work = Works[ i ];
+        Work.Books = Books;
+        Work.Rows = Rows;
+        Work.Seed = i + 1;
+        Work.Failed = Work.Bytes = 0;
+        Pool.push_back( std::thread( Produce, & Work ) );
+    }
+    size_t Failed = 0, Bytes = 0;
+    for( unsigned i = 0; i < Threads; i++ )
+    {
+        Pool[ i ].join();
+        Failed += Works[ i ].Failed;
+        Bytes += Works[ i ].Bytes;
+    }
+    const double Time = std::chrono::duration<double>( Clock::now() - Start ).count();
+    printf( "%7u %10.3f %12.0f %12.1f\n", Threads, Time, Threads * Books / Time, Bytes / Time / 1048576 );
+    if( Failed != 0 ) printf( "%u saves failed\n", ( unsigned )Failed );
+    return Failed == 0;
+}
+
+int main( int argc, char * argv[] )
+{
+    const size_t Books = ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 200;
+    const size_t Rows = ( argc > 2 ) ? strtoul( argv[ 2 ], NULL, 10 ) : 200;
+    const unsigned CPUs = std::thread::hardware_concurrency();
+    printf( "%u workbooks of %u rows per thread, %u CPUs\n", ( unsigned )Books, ( unsigned )Rows, CPUs );
+    printf( "threads   time (s) workbooks/s       MiB/s\n" );
+    for( unsigned Threads = 1; Threads <= ( CPUs > 1 ? CPUs * 2 : 2 ); Threads *= 2 )
+        if( ! Measure( Threads, Books, Rows ) ) return 1;
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Xlsx/Workbook.h>
+#include <Zip/zip.h>
+
+// Deflate benchmark on real sheet XML: reports the speed and the ratio of every level
+// of every deflate engine compiled in (see ZipSetCodec), then of the built-in one on
+// several threads (see ZipSetThreads).
+// The XML is that of a generated sheet (the first argument sets its rows), or the file
+// given as the second argument, e.g. a sheet extracted from a workbook.
+
+using namespace SimpleXlsx;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Seconds( Clock::time_point Start )
+{
+    return std::chrono::duration<double>( Clock::now() - Start ).count();
+}
+
+static bool ReadFile( const char * Name, std::vector<char> & Data )
+{
+    FILE * File = fopen( Name, "rb" );
+    if( File == NULL ) return false;
+    char Buffer[ 65536 ];
+    size_t Read;
+    while( ( Read = fread( Buffer, 1, sizeof( Buffer ), File ) ) > 0 ) Data.insert( Data.end(), Buffer, Buffer + Read );
+    fclose( File );
+    return true;
+}
+
+static unsigned int LE( const unsigned char * Ptr, int Bytes )
+{
+    unsigned int Value = 0;
+    for( int i = Bytes - 1; i >= 0; i-- ) Value = ( Value << 8 ) | Ptr[ i ];
+    return Value;
+}
+
+// Saves a workbook with the parts stored and takes the sheet XML out of the archive
+static bool MakeSheetXML( size_t Rows, std::vector<char> & XML )
+{
+    static const char * Names[] = { "Alpha", "Bravo", "Charlie", "Delta", "Echo", "Foxtrot", "Golf", "Hotel" };
+    {
+        CWorkbook Book( "Deflate" );
+        Book.SetCompression( COMPRESSION_STORE );
+        std::vector<ColumnWidth> Widths;
+        CWorksheet & Sheet = Book.AddSheet( "Data", Widths );
+        Style DateStyle;
+        DateStyle.numFormat.numberStyle = NUMSTYLE_DATETIME;
+        const size_t DateStyleIndex = Book.AddStyle( DateStyle );
+        srand( 1 );
+        for( size_t r = 0; r < Rows; r++ )
+        {
+            char Code[ 16 ];
+            sprintf( Code, "ID-%06u", ( unsigned )( rand() % 100000 ) );
+            Sheet.BeginRow();
+            Sheet.AddCell( ( uint32_t )r ).AddCell( Code ).AddCell( Names[ rand() % 8 ] );
+            Sheet.AddCell( rand() % 10000 / 100.0 ).AddCell( ( int32_t )( rand() % 1000 - 500 ) );
+            Sheet.AddCell( CellDataTime( ( time_t )( 1600000000 + r * 60 ), DateStyleIndex ) ).AddCell( "=D1*E1" );
+            Sheet.EndRow();
+        }
+        if( ! Book.Save( "Deflate.xlsx" ) ) return false;
+    }
+    std::vector<char> Archive;
+    bool Found = ReadFile( "Deflate.xlsx", Archive );
+    remove( "Deflate.xlsx" );
+    const char * Name = "xl/worksheets/sheet1.xml";
+    const unsigned char * Data = reinterpret_cast<const unsigned char *>( Archive.data() );
+    for( size_t i = 0; Found && ( i + 30 < Archive.size() ); )
+    {
+        const unsigned int Size = LE( Data + i + 18, 4 ), NameLength = LE( Data + i + 26, 2 ), ExtraLength = LE( Data + i + 28, 2 );
+        if( LE( Data + i, 4 ) != 0x04034b50 ) break;
+        const size_t Start = i + 30 + NameLength + ExtraLength;
+        if( ( NameLength == strlen( Name ) ) && ( memcmp( Data + i + 30, Name, NameLength ) == 0 ) )
+        {
+            XML.assign( Archive.begin() + Start, Archive.begin() + Start + Size );
+            return true;
+        }
+        i = Start + Size;
+    }
+    return false;
+}
+
+static bool Measure( std::vector<char> & XML, int Codec, unsigned Threads, int Level )
+{
+    Clock::time_point Start = Clock::now();
+    HZIP hz = CreateZip( "Deflate.zip", NULL );
+    ZipSetCodec( hz, Codec );
+    ZipSetThreads( hz, Threads );
+    ZipSetLevel( hz, Level );
+    ZRESULT Result = ZipAdd( hz, "sheet1.xml", XML.data(), ( unsigned int )XML.size() );
+    CloseZip( hz );
+    const double Time = Seconds( Start );
+    std::vector<char> Archive;
+    ReadFile( "Deflate.zip", Archive );
+    remove( "Deflate.zip" );
+    if( Result != ZR_OK ) return printf( "ZipAdd failed: %lx\n", Result ), false;
+    const double MB = XML.size() / double( 1 << 20 );
+    if( Threads > 1 ) printf( "%-7u", Threads );
+    else printf( "       " );
+    printf( "%9d %8.1f %8.2f %12lu\n", Level, MB / Time, double( XML.size() ) / Archive.size(), ( unsigned long )Archive.size() );
+    return true;
+}
+
+int main( int argc, char * argv[] )
+{
+    const size_t Rows = ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 200000;
+    std::vector<char> XML;
+    if( ( argc > 2 ) ? ! ReadFile( argv[ 2 ], XML ) : ! MakeSheetXML( Rows, XML ) )
+        return printf( "No XML\n" ), 1;
+    const double MB = XML.size() / double( 1 << 20 );
+    printf( "%.1f MB of XML\n", MB );
+
+    static const char * Codecs[] = { "builtin", "zlib", "libdeflate" };
+    for( int Codec = ZIP_CODEC_BUILTIN; Codec <= ZIP_CODEC_LIBDEFLATE; Codec++ )
+    {
+        if( ! CWorkbook::IsCompressionCodecAvailable( Codec ) ) continue;
+        printf( "%-10s level     MB/s    ratio   compressed\n", Codecs[ Codec ] );
+        for( int Level = 1; Level <= 9; Level++ )
+            if( ! Measure( XML, Codec, 1, Level ) ) return 1;
+    }
+
+    const unsigned CPUs = std::thread::hardware_concurrency();
+    printf( "builtin, %u CPUs\nthreads    level     MB/s    ratio   compressed\n", CPUs );
+    for( unsigned Threads = 2; Threads <= ( CPUs > 2 ? CPUs : 2 ); Threads *= 2 )
+        for( int Level = 1; Level <= 9; Level += 4 )
+            if( ! Measure( XML, ZIP_CODEC_BUILTIN, Threads, Level ) ) return 1;
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <thread>
+
+#include <Xlsx/Chart.h>
+#include <Xlsx/Workbook.h>
+
+// Save benchmark of a workbook with many sheets and charts: reports the time of Save
+// on one thread and on several (see CWorkbook::SetSaveThreads).
+// The first argument sets the number of sheets, the second the rows of every sheet.
+
+using namespace SimpleXlsx;
+
+typedef std::chrono::steady_clock Clock;
+
+static bool Measure( unsigned Threads, size_t Sheets, size_t Rows )
+{
+    static const char * Names[] = { "Alpha", "Bravo", "Charlie", "Delta", "Echo", "Foxtrot", "Golf", "Hotel" };
+    CWorkbook Book( "ParallelSave" );
+    Book.SetSaveThreads( Threads );
+    srand( 1 );
+    for( size_t s = 0; s < Sheets; s++ )
+    {
+        char Title[ 32 ];
+        sprintf( Title, "Sheet %u", ( unsigned )( s + 1 ) );
+        CWorksheet & Sheet = Book.AddSheet( Title );
+        for( size_t r = 0; r < Rows; r++ )
+        {
+            Sheet.BeginRow();
+            Sheet.AddCell( ( uint32_t )r ).AddCell( Names[ rand() % 8 ] ).AddCell( rand() % 10000 / 100.0 );
+            Sheet.AddCell( ( int32_t )( rand() % 1000 - 500 ) ).AddCell( "=C1*D1" );
+            Sheet.EndRow();
+        }
+        CChart & Chart = Book.AddChart( Sheet, DrawingPoint( 6, 1 ), DrawingPoint( 14, 16 ) );
+        CChart::Series Series;
+        Series.valSheet = & Sheet;
+        Series.valAxisFrom = CellCoord( 1, 2 );
+        Series.valAxisTo = CellCoord( ( uint32_t )( Rows < 100 ? Rows : 100 ), 2 );
+        Chart.AddSeries( Series );
+    }
+    Clock::time_point Start = Clock::now();
+    if( ! Book.Save( "ParallelSave.xlsx" ) ) return printf( "Save failed\n" ), false;
+    const double Time = std::chrono::duration<double>( Clock::now() - Start ).count();
+    remove( "ParallelSave.xlsx" );
+    printf( "%7u %10.3f\n", Threads, Time );
+    return true;
+}
+
+int main( int argc, char * argv[] )
+{
+    const size_t Sheets = ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 48;
+    const size_t Rows = ( argc > 2 ) ? strtoul( argv[ 2 ], NULL, 10 ) : 5000;
+    const unsigned CPUs = std::thread::hardware_concurrency();
+    printf( "%u sheets of %u rows, %u CPUs\nthreads   save (s)\n", ( unsigned )Sheets, ( unsigned )Rows, CPUs );
+    for( unsigned Threads = 1; Threads <= ( CPUs > 2 ? CPUs : 2 ); Threads *= 2 )
+        if( ! Measure( Threads, Sheets, Rows ) ) return 1;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <Xlsx/Workbook.h>
+
+// Benchmark of a workbook which sheets are filled on several threads at once: the sheets are
+// added on the main thread, then every thread fills its share of them. The strings of all
+// sheets go into the common shared strings table. Reports the time of filling and saving
+// as the number of threads grows, up to twice the number of CPUs.
+// The first argument sets the number of sheets, the second the rows of every sheet.
+
+using namespace SimpleXlsx;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Filler
+{
+    std::vector<CWorksheet *>   Sheets;
+    size_t                      Rows;
+};
+
+static void FillSheets( Filler * Work )
+{
+    static const char * Items[] = { "Alpha", "Bravo", "Charlie", "Delta", "Echo", "Foxtrot", "Golf", "Hotel" };
+    char Customer[ 32 ], Order[ 32 ];
+    for( size_t s = 0; s < Work->Sheets.size(); s++ )
+    {
+        CWorksheet & Sheet = * Work->Sheets[ s ];
+        const unsigned Index = ( unsigned )Sheet.GetIndex();
+        for( size_t r = 0; r < Work->Rows; r++ )
+        {
+            // a few hundred customers are repeated on all sheets, every order is unique
+            sprintf( Customer, "Customer %u", ( unsigned )( ( r * 7 + Index ) % 500 ) );
+            sprintf( Order, "Order %u-%u", Index, ( unsigned )r );
+            Sheet.BeginRow().AddCell( Customer ).AddCell( Order ).AddCell( Items[ r % 8 ] );
+            Sheet.AddCell( ( uint32_t )r ).AddCell( r * 0.25 ).EndRow();
+        }
+    }
+}
+
+static bool Measure( unsigned Threads, size_t Sheets, size_t Rows )
+{
+    CWorkbook Book( "ParallelSheets" );
+    std::vector<Filler> Works( Threads );
+    for( size_t s = 0; s < Sheets; s++ )
+    {
+        char Title[ 32 ];
+        sprintf( Title, "Sheet %u", ( unsigned )( s + 1 ) );
+        Works[ s % Threads ].Sheets.push_back( & Book.AddSheet( Title ) );
+    }
+
+    Clock::time_point Start = Clock::now();
+    std::vector<std::thread> Pool;
+    for( unsigned i = 0; i < Threads; i++ )
+    {
+        Works[ i ].Rows = Rows;
+        Pool.push_back( std::thread( FillSheets, & Works[ i ] ) );
+    }
+    for( unsigned i = 0; i < Threads; i++ )
+        Pool[ i ].join();
+    const double FillTime = std::chrono::duration<double>( Clock::now() - Start ).count();
+
+    Start = Clock::now();
+    std::vector<char> Data;
+    if( ! Book.Save( Data ) ) return printf( "Save failed\n" ), false;
+    const double SaveTime = std::chrono::duration<double>( Clock::now() - Start ).count();
+    printf( "%7u %10.3f %12.0f %10.3f\n", Threads, FillTime, Sheets * Rows / FillTime, SaveTime );
+    return true;
+}
+
+int main( int argc, char * argv[] )
+{
+    const size_t Sheets = ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 32;
+    const size_t Rows = ( argc > 2 ) ? strtoul( argv[ 2 ], NULL, 10 ) : 20000;
+    const unsigned CPUs = std::thread::hardware_concurrency();
+    printf( "%u sheets of %u rows, %u CPUs\nthreads   fill (s)       rows/s   save (s)\n", ( unsigned )Sheets, ( unsigned )Rows, CPUs );
+    for( unsigned Threads = 1; Threads <= ( CPUs > 1 ? CPUs * 2 : 2 ); Threads *= 2 )
+        if( ! Measure( Threads, Sheets, Rows ) ) return 1;
+    return 0;
+}
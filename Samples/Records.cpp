@@ -0,0 +1,81 @@
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <Xlsx/Records.h>
+#include <Xlsx/Workbook.h>
+
+using namespace SimpleXlsx;
+
+struct Trade
+{
+    int64_t     id;
+    std::string ticker;
+    uint32_t    quantity;
+    double      price;
+    float       fee;
+    const char * side;
+};
+
+// describes the fields written as cells of a row, in that order
+XLSX_RECORD( Trade, id, ticker, quantity, price, fee, side )
+
+static double Seconds( clock_t Start )
+{
+    return double( clock() - Start ) / CLOCKS_PER_SEC;
+}
+
+int main( int argc, char * argv[] )
+{
+    const size_t Count = ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 200000;
+
+    static const char * Tickers[] = { "AAPL", "MSFT", "GOOG", "AMZN", "NVDA", "META", "TSLA", "ORCL" };
+    std::vector<Trade> Trades( Count );
+    srand( 1 );
+    for( size_t i = 0; i < Count; i++ )
+    {
+        Trades[ i ].id = 1000000000LL + i;
+        Trades[ i ].ticker = Tickers[ rand() % 8 ];
+        Trades[ i ].quantity = 1 + rand() % 1000;
+        Trades[ i ].price = ( rand() % 1000000 ) / 100.0;
+        Trades[ i ].fee = ( rand() % 1000 ) / 8.0f;
+        Trades[ i ].side = ( rand() % 2 ) ? "Buy" : "Sell";
+    }
+
+    CWorkbook book( "Incognito" );
+
+    Style style;
+    style.numFormat.numberStyle = NUMSTYLE_MONEY;
+    const size_t MoneyStyleIndex = book.AddStyle( style );
+
+    std::vector<size_t> Styles( 6, 0 );
+    Styles[ 3 ] = MoneyStyleIndex;
+    Styles[ 4 ] = MoneyStyleIndex;
+
+    // the usual way: a cell by a cell
+    CWorksheet & Manual = book.AddSheet( "Manual" );
+    clock_t Start = clock();
+    for( size_t i = 0; i < Count; i++ )
+    {
+        const Trade & T = Trades[ i ];
+        Manual.BeginRow();
+        Manual.AddCell( T.id ).AddCell( T.ticker ).AddCell( T.quantity );
+        Manual.AddCell( T.price, MoneyStyleIndex ).AddCell( T.fee, MoneyStyleIndex ).AddCell( T.side );
+        Manual.EndRow();
+    }
+    const double ManualTime = Seconds( Start );
+
+    // the serializer generated by XLSX_RECORD
+    CWorksheet & Records = book.AddSheet( "Records" );
+    Start = clock();
+    Records.AddRecords( Trades, Styles );
+    const double RecordsTime = Seconds( Start );
+
+    printf( "%u rows: BeginRow/AddCell/EndRow %.3f s, AddRecords %.3f s\n", unsigned( Count ), ManualTime, RecordsTime );
+
+    if( book.Save( "Records.xlsx" ) ) std::cout << "The book has been saved successfully" << std::endl;
+    else std::cout << "The book saving has been failed" << std::endl;
+
+    return 0;
+}
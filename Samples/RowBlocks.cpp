@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <Xlsx/Workbook.h>
+
+// Benchmark of a single worksheet which rows are produced by several threads at once:
+// every thread takes the next block of rows (see CRowBlock), formats it and submits it,
+// the sheet writes the blocks in the row order. Reports the time of filling the sheet
+// row by row on the main thread, and with the blocks as the number of threads grows.
+// The first argument sets the number of rows, the second the rows of a block.
+
+using namespace SimpleXlsx;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Producer
+{
+    CWorksheet          *   Sheet;
+    size_t                  Blocks, BlockRows;
+    std::atomic<size_t> *   NextBlock;
+};
+
+static const char * Items[] = { "Alpha", "Bravo", "Charlie", "Delta", "Echo", "Foxtrot", "Golf", "Hotel" };
+
+template<typename Target>
+static void AddRow( Target & Sheet, uint32_t Row )
+{
+    char Order[ 32 ];
+    sprintf( Order, "Order %u", Row );
+    Sheet.BeginRow().AddCell( Order ).AddCell( Items[ Row % 8 ] ).AddCell( Row ).AddCell( Row * 0.25 ).EndRow();
+}
+
+static void ProduceBlocks( Producer * Work )
+{
+    while( ( * Work->NextBlock )++ < Work->Blocks )
+    {
+        // the block reserves the next rows of the sheet and submits them when it is destroyed
+        CRowBlock Block( * Work->Sheet, ( uint32_t )Work->BlockRows );
+        for( uint32_t r = 0; r < Block.RowCount(); r++ )
+            AddRow( Block, Block.FirstRow() + r );
+    }
+}
+
+static bool Measure( unsigned Threads, size_t Rows, size_t BlockRows )
+{
+    CWorkbook Book( "RowBlocks" );
+    CWorksheet & Sheet = Book.AddSheet( "Orders" );
+    Clock::time_point Start = Clock::now();
+    if( Threads == 0 )
+        for( uint32_t r = 1; r <= Rows; r++ )
+            AddRow( Sheet, r );
+    else
+    {
+        std::atomic<size_t> NextBlock( 0 );
+        Producer Work = { & Sheet, Rows / BlockRows, BlockRows, & NextBlock };
+        std::vector<std::thread> Pool;
+        for( unsigned i = 0; i < Threads; i++ )
+            Pool.push_back( std::thread( ProduceBlocks, & Work ) );
+        for( unsigned i = 0; i < Threads; i++ )
+            Pool[ i ].join();
+    }
+    const double Time = std::chrono::duration<double>( Clock::now() - Start ).count();
+
+    std::vector<char> Data;
+    if( ! Book.Save( Data ) ) return printf( "Save failed\n" ), false;
+    if( Threads == 0 ) printf( "   rows %10.3f %12.0f\n", Time, Rows / Time );
+    else printf( "%7u %10.3f %12.0f\n", Threads, Time, Rows / Time );
+    return true;
+}
+
+int main( int argc, char * argv[] )
+{
+    const size_t BlockRows = ( argc > 2 ) ? strtoul( argv[ 2 ], NULL, 10 ) : 4096;
+    // whole blocks only
+    const size_t Rows = ( ( ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 1000000 ) + BlockRows - 1 ) / BlockRows * BlockRows;
+    const unsigned CPUs = std::thread::hardware_concurrency();
+    printf( "%u rows, blocks of %u rows, %u CPUs\nthreads   fill (s)       rows/s\n", ( unsigned )Rows, ( unsigned )BlockRows, CPUs );
+    if( ! Measure( 0, Rows, BlockRows ) ) return 1;
+    for( unsigned Threads = 1; Threads <= ( CPUs > 1 ? CPUs * 2 : 2 ); Threads *= 2 )
+        if( ! Measure( Threads, Rows, BlockRows ) ) return 1;
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include <Xlsx/Chart.h>
+#include <Xlsx/Workbook.h>
+
+// Benchmark of many small similar workbooks: every one has the same styles, sheet layout,
+// caption row and charts, and its own rows. They are saved into memory either built from
+// scratch, or made from a template (see CWorkbookTemplate) which has the common structure.
+// The first argument sets the number of workbooks, the second the rows of every workbook.
+
+using namespace SimpleXlsx;
+
+typedef std::chrono::steady_clock Clock;
+
+static size_t Bold, Money;
+
+// The common structure: styles, sheets, the caption row, charts and a defined name
+static void Build( CWorkbook & Book )
+{
+    static const char * Captions[] = { "Customer", "Item", "Quantity", "Price", "Amount" };
+    Style style;
+    style.font.attributes = FONT_BOLD;
+    Bold = Book.AddStyle( style );
+    style.font.attributes = FONT_NORMAL;
+    style.numFormat.numberStyle = NUMSTYLE_MONEY;
+    Money = Book.AddStyle( style );
+
+    std::vector<ColumnWidth> Widths;
+    Widths.push_back( ColumnWidth( 0, 1, 24 ) );
+    Widths.push_back( ColumnWidth( 2, 4, 12 ) );
+    CWorksheet & Sheet = Book.AddSheet( "Report", 0, 1, Widths );
+    Sheet.BeginRow();
+    for( size_t i = 0; i < 5; i++ ) Sheet.AddCell( Captions[ i ], Bold );
+    Sheet.EndRow();
+    Book.AddSheet( "Notes" ).AddSimpleRow( "Generated by the report server" );
+
+    CChart::Series Series;
+    Series.valSheet = & Sheet;
+    Series.valAxisFrom = CellCoord( 2, 4 );
+    Series.valAxisTo = CellCoord( 100, 4 );
+    Book.AddChart( Sheet, DrawingPoint( 6, 1 ), DrawingPoint( 14, 16 ) ).AddSeries( Series );
+    Book.AddChartSheet( "Amounts" ).Chart().AddSeries( Series );
+    Book.AddDefinedName( "Amounts", Sheet, CellCoord( 2, 4 ), CellCoord( 100, 4 ) );
+}
+
+// The rows of one workbook
+static void AddRows( CWorkbook & Book, size_t Rows )
+{
+    static const char * Items[] = { "Alpha", "Bravo", "Charlie", "Delta", "Echo", "Foxtrot", "Golf", "Hotel" };
+    CWorksheet & Sheet = Book.GetSheet( 0 );
+    for( size_t r = 0; r < Rows; r++ )
+    {
+        const int Quantity = rand() % 100;
+        const double Price = rand() % 10000 / 100.0;
+        Sheet.BeginRow().AddCell( "Customer" ).AddCell( Items[ rand() % 8 ] ).AddCell( Quantity );
+        Sheet.AddCell( Price, Money ).AddCell( Quantity * Price, Money ).EndRow();
+    }
+}
+
+int main( int argc, char * argv[] )
+{
+    const size_t Books = ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 1000;
+    const size_t Rows = ( argc > 2 ) ? strtoul( argv[ 2 ], NULL, 10 ) : 50;
+    std::vector<char> Data;
+    printf( "%u workbooks of %u rows\n", ( unsigned )Books, ( unsigned )Rows );
+
+    srand( 1 );
+    Clock::time_point Start = Clock::now();
+    for( size_t i = 0; i < Books; i++ )
+    {
+        CWorkbook Book( "Report" );
+        Build( Book );
+        AddRows( Book, Rows );
+        if( ! Book.Save( Data ) ) return printf( "Save failed\n" ), 1;
+    }
+    const double Scratch = std::chrono::duration<double>( Clock::now() - Start ).count();
+    printf( "from scratch  %8.3f s  %8.0f workbooks/s  %u bytes\n", Scratch, Books / Scratch, ( unsigned )Data.size() );
+
+    srand( 1 );
+    Start = Clock::now();
+    CWorkbook Prototype( "Report" );
+    Build( Prototype );
+    CWorkbookTemplate Template( Prototype );
+    if( ! Template.IsOk() ) return printf( "Template failed\n" ), 1;
+    for( size_t i = 0; i < Books; i++ )
+    {
+        CWorkbook Book( Template, "Report" );
+        AddRows( Book, Rows );
+        if( ! Book.Save( Data ) ) return printf( "Save failed\n" ), 1;
+    }
+    const double Templated = std::chrono::duration<double>( Clock::now() - Start ).count();
+    printf( "from template %8.3f s  %8.0f workbooks/s  %u bytes\n", Templated, Books / Templated, ( unsigned )Data.size() );
+    return 0;
+}
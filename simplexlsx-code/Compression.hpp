@@ -0,0 +1,49 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_COMPRESSION_HPP
+#define XLSX_COMPRESSION_HPP
+
+namespace SimpleXlsx
+{
+
+/// @brief  Compression of the parts inside the xlsx archive, deflate levels 1 (fastest) to 9 (smallest) are accepted too
+enum ECompression
+{
+    COMPRESSION_ADAPTIVE = -1,  ///< the level is chosen by compressing a sample of each part
+    COMPRESSION_STORE = 0,      ///< no compression
+    COMPRESSION_FAST = 1,
+    COMPRESSION_DEFAULT = 8,
+    COMPRESSION_BEST = 9
+};
+
+/// @brief  Deflate engine of the xlsx archive, the ones of the other libraries exist if they are compiled in
+enum ECompressionCodec
+{
+    CODEC_DEFAULT = -1,     ///< the one the library is built with, the built-in one unless configured otherwise
+    CODEC_BUILTIN = 0,      ///< the deflate of the zip code
+    CODEC_ZLIB = 1,         ///< zlib
+    CODEC_LIBDEFLATE = 2    ///< libdeflate, compresses each part in one shot
+};
+
+}
+
+#endif // XLSX_COMPRESSION_HPP
@@ -0,0 +1,375 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <limits>
+
+#include "NumberFormatter.hpp"
+
+namespace SimpleXlsx
+{
+const char NumberFormatter::DigitPairs[ 201 ] =
+    "00010203040506070809" "10111213141516171819" "20212223242526272829" "30313233343536373839" "40414243444546474849"
+    "50515253545556575859" "60616263646566676869" "70717273747576777879" "80818283848586878889" "90919293949596979899";
+
+//Grisu2 algorithm: "Printing Floating-Point Numbers Quickly and Accurately with Integers", Florian Loitsch, 2010.
+namespace
+{
+//Floating point number f * 2^e with 64-bit significand
+struct DiyFp
+{
+    uint64_t    f;
+    int         e;
+
+    inline DiyFp( uint64_t F, int E ) : f( F ), e( E ) {}
+
+    static inline DiyFp Sub( const DiyFp & x, const DiyFp & y )
+    {
+        return DiyFp( x.f - y.f, x.e );
+    }
+
+    //Product rounded to 64 bits
+    static inline DiyFp Mul( const DiyFp & x, const DiyFp & y )
+    {
+        const uint64_t LoMask = 0xFFFFFFFFu;
+        const uint64_t xLo = x.f & LoMask, xHi = x.f >> 32;
+        const uint64_t yLo = y.f & LoMask, yHi = y.f >> 32;
+        const uint64_t LoLo = xLo * yLo, LoHi = xLo * yHi, HiLo = xHi * yLo, HiHi = xHi * yHi;
+        uint64_t Middle = ( LoLo >> 32 ) + ( LoHi & LoMask ) + ( HiLo & LoMask );
+        Middle += uint64_t( 1 ) << 31;
+        return DiyFp( HiHi + ( LoHi >> 32 ) + ( HiLo >> 32 ) + ( Middle >> 32 ), x.e + y.e + 64 );
+    }
+
+    static inline DiyFp Normalize( DiyFp x )
+    {
+        while( ( x.f >> 63 ) == 0 )
+        {
+            x.f <<= 1;
+            x.e--;
+        }
+        return x;
+    }
+
+    static inline DiyFp NormalizeTo( const DiyFp & x, int TargetE )
+    {
+        return DiyFp( x.f << ( x.e - TargetE ), TargetE );
+    }
+};
+
+struct CachedPower
+{
+    uint64_t    f;
+    int         e;
+    int         k;
+};
+
+//Normalized 10^k for k = -300, -292, ..., 324
+const CachedPower CachedPowers[] =
+{
+    { 0xAB70FE17C79AC6CA, -1060,  -300 },
+    { 0xFF77B1FCBEBCDC4F, -1034,  -292 },
+    { 0xBE5691EF416BD60C, -1007,  -284 },
+    { 0x8DD01FAD907FFC3C,  -980,  -276 },
+    { 0xD3515C2831559A83,  -954,  -268 },
+    { 0x9D71AC8FADA6C9B5,  -927,  -260 },
+    { 0xEA9C227723EE8BCB,  -901,  -252 },
+    { 0xAECC49914078536D,  -874,  -244 },
+    { 0x823C12795DB6CE57,  -847,  -236 },
+    { 0xC21094364DFB5637,  -821,  -228 },
+    { 0x9096EA6F3848984F,  -794,  -220 },
+    { 0xD77485CB25823AC7,  -768,  -212 },
+    { 0xA086CFCD97BF97F4,  -741,  -204 },
+    { 0xEF340A98172AACE5,  -715,  -196 },
+    { 0xB23867FB2A35B28E,  -688,  -188 },
+    { 0x84C8D4DFD2C63F3B,  -661,  -180 },
+    { 0xC5DD44271AD3CDBA,  -635,  -172 },
+    { 0x936B9FCEBB25C996,  -608,  -164 },
+    { 0xDBAC6C247D62A584,  -582,  -156 },
+    { 0xA3AB66580D5FDAF6,  -555,  -148 },
+    { 0xF3E2F893DEC3F126,  -529,  -140 },
+    { 0xB5B5ADA8AAFF80B8,  -502,  -132 },
+    { 0x87625F056C7C4A8B,  -475,  -124 },
+    { 0xC9BCFF6034C13053,  -449,  -116 },
+    { 0x964E858C91BA2655,  -422,  -108 },
+    { 0xDFF9772470297EBD,  -396,  -100 },
+    { 0xA6DFBD9FB8E5B88F,  -369,   -92 },
+    { 0xF8A95FCF88747D94,  -343,   -84 },
+    { 0xB94470938FA89BCF,  -316,   -76 },
+    { 0x8A08F0F8BF0F156B,  -289,   -68 },
+    { 0xCDB02555653131B6,  -263,   -60 },
+    { 0x993FE2C6D07B7FAC,  -236,   -52 },
+    { 0xE45C10C42A2B3B06,  -210,   -44 },
+    { 0xAA242499697392D3,  -183,   -36 },
+    { 0xFD87B5F28300CA0E,  -157,   -28 },
+    { 0xBCE5086492111AEB,  -130,   -20 },
+    { 0x8CBCCC096F5088CC,  -103,   -12 },
+    { 0xD1B71758E219652C,   -77,    -4 },
+    { 0x9C40000000000000,   -50,     4 },
+    { 0xE8D4A51000000000,   -24,    12 },
+    { 0xAD78EBC5AC620000,     3,    20 },
+    { 0x813F3978F8940984,    30,    28 },
+    { 0xC097CE7BC90715B3,    56,    36 },
+    { 0x8F7E32CE7BEA5C70,    83,    44 },
+    { 0xD5D238A4ABE98068,   109,    52 },
+    { 0x9F4F2726179A2245,   136,    60 },
+    { 0xED63A231D4C4FB27,   162,    68 },
+    { 0xB0DE65388CC8ADA8,   189,    76 },
+    { 0x83C7088E1AAB65DB,   216,    84 },
+    { 0xC45D1DF942711D9A,   242,    92 },
+    { 0x924D692CA61BE758,   269,   100 },
+    { 0xDA01EE641A708DEA,   295,   108 },
+    { 0xA26DA3999AEF774A,   322,   116 },
+    { 0xF209787BB47D6B85,   348,   124 },
+    { 0xB454E4A179DD1877,   375,   132 },
+    { 0x865B86925B9BC5C2,   402,   140 },
+    { 0xC83553C5C8965D3D,   428,   148 },
+    { 0x952AB45CFA97A0B3,   455,   156 },
+    { 0xDE469FBD99A05FE3,   481,   164 },
+    { 0xA59BC234DB398C25,   508,   172 },
+    { 0xF6C69A72A3989F5C,   534,   180 },
+    { 0xB7DCBF5354E9BECE,   561,   188 },
+    { 0x88FCF317F22241E2,   588,   196 },
+    { 0xCC20CE9BD35C78A5,   614,   204 },
+    { 0x98165AF37B2153DF,   641,   212 },
+    { 0xE2A0B5DC971F303A,   667,   220 },
+    { 0xA8D9D1535CE3B396,   694,   228 },
+    { 0xFB9B7CD9A4A7443C,   720,   236 },
+    { 0xBB764C4CA7A44410,   747,   244 },
+    { 0x8BAB8EEFB6409C1A,   774,   252 },
+    { 0xD01FEF10A657842C,   800,   260 },
+    { 0x9B10A4E5E9913129,   827,   268 },
+    { 0xE7109BFBA19C0C9D,   853,   276 },
+    { 0xAC2820D9623BF429,   880,   284 },
+    { 0x80444B5E7AA7CF85,   907,   292 },
+    { 0xBF21E44003ACDD2D,   933,   300 },
+    { 0x8E679C2F5E44FF8F,   960,   308 },
+    { 0xD433179D9C8CB841,   986,   316 },
+    { 0x9E19DB92B4E31BA9,  1013,   324 }
+};
+const int CachedPowersMinDecExp = -300;
+const int CachedPowersDecStep = 8;
+
+//Range of the binary exponent of the scaled number, so that its integral part fits into 32 bits
+const int Alpha = -60;
+
+//Returns c = 10^k, such that Alpha <= e_c + e + 64 <= Gamma
+inline const CachedPower & GetCachedPower( int e )
+{
+    const int f = Alpha - e - 1;
+    const int k = ( f * 78913 ) / ( 1 << 18 ) + static_cast<int>( f > 0 );  // ceil( f * log10( 2 ) )
+    const int Index = ( k - CachedPowersMinDecExp + CachedPowersDecStep - 1 ) / CachedPowersDecStep;
+    return CachedPowers[ Index ];
+}
+
+//Returns the number of decimal digits of n and the largest power of 10 not greater than n
+inline int FindLargestPow10( uint32_t n, uint32_t & Pow10 )
+{
+    int Digits = 1;
+    Pow10 = 1;
+    while( ( Digits < 10 ) && ( n / Pow10 >= 10 ) )
+    {
+        Pow10 *= 10;
+        Digits++;
+    }
+    return Digits;
+}
+
+//Moves the last digit towards the exact value while it stays inside the rounding interval
+inline void Round( char * Buffer, int Length, uint64_t Dist, uint64_t Delta, uint64_t Rest, uint64_t TenK )
+{
+    while( ( Rest < Dist ) && ( Delta - Rest >= TenK ) &&
+            ( ( Rest + TenK < Dist ) || ( Dist - Rest > Rest + TenK - Dist ) ) )
+    {
+        Buffer[ Length - 1 ]--;
+        Rest += TenK;
+    }
+}
+
+//Generates the shortest digits of a number from the interval (MMinus, MPlus) close to w
+void DigitGen( char * Buffer, int & Length, int & DecExp, const DiyFp & MMinus, const DiyFp & w, const DiyFp & MPlus )
+{
+    const DiyFp One( uint64_t( 1 ) << -MPlus.e, MPlus.e );
+
+    uint64_t Delta = DiyFp::Sub( MPlus, MMinus ).f;
+    uint64_t Dist = DiyFp::Sub( MPlus, w ).f;
+
+    uint32_t p1 = static_cast<uint32_t>( MPlus.f >> -One.e );  // integral part
+    uint64_t p2 = MPlus.f & ( One.f - 1 );                      // fractional part
+
+    uint32_t Pow10;
+    int n = FindLargestPow10( p1, Pow10 );
+    while( n > 0 )
+    {
+        const uint32_t Digit = p1 / Pow10;
+        p1 %= Pow10;
+        Buffer[ Length++ ] = static_cast<char>( '0' + Digit );
+        n--;
+        const uint64_t Rest = ( uint64_t( p1 ) << -One.e ) + p2;
+        if( Rest <= Delta )
+        {
+            DecExp += n;
+            Round( Buffer, Length, Dist, Delta, Rest, uint64_t( Pow10 ) << -One.e );
+            return;
+        }
+        Pow10 /= 10;
+    }
+
+    int m = 0;
+    for( ;; )
+    {
+        p2 *= 10;
+        const uint64_t Digit = p2 >> -One.e;
+        p2 &= One.f - 1;
+        Buffer[ Length++ ] = static_cast<char>( '0' + Digit );
+        m++;
+        Delta *= 10;
+        Dist *= 10;
+        if( p2 <= Delta ) break;
+    }
+    DecExp -= m;
+    Round( Buffer, Length, Dist, Delta, p2, One.f );
+}
+
+//Shortest digits of the positive finite Value, which is read back as the same FloatType.
+//The value is Buffer * 10^DecExp.
+template <typename FloatType, typename BitsType>
+void Grisu2( FloatType Value, char * Buffer, int & Length, int & DecExp )
+{
+    const int Precision = std::numeric_limits<FloatType>::digits;  // including the hidden bit
+    const int Bias = std::numeric_limits<FloatType>::max_exponent - 1 + ( Precision - 1 );
+    const uint64_t HiddenBit = uint64_t( 1 ) << ( Precision - 1 );
+
+    BitsType Bits;
+    memcpy( & Bits, & Value, sizeof( Bits ) );
+    const uint64_t F = Bits & ( HiddenBit - 1 );
+    const int E = static_cast<int>( Bits >> ( Precision - 1 ) );
+
+    const DiyFp v = ( E == 0 ) ? DiyFp( F, 1 - Bias ) : DiyFp( F + HiddenBit, E - Bias );
+    //The lower neighbour is closer for the powers of two (except the smallest normalized exponent)
+    const bool LowerIsCloser = ( F == 0 ) && ( E > 1 );
+    const DiyFp MPlus = DiyFp::Normalize( DiyFp( 2 * v.f + 1, v.e - 1 ) );
+    const DiyFp MMinus = DiyFp::NormalizeTo( LowerIsCloser ? DiyFp( 4 * v.f - 1, v.e - 2 ) : DiyFp( 2 * v.f - 1, v.e - 1 ), MPlus.e );
+
+    const CachedPower & Cached = GetCachedPower( MPlus.e );
+    const DiyFp c( Cached.f, Cached.e );
+    const DiyFp w = DiyFp::Mul( DiyFp::Normalize( v ), c );
+    const DiyFp wMinus = DiyFp::Mul( MMinus, c );
+    const DiyFp wPlus = DiyFp::Mul( MPlus, c );
+
+    Length = 0;
+    DecExp = -Cached.k;
+    //Shrink the interval by one ulp to be safe with the rounding errors of Mul
+    DigitGen( Buffer, Length, DecExp, DiyFp( wMinus.f + 1, wMinus.e ), w, DiyFp( wPlus.f - 1, wPlus.e ) );
+}
+
+//Places the decimal point: fixed notation for decimal exponents -4..16 (as %.17g), scientific one for others
+size_t FormatDigits( char * Buffer, int Length, int DecExp )
+{
+    const int Point = Length + DecExp;  // position of the decimal point relative to the first digit
+    if( ( Point > 0 ) && ( Point <= 17 ) )
+    {
+        if( DecExp >= 0 )               // integer: 1234000
+        {
+            memset( Buffer + Length, '0', DecExp );
+            return Point;
+        }
+        memmove( Buffer + Point + 1, Buffer + Point, Length - Point );  // 12.34
+        Buffer[ Point ] = '.';
+        return Length + 1;
+    }
+    if( ( Point <= 0 ) && ( Point > -4 ) )  // 0.001234
+    {
+        memmove( Buffer + 2 - Point, Buffer, Length );
+        Buffer[ 0 ] = '0';
+        Buffer[ 1 ] = '.';
+        memset( Buffer + 2, '0', -Point );
+        return Length + 2 - Point;
+    }
+
+    size_t Result = Length;             // 1.234e+56
+    if( Length > 1 )
+    {
+        memmove( Buffer + 2, Buffer + 1, Length - 1 );
+        Buffer[ 1 ] = '.';
+        Result++;
+    }
+    int Exp = Point - 1;
+    Buffer[ Result++ ] = 'e';
+    Buffer[ Result++ ] = Exp < 0 ? '-' : '+';
+    if( Exp < 0 ) Exp = -Exp;
+    if( Exp >= 100 ) Buffer[ Result++ ] = static_cast<char>( '0' + Exp / 100 );
+    Buffer[ Result++ ] = static_cast<char>( '0' + Exp / 10 % 10 );
+    Buffer[ Result++ ] = static_cast<char>( '0' + Exp % 10 );
+    return Result;
+}
+
+template <typename FloatType, typename BitsType>
+size_t FormatFloat( FloatType Value, char * Buffer )
+{
+    if( Value != Value )
+    {
+        memcpy( Buffer, "nan", 3 );
+        return 3;
+    }
+    char * Ptr = Buffer;
+    if( Value < 0 )
+    {
+        * Ptr++ = '-';
+        Value = -Value;
+    }
+    if( Value > std::numeric_limits<FloatType>::max() )
+    {
+        memcpy( Ptr, "inf", 3 );
+        return Ptr - Buffer + 3;
+    }
+    if( Value == 0 )
+    {
+        * Buffer = '0';
+        return 1;
+    }
+    int Length, DecExp;
+    Grisu2<FloatType, BitsType>( Value, Ptr, Length, DecExp );
+    return Ptr - Buffer + FormatDigits( Ptr, Length, DecExp );
+}
+}
+
+// ****************************************************************************
+/// @brief  Writes the shortest text which is read back into the same double
+/// @param  Value number to be written
+/// @param  Buffer buffer of NumberFormatter::BufferSize chars at least
+/// @return Number of written chars (without terminating zero)
+// ****************************************************************************
+size_t NumberFormatter::Format( double Value, char * Buffer )
+{
+    return FormatFloat<double, uint64_t>( Value, Buffer );
+}
+
+// ****************************************************************************
+/// @brief  Writes the shortest text which is read back into the same float
+/// @param  Value number to be written
+/// @param  Buffer buffer of NumberFormatter::BufferSize chars at least
+/// @return Number of written chars (without terminating zero)
+// ****************************************************************************
+size_t NumberFormatter::Format( float Value, char * Buffer )
+{
+    return FormatFloat<float, uint32_t>( Value, Buffer );
+}
+
+}
@@ -0,0 +1,94 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_NUMBERFORMATTER_HPP
+#define XLSX_NUMBERFORMATTER_HPP
+
+#include <cstddef>
+#include <cstring>
+
+#include <stdint.h>
+
+namespace SimpleXlsx
+{
+
+// ****************************************************************************
+/// @brief  Locale independent conversion of numbers into the text of XML.
+///         Integers are converted by pairs of digits, floating point numbers
+///         are converted into the shortest text which is read back into the
+///         same value (Grisu2), so that the output is the same on all platforms.
+// ****************************************************************************
+class NumberFormatter
+{
+    public:
+        static const size_t BufferSize = 32;    ///< enough for any number, including the terminating zero
+        typedef char TBuffer[ BufferSize ];
+
+        //Writes the number into the buffer (without terminating zero). Returns the number of written chars.
+        static inline size_t Format( uint64_t Value, char * Buffer )
+        {
+            const size_t Length = DigitCount( Value );
+            char * Ptr = Buffer + Length;
+            while( Value >= 100 )
+            {
+                const size_t Pair = static_cast<size_t>( Value % 100 ) * 2;
+                Value /= 100;
+                Ptr -= 2;
+                memcpy( Ptr, & DigitPairs[ Pair ], 2 );
+            }
+            if( Value >= 10 )
+                memcpy( Ptr - 2, & DigitPairs[ Value * 2 ], 2 );
+            else
+                * --Ptr = static_cast<char>( '0' + Value );
+            return Length;
+        }
+
+        static inline size_t Format( int64_t Value, char * Buffer )
+        {
+            if( Value >= 0 ) return Format( static_cast<uint64_t>( Value ), Buffer );
+            * Buffer = '-';
+            return Format( 0 - static_cast<uint64_t>( Value ), Buffer + 1 ) + 1;
+        }
+
+        static size_t Format( double Value, char * Buffer );
+        static size_t Format( float Value, char * Buffer );
+
+    private:
+        static const char DigitPairs[ 201 ];    ///< "00" "01" ... "99"
+
+        static inline size_t DigitCount( uint64_t Value )
+        {
+            size_t Result = 1;
+            for( ;; )
+            {
+                if( Value < 10 ) return Result;
+                if( Value < 100 ) return Result + 1;
+                if( Value < 1000 ) return Result + 2;
+                if( Value < 10000 ) return Result + 3;
+                Value /= 10000;
+                Result += 4;
+            }
+        }
+};
+
+}
+
+#endif // XLSX_NUMBERFORMATTER_HPP
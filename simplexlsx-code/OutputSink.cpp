@@ -0,0 +1,270 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "OutputSink.hpp"
+
+#include "Zip/zip.h"
+
+namespace SimpleXlsx
+{
+// ****************************************************************************
+/// @brief  Creates (or truncates) the file
+/// @param  FileName path to the file
+// ****************************************************************************
+FileSink::FileSink( const std::string & FileName ) : m_OwnDescriptor( true )
+{
+#ifdef _WIN32
+    m_Descriptor = _open( FileName.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE );
+#else
+    m_Descriptor = open( FileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+#endif
+}
+
+// ****************************************************************************
+/// @brief  Writes into the opened file descriptor
+/// @param  Descriptor file descriptor opened for writing
+/// @param  OwnDescriptor close the descriptor in the destructor
+// ****************************************************************************
+FileSink::FileSink( int Descriptor, bool OwnDescriptor ) : m_Descriptor( Descriptor ), m_OwnDescriptor( OwnDescriptor )
+{
+}
+
+FileSink::~FileSink()
+{
+    if( m_OwnDescriptor && ( m_Descriptor >= 0 ) )
+#ifdef _WIN32
+        _close( m_Descriptor );
+#else
+        close( m_Descriptor );
+#endif
+}
+
+bool FileSink::Write( const char * Data, size_t Size )
+{
+    if( m_Descriptor < 0 ) return false;
+    while( Size > 0 )
+    {
+        const unsigned int Portion = Size > 0x40000000 ? 0x40000000 : static_cast<unsigned int>( Size );
+#ifdef _WIN32
+        const int Written = _write( m_Descriptor, Data, Portion );
+#else
+        const ssize_t Written = write( m_Descriptor, Data, Portion );
+        if( ( Written < 0 ) && ( errno == EINTR ) ) continue;
+#endif
+        if( Written <= 0 ) return false;
+        Data += Written;
+        Size -= Written;
+    }
+    return true;
+}
+
+ZipSink::~ZipSink()
+{
+    Close();
+}
+
+bool ZipSink::Write( const char * Data, size_t Size )
+{
+    if( m_Failed ) return false;
+    while( Size > 0 )
+    {
+        const unsigned int Portion = Size > 0x40000000 ? 0x40000000 : static_cast<unsigned int>( Size );
+        if( ZipAddStreamWrite( ( HZIP )m_Archive, Data, Portion ) != ZR_OK )
+        {
+            m_Failed = true;
+            return false;
+        }
+        Data += Portion;
+        Size -= Portion;
+    }
+    return true;
+}
+
+// ****************************************************************************
+/// @brief  Finishes the archive item
+/// @return false if the item has not been written completely
+// ****************************************************************************
+bool ZipSink::Close()
+{
+    if( ! m_Closed )
+    {
+        m_Closed = true;    // the item is finished even after a failed write, so the archive is not left in it
+        if( ZipAddStreamEnd( ( HZIP )m_Archive ) != ZR_OK ) m_Failed = true;
+    }
+    return ! m_Failed;
+}
+
+//Blocks of AsyncSink and the synchronization with the background thread
+struct AsyncSink::Queue
+{
+    std::mutex                          Mutex;
+    std::condition_variable             Ready;      ///< a block is queued or the end is requested
+    std::condition_variable             Released;   ///< a block is returned into the free list
+    std::deque<std::vector<char> *>     Blocks;     ///< blocks waiting for the target
+    std::vector<std::vector<char> *>    FreeBlocks; ///< written blocks to be reused
+    size_t                              Allocated;  ///< number of the existing blocks
+    size_t                              MaxBlocks;  ///< limit of the existing blocks
+    bool                                Stop;       ///< no more blocks will be queued
+    bool                                Failed;     ///< the target has failed to write a block
+    std::thread                         Thread;
+};
+
+// ****************************************************************************
+/// @brief  Starts the background thread
+/// @param  Target sink to be written in the background, it is deleted by the destructor
+/// @param  MaxQueued limit of the queued data size in bytes
+/// @param  BlockSize size of a queued block
+// ****************************************************************************
+AsyncSink::AsyncSink( OutputSink * Target, size_t MaxQueued, size_t BlockSize ) :
+    m_Target( Target ), m_Queue( new Queue ), m_Current( NULL ), m_BlockSize( BlockSize )
+{
+    m_Queue->Allocated = 0;
+    m_Queue->MaxBlocks = MaxQueued / BlockSize;
+    if( m_Queue->MaxBlocks < 2 ) m_Queue->MaxBlocks = 2;    // one is being filled while another one is being written
+    m_Queue->Stop = false;
+    m_Queue->Failed = ! m_Target->IsOk();
+    m_Queue->Thread = std::thread( & AsyncSink::Run, this );
+}
+
+// ****************************************************************************
+/// @brief  Waits until all the queued data is written and deletes the target
+// ****************************************************************************
+AsyncSink::~AsyncSink()
+{
+    Close();
+    for( std::vector<std::vector<char> *>::const_iterator it = m_Queue->FreeBlocks.begin(); it != m_Queue->FreeBlocks.end(); it++ )
+        delete * it;
+    delete m_Current;
+    delete m_Queue;
+    delete m_Target;
+}
+
+bool AsyncSink::Write( const char * Data, size_t Size )
+{
+    while( Size > 0 )
+    {
+        if( m_Current == NULL )
+        {
+            std::unique_lock<std::mutex> Lock( m_Queue->Mutex );
+            while( m_Queue->FreeBlocks.empty() && ( m_Queue->Allocated == m_Queue->MaxBlocks ) && ! m_Queue->Failed )
+                m_Queue->Released.wait( Lock );   // back pressure: the target is slower than the writer
+            if( m_Queue->Failed ) return false;
+            if( ! m_Queue->FreeBlocks.empty() )
+            {
+                m_Current = m_Queue->FreeBlocks.back();
+                m_Queue->FreeBlocks.pop_back();
+            }
+            else
+            {
+                m_Queue->Allocated++;
+                Lock.unlock();
+                m_Current = new std::vector<char>;
+                m_Current->reserve( m_BlockSize );
+            }
+        }
+
+        const size_t Portion = std::min( Size, m_BlockSize - m_Current->size() );
+        m_Current->insert( m_Current->end(), Data, Data + Portion );
+        Data += Portion;
+        Size -= Portion;
+        if( m_Current->size() == m_BlockSize ) Submit();
+    }
+    return true;
+}
+
+bool AsyncSink::IsOk() const
+{
+    std::lock_guard<std::mutex> Lock( m_Queue->Mutex );
+    return ! m_Queue->Failed;
+}
+
+// ****************************************************************************
+/// @brief  Waits until all the queued data is written and closes the target
+/// @return false if the target has failed to write or to finish the data
+// ****************************************************************************
+bool AsyncSink::Close()
+{
+    if( m_Queue->Thread.joinable() )
+    {
+        Submit();
+        {
+            std::lock_guard<std::mutex> Lock( m_Queue->Mutex );
+            m_Queue->Stop = true;
+        }
+        m_Queue->Ready.notify_one();
+        m_Queue->Thread.join();
+    }
+    return m_Target->Close() && ! m_Queue->Failed;
+}
+
+//Queues the current block
+void AsyncSink::Submit()
+{
+    if( m_Current == NULL ) return;
+    {
+        std::lock_guard<std::mutex> Lock( m_Queue->Mutex );
+        m_Queue->Blocks.push_back( m_Current );
+    }
+    m_Current = NULL;
+    m_Queue->Ready.notify_one();
+}
+
+//Background thread: writes the queued blocks into the target
+void AsyncSink::Run()
+{
+    std::unique_lock<std::mutex> Lock( m_Queue->Mutex );
+    for( ;; )
+    {
+        while( m_Queue->Blocks.empty() && ! m_Queue->Stop )
+            m_Queue->Ready.wait( Lock );
+        if( m_Queue->Blocks.empty() ) break;    // stopped and all the blocks are written
+
+        std::vector<char> * Block = m_Queue->Blocks.front();
+        m_Queue->Blocks.pop_front();
+        bool Failed = m_Queue->Failed;
+        Lock.unlock();
+
+        if( ! Failed && ! m_Target->Write( Block->data(), Block->size() ) ) Failed = true;
+        Block->clear();
+
+        Lock.lock();
+        m_Queue->FreeBlocks.push_back( Block );
+        m_Queue->Failed = Failed;
+        m_Queue->Released.notify_one();
+    }
+}
+
+}
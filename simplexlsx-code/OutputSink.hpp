@@ -0,0 +1,220 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_OUTPUTSINK_HPP
+#define XLSX_OUTPUTSINK_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace SimpleXlsx
+{
+
+// ****************************************************************************
+/// @brief  Destination of the data written by XMLWriter.
+///         XMLWriter formats the XML into its own buffer and passes it to the sink in large blocks.
+// ****************************************************************************
+class OutputSink
+{
+    public:
+        virtual ~OutputSink() {}
+
+        //Writes the block of data. Returns false if the data can not be written.
+        virtual bool Write( const char * Data, size_t Size ) = 0;
+
+        //Returns false if the sink can not accept data
+        virtual bool IsOk() const
+        {
+            return true;
+        }
+
+        //Finishes the output after the last Write (e.g. the archive item).
+        //Returns false if the data is not complete. It may be called more than once.
+        virtual bool Close()
+        {
+            return IsOk();
+        }
+};
+
+// ****************************************************************************
+/// @brief  Writes into the file descriptor
+// ****************************************************************************
+class FileSink : public OutputSink
+{
+    public:
+        //Creates (or truncates) the file. The descriptor is closed by the destructor.
+        explicit FileSink( const std::string & FileName );
+        //Writes into the opened descriptor. It is closed by the destructor only if OwnDescriptor is true.
+        explicit FileSink( int Descriptor, bool OwnDescriptor = false );
+        virtual ~FileSink();
+
+        virtual bool Write( const char * Data, size_t Size );
+        virtual bool IsOk() const
+        {
+            return m_Descriptor >= 0;
+        }
+
+    private:
+        //Disable copy and assignment
+        FileSink( const FileSink & that );
+        FileSink & operator=( const FileSink & );
+
+        int     m_Descriptor;       ///< file descriptor, -1 if the file can not be opened
+        bool    m_OwnDescriptor;    ///< close the descriptor in the destructor
+};
+
+// ****************************************************************************
+/// @brief  Appends the data to the vector
+// ****************************************************************************
+class MemorySink : public OutputSink
+{
+    public:
+        explicit inline MemorySink( std::vector<char> & Target ) : m_Target( Target ) {}
+
+        virtual bool Write( const char * Data, size_t Size )
+        {
+            m_Target.insert( m_Target.end(), Data, Data + Size );
+            return true;
+        }
+
+    private:
+        //Disable copy and assignment
+        MemorySink( const MemorySink & that );
+        MemorySink & operator=( const MemorySink & );
+
+        std::vector<char>   &   m_Target;   ///< vector the data is appended to
+};
+
+// ****************************************************************************
+/// @brief  Passes the data to the user function
+// ****************************************************************************
+class CallbackSink : public OutputSink
+{
+    public:
+        //The function returns false if the data can not be accepted
+        typedef bool ( * WriteFunc )( void * UserData, const char * Data, size_t Size );
+
+        inline CallbackSink( WriteFunc Func, void * UserData ) : m_Func( Func ), m_UserData( UserData ) {}
+
+        virtual bool Write( const char * Data, size_t Size )
+        {
+            return m_Func( m_UserData, Data, Size );
+        }
+
+    private:
+        WriteFunc   m_Func;         ///< user function
+        void    *   m_UserData;     ///< first argument of the function
+};
+
+// ****************************************************************************
+/// @brief  Writes into the standard stream
+// ****************************************************************************
+class StdStreamSink : public OutputSink
+{
+    public:
+        explicit inline StdStreamSink( std::ostream & Target ) : m_Target( Target ) {}
+
+        virtual bool Write( const char * Data, size_t Size )
+        {
+            return m_Target.write( Data, static_cast< std::streamsize >( Size ) ).good();
+        }
+        virtual bool IsOk() const
+        {
+            return m_Target.good();
+        }
+
+    private:
+        //Disable copy and assignment
+        StdStreamSink( const StdStreamSink & that );
+        StdStreamSink & operator=( const StdStreamSink & );
+
+        std::ostream        &   m_Target;   ///< stream the data is written into
+};
+
+// ****************************************************************************
+/// @brief  Deflates the data directly into the archive item opened by ZipAddStreamBegin.
+///         The item is finished by Close or by the destructor.
+// ****************************************************************************
+class ZipSink : public OutputSink
+{
+    public:
+        explicit inline ZipSink( void * Archive ) : m_Archive( Archive ), m_Closed( false ), m_Failed( false ) {}
+        virtual ~ZipSink();
+
+        virtual bool Write( const char * Data, size_t Size );
+        virtual bool IsOk() const
+        {
+            return ! m_Failed;
+        }
+        virtual bool Close();
+
+    private:
+        //Disable copy and assignment
+        ZipSink( const ZipSink & that );
+        ZipSink & operator=( const ZipSink & );
+
+        void    *   m_Archive;      ///< archive (HZIP)
+        bool        m_Closed;       ///< the item is finished
+        bool        m_Failed;       ///< writing or finishing the item has failed
+};
+
+// ****************************************************************************
+/// @brief  Passes the data to another sink in a background thread, so that the slow
+///         sink (e.g. ZipSink deflating) works in parallel with the XML formatting.
+///         The data is queued in blocks. When the queue is full, Write waits for
+///         the background thread, so the memory used is bounded.
+// ****************************************************************************
+class AsyncSink : public OutputSink
+{
+    public:
+        static const size_t DefaultBlockSize = 1 << 20;
+
+        //Target is deleted by the destructor after all the queued data is written into it.
+        //MaxQueued limits the size of the queued data (at least two blocks).
+        AsyncSink( OutputSink * Target, size_t MaxQueued, size_t BlockSize = DefaultBlockSize );
+        virtual ~AsyncSink();
+
+        virtual bool Write( const char * Data, size_t Size );
+        virtual bool IsOk() const;
+        //Waits until all the queued data is written and closes the target
+        virtual bool Close();
+
+    private:
+        //Disable copy and assignment
+        AsyncSink( const AsyncSink & that );
+        AsyncSink & operator=( const AsyncSink & );
+
+        struct Queue;
+
+        void Submit();
+        void Run();
+
+        OutputSink      *   m_Target;       ///< sink written in the background thread
+        Queue           *   m_Queue;        ///< blocks and the thread synchronization
+        std::vector<char> * m_Current;      ///< block filled by Write now
+        size_t              m_BlockSize;    ///< capacity of a block
+};
+
+}
+
+#endif // XLSX_OUTPUTSINK_HPP
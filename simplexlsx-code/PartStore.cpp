@@ -0,0 +1,273 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "PartStore.hpp"
+
+namespace SimpleXlsx
+{
+
+//Appends the data written by XMLWriter (or an image) to the part
+class PartStore::Sink : public OutputSink
+{
+    public:
+        inline Sink( PartStore & Store, Part & Target ) : m_Store( Store ), m_Target( Target ) {}
+
+        virtual bool Write( const char * Data, size_t Size )
+        {
+            return m_Store.Append( m_Target, Data, Size );
+        }
+
+    private:
+        //Disable copy and assignment
+        Sink( const Sink & that );
+        Sink & operator=( const Sink & );
+
+        PartStore   &   m_Store;
+        Part        &   m_Target;
+};
+
+// ****************************************************************************
+/// @brief  The constructor. The temporary file is not created until the memory limit is reached.
+/// @param  Directory directory to create the temporary file in
+// ****************************************************************************
+PartStore::PartStore( const std::string & Directory ) : m_Directory( Directory ), m_MemoryLimit( DefaultMemoryLimit ),
+    m_InMemory( 0 ), m_File( -1 ), m_FileSize( 0 ), m_Failed( false )
+{
+}
+
+PartStore::~PartStore()
+{
+    Clear();
+}
+
+//Total size of the parts kept in memory, beyond it they are moved into the temporary file
+void PartStore::SetMemoryLimit( size_t Bytes )
+{
+    std::lock_guard<std::mutex> Lock( m_Mutex );
+    m_MemoryLimit = Bytes;
+}
+
+//Creates the part (or makes it empty) and returns the sink which appends to it
+OutputSink * PartStore::Create( const std::string & Path )
+{
+    std::lock_guard<std::mutex> Lock( m_Mutex );
+    Part & Target = m_Parts[ Path ];
+    m_InMemory -= Target.Memory.size();
+    std::vector<char>().swap( Target.Memory );
+    Target.Extents.clear();
+    Target.Size = 0;
+    return new Sink( * this, Target );
+}
+
+//Content of the part if it is entirely in memory
+const std::vector<char> * PartStore::Memory( const std::string & Path ) const
+{
+    std::lock_guard<std::mutex> Lock( m_Mutex );
+    std::map< std::string, Part >::const_iterator it = m_Parts.find( Path );
+    if( ( it == m_Parts.end() ) || ! it->second.Extents.empty() ) return NULL;
+    return & it->second.Memory;
+}
+
+//Size of the part, 0 if there is no such part
+uint64_t PartStore::Size( const std::string & Path ) const
+{
+    std::lock_guard<std::mutex> Lock( m_Mutex );
+    std::map< std::string, Part >::const_iterator it = m_Parts.find( Path );
+    return ( it != m_Parts.end() ) ? it->second.Size : 0;
+}
+
+// ****************************************************************************
+/// @brief  Writes the content of the part into the sink: the pieces in the temporary file, then the memory
+/// @param  Path path of the part
+/// @param  Target sink to write into
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool PartStore::Read( const std::string & Path, OutputSink & Target ) const
+{
+    const size_t BlockSize = 1 << 20;
+    const Part * Source;
+    {
+        std::lock_guard<std::mutex> Lock( m_Mutex );
+        std::map< std::string, Part >::const_iterator it = m_Parts.find( Path );
+        if( it == m_Parts.end() ) return false;
+        Source = & it->second;
+    }
+    std::vector<char> Buffer;
+    for( size_t i = 0; i < Source->Extents.size(); i++ )
+        for( uint64_t Done = 0; Done < Source->Extents[ i ].second; )
+        {
+            const size_t Portion = static_cast<size_t>( std::min<uint64_t>( Source->Extents[ i ].second - Done, BlockSize ) );
+            Buffer.resize( Portion );
+            if( ! ReadFile( Source->Extents[ i ].first + Done, Buffer.data(), Portion ) || ! Target.Write( Buffer.data(), Portion ) )
+                return false;
+            Done += Portion;
+        }
+    return Source->Memory.empty() || Target.Write( Source->Memory.data(), Source->Memory.size() );
+}
+
+//Returns true if some data could not be stored since the last Clear (the temporary file is not writable)
+bool PartStore::Failed() const
+{
+    std::lock_guard<std::mutex> Lock( m_Mutex );
+    return m_Failed;
+}
+
+//Deletes all the parts and the temporary file
+void PartStore::Clear()
+{
+    std::lock_guard<std::mutex> Lock( m_Mutex );
+    m_Parts.clear();
+    m_InMemory = 0;
+    if( m_File >= 0 )
+#ifdef _WIN32
+        _close( m_File );
+#else
+        close( m_File );
+#endif
+    m_File = -1;
+    m_FileSize = 0;
+    m_Failed = false;
+}
+
+// ****************************************************************************
+/// @brief  Appends the data to the part: into its memory while the total is within the limit,
+///         otherwise the part moves what it has in memory into the temporary file and the data follows it
+/// @param  Target the part
+/// @param  Data the data
+/// @param  Size size of the data
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool PartStore::Append( Part & Target, const char * Data, size_t Size )
+{
+    {
+        std::lock_guard<std::mutex> Lock( m_Mutex );
+        if( ( m_InMemory > m_MemoryLimit ) || ( Size > m_MemoryLimit - m_InMemory ) )
+        {
+            if( ! Spill( Target, Target.Memory.data(), Target.Memory.size() ) || ! Spill( Target, Data, Size ) )
+            {
+                m_Failed = true;
+                return false;
+            }
+            m_InMemory -= Target.Memory.size();
+            std::vector<char>().swap( Target.Memory );
+            Target.Size += Size;
+            return true;
+        }
+        m_InMemory += Size;
+    }
+    //Only the sink of the part writes into its memory
+    Target.Memory.insert( Target.Memory.end(), Data, Data + Size );
+    Target.Size += Size;
+    return true;
+}
+
+//Appends the data to the temporary file as the next piece of the part (the mutex is locked by the caller)
+bool PartStore::Spill( Part & Target, const char * Data, size_t Size )
+{
+    if( Size == 0 ) return true;
+    if( ! OpenFile() ) return false;
+    const uint64_t Offset = m_FileSize;
+    for( size_t Done = 0; Done < Size; )
+    {
+        const unsigned int Portion = static_cast<unsigned int>( std::min<size_t>( Size - Done, 0x40000000 ) );
+#ifdef _WIN32
+        if( _lseeki64( m_File, Offset + Done, SEEK_SET ) < 0 ) return false;
+        const int Written = _write( m_File, Data + Done, Portion );
+#else
+        const ssize_t Written = pwrite( m_File, Data + Done, Portion, static_cast<off_t>( Offset + Done ) );
+        if( ( Written < 0 ) && ( errno == EINTR ) ) continue;
+#endif
+        if( Written <= 0 ) return false;
+        Done += Written;
+    }
+    m_FileSize += Size;
+    if( ! Target.Extents.empty() && ( Target.Extents.back().first + Target.Extents.back().second == Offset ) )
+        Target.Extents.back().second += Size;
+    else
+        Target.Extents.push_back( std::make_pair( Offset, static_cast<uint64_t>( Size ) ) );
+    return true;
+}
+
+// ****************************************************************************
+/// @brief  Creates the temporary file if it is not created yet. The file has no name
+///         (or loses it at once), so it disappears when it is closed, even after a crash.
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool PartStore::OpenFile()
+{
+    if( m_File >= 0 ) return true;
+#ifdef _WIN32
+    char * Name = _tempnam( m_Directory.c_str(), "xlsx" );
+    if( Name == NULL ) return false;
+    m_File = _open( Name, _O_CREAT | _O_EXCL | _O_RDWR | _O_BINARY | _O_TEMPORARY | _O_SHORT_LIVED, _S_IREAD | _S_IWRITE );
+    free( Name );
+#else
+#ifdef O_TMPFILE
+    m_File = open( m_Directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600 );
+#endif
+    if( m_File < 0 )    //O_TMPFILE is not supported by the system or the file system
+    {
+        std::string Name = m_Directory + "/xlsx_XXXXXX";
+        std::vector<char> Template( Name.begin(), Name.end() );
+        Template.push_back( '\0' );
+        m_File = mkstemp( Template.data() );
+        if( m_File >= 0 ) unlink( Template.data() );
+    }
+#endif
+    m_FileSize = 0;
+    return m_File >= 0;
+}
+
+//Reads the data from the temporary file
+bool PartStore::ReadFile( uint64_t Offset, char * Data, size_t Size ) const
+{
+    std::lock_guard<std::mutex> Lock( m_Mutex );
+    while( Size > 0 )
+    {
+        const unsigned int Portion = static_cast<unsigned int>( std::min<size_t>( Size, 0x40000000 ) );
+#ifdef _WIN32
+        if( _lseeki64( m_File, Offset, SEEK_SET ) < 0 ) return false;
+        const int Read = _read( m_File, Data, Portion );
+#else
+        const ssize_t Read = pread( m_File, Data, Portion, static_cast<off_t>( Offset ) );
+        if( ( Read < 0 ) && ( errno == EINTR ) ) continue;
+#endif
+        if( Read <= 0 ) return false;
+        Data += Read;
+        Offset += Read;
+        Size -= Read;
+    }
+    return true;
+}
+
+}
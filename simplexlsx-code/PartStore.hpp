@@ -0,0 +1,105 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_PARTSTORE_HPP
+#define XLSX_PARTSTORE_HPP
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include "OutputSink.hpp"
+
+namespace SimpleXlsx
+{
+
+// ****************************************************************************
+/// @brief  Content of the parts of a workbook until it is archived.
+///         The parts are kept in memory while their total size is within the limit.
+///         Beyond it the part being written is moved into a single anonymous temporary
+///         file, which is created at the first need and disappears when it is closed.
+///         Different parts may be written and read by different threads at once.
+// ****************************************************************************
+class PartStore
+{
+    public:
+        static const size_t DefaultMemoryLimit = 64 << 20;
+
+        //The temporary file is created in Directory
+        explicit PartStore( const std::string & Directory );
+        ~PartStore();
+
+        //Total size of the parts kept in memory, beyond it they are moved into the temporary file
+        void SetMemoryLimit( size_t Bytes );
+
+        //Creates the part (or makes it empty) and returns the sink which appends to it
+        OutputSink * Create( const std::string & Path );
+
+        //Content of the part if it is entirely in memory, NULL if it is (partly) in the file or there is no such part
+        const std::vector<char> * Memory( const std::string & Path ) const;
+        //Size of the part, 0 if there is no such part
+        uint64_t Size( const std::string & Path ) const;
+        //Writes the content of the part into Target piece by piece. Returns false if there is no such part.
+        bool Read( const std::string & Path, OutputSink & Target ) const;
+        //Returns true if some data could not be stored since the last Clear (the temporary file is not writable)
+        bool Failed() const;
+
+        //Deletes all the parts and the temporary file
+        void Clear();
+
+    private:
+        //Disable copy and assignment
+        PartStore( const PartStore & that );
+        PartStore & operator=( const PartStore & );
+
+        struct Part
+        {
+            inline Part() : Size( 0 ) {}
+
+            std::vector< std::pair< uint64_t, uint64_t > > Extents;   ///< pieces moved into the file (offset, size), in order
+            std::vector<char>   Memory;     ///< the rest kept in memory, it follows the pieces
+            uint64_t            Size;       ///< total size
+        };
+
+        class Sink;
+
+        bool Append( Part & Target, const char * Data, size_t Size );
+        bool Spill( Part & Target, const char * Data, size_t Size );
+        bool OpenFile();
+        bool ReadFile( uint64_t Offset, char * Data, size_t Size ) const;
+
+        const std::string           m_Directory;    ///< where the temporary file is created
+        std::map< std::string, Part > m_Parts;      ///< the parts by the path (the elements are never moved)
+        size_t                      m_MemoryLimit;  ///< limit of m_InMemory
+        size_t                      m_InMemory;     ///< total size of the parts kept in memory
+        int                         m_File;         ///< descriptor of the temporary file, -1 if it is not created yet
+        uint64_t                    m_FileSize;     ///< size of the temporary file
+        bool                        m_Failed;       ///< some data could not be stored
+        mutable std::mutex          m_Mutex;        ///< guards all of the above (the memory of a part is written by its sink alone)
+};
+
+}
+
+#endif // XLSX_PARTSTORE_HPP
@@ -19,9 +19,6 @@
   3. This notice may not be removed or altered from any source distribution.
 */
 
-#include <algorithm>
-#include <cerrno>
-#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -32,79 +29,119 @@
 
 #ifdef _WIN32
 #include <windows.h>
-#include <direct.h>
-#else
-#include <unistd.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <sys/syscall.h>
 #endif
 
+#include "Zip/zip.h"
+
 namespace SimpleXlsx
 {
+    //Opens an item of the streaming archive, so that XML is deflated directly into it.
+    //With the stream queue set the deflating is done by a background thread,
+    //unless there is a single CPU: the thread would only take its turns with the writer.
+    OutputSink * PathManager::RegisterStream( const std::string & PathToFile )
+    {
+        if( m_streamArchive == NULL ) return NULL;
+        if( ! PrepareArchiveItem( m_streamArchive, PathToFile ) ) return NULL;
+        if( ZipAddStreamBegin( ( HZIP )m_streamArchive, PathToFile.c_str() + 1 ) != ZR_OK ) return NULL;
+        OutputSink * Sink = new ZipSink( m_streamArchive );
+        if( ( m_streamQueue != 0 ) && ( std::thread::hardware_concurrency() != 1 ) ) Sink = new AsyncSink( Sink, m_streamQueue );
+        return Sink;
+    }
 
-    //Creating all necessary subdirectories and copy image file
-    bool PathManager::RegisterImage( const std::string & LocalPath, const std::string & XLSX_Path )
+    //Compression level of the part: the longest matching prefix wins.
+    //The paths are registered with the leading slash, the prefixes are given without it.
+    int PathManager::CompressionLevel( const std::string & PathToFile ) const
     {
-        std::ifstream Source( LocalPath.c_str(), std::ios::binary );
-        if( Source.is_open() )
-        {
-            const std::string InternalPath = RegisterFile( XLSX_Path );
-            std::ofstream Destination( InternalPath.c_str(), std::ios::binary );
-            if( Destination.is_open() )
+        const std::string Path = ( ! PathToFile.empty() && ( PathToFile[ 0 ] == '/' ) ) ? PathToFile.substr( 1 ) : PathToFile;
+        int Level = m_compression;
+        size_t Matched = 0;
+        for( std::map< std::string, int >::const_iterator it = m_partCompression.begin(); it != m_partCompression.end(); it++ )
+            if( ( it->first.size() >= Matched ) && ( Path.compare( 0, it->first.size(), it->first ) == 0 ) )
             {
-                Destination << Source.rdbuf();
-                return true;
+                Level = it->second;
+                Matched = it->first.size();
             }
-        }
-        return false;
+        return Level;
     }
 
-    //Deletes all temporary files and directories which have been created
-    void PathManager::ClearTemp()
+    //Sets the compression of the next item of the archive
+    bool PathManager::PrepareArchiveItem( void * Archive, const std::string & PathToFile ) const
     {
-        for( std::vector< std::string >::const_iterator it = m_contentFiles.begin(); it != m_contentFiles.end(); it++ )
-            remove( ( m_temp_path + ( * it ) ).c_str() );
-        m_contentFiles.clear();
-        for( std::vector< std::string >::const_reverse_iterator it = m_temp_dirs.rbegin(); it != m_temp_dirs.rend(); it++ )
-#ifdef _WIN32
-            _rmdir( ( * it ).c_str() );
-#else
-            rmdir( ( *it ).c_str() );
-#endif
-        m_temp_dirs.clear();
+        if( ( m_adaptiveRate > 0 ) && ( ZipSetAdaptiveRate( ( HZIP )Archive, m_adaptiveRate ) != ZR_OK ) ) return false;
+        if( ( m_codec != CODEC_DEFAULT ) && ( ZipSetCodec( ( HZIP )Archive, m_codec ) != ZR_OK ) ) return false;
+        if( ZipSetThreads( ( HZIP )Archive, m_threads ) != ZR_OK ) return false;
+        return ZipSetLevel( ( HZIP )Archive, CompressionLevel( PathToFile ) ) == ZR_OK;
     }
 
-    // ****************************************************************************
-    /// @brief  Function to create nested directories` tree
-    /// @param  dirName directories` tree to be created
-    /// @return Boolean result of the operation
-    // ****************************************************************************
-    bool PathManager::MakeDirectory( const std::string & dirName )
+    //Register XML. Returns the sink which writes into the part store.
+    OutputSink * PathManager::RegisterXML( const std::string & PathToFile )
     {
-        std::string part = "";
-        size_t oldPointer = 0;
-        size_t currPointer = 0;
-        int32_t res = -1;
-
-        for( size_t i = 0; i < dirName.length(); i++ )
         {
-            if( ( dirName.at( i ) == '\\' ) || ( dirName.at( i ) == '/' ) )
-            {
-                part += dirName.substr( oldPointer, currPointer - oldPointer ) + "/";
-                oldPointer = currPointer + 1;
-#ifdef _WIN32
-                std::replace( part.begin(), part.end(), '/', '\\' );
-                res = _mkdir( part.c_str() );
-#else
-                res = mkdir( part.c_str(), 0777 );
-#endif
-                if( res == 0 ) m_temp_dirs.push_back( part );  //Remember the created subdirectories
-                if( ( res == -1 ) && ( errno == ENOENT ) ) return false;
-            }
-            currPointer++;
+            std::lock_guard<std::mutex> Lock( m_mutex );
+            AddContentFile( PathToFile );
         }
-        return true;
+        return m_parts.Create( PathToFile );
+    }
+
+    //Copy image file into the part store
+    bool PathManager::RegisterImage( const std::string & LocalPath, const std::string & XLSX_Path )
+    {
+        std::ifstream Source( LocalPath.c_str(), std::ios::binary );
+        if( ! Source.is_open() ) return false;
+        OutputSink * Destination = RegisterXML( XLSX_Path );
+        char Buffer[ 65536 ];
+        bool Ok = true;
+        while( Ok && ( Source.read( Buffer, sizeof( Buffer ) ).gcount() > 0 ) )
+            Ok = Destination->Write( Buffer, static_cast<size_t>( Source.gcount() ) );
+        delete Destination;
+        return Ok && ! Source.bad();
+    }
+
+    //Register a part whose content is the same in every workbook, it is added to the archive by Part
+    void PathManager::RegisterStatic( const std::string & PathToFile, const StaticPart & Part )
+    {
+        std::lock_guard<std::mutex> Lock( m_mutex );
+        AddContentFile( PathToFile );
+        m_static[ PathToFile ] = & Part;
+    }
+
+    //The static part registered for the path, NULL if the part is in the part store.
+    //It is called while archiving, when the parts are not registered any more.
+    const StaticPart * PathManager::Static( const std::string & PathToFile ) const
+    {
+        std::map< std::string, const StaticPart * >::const_iterator it = m_static.find( PathToFile );
+        return ( it != m_static.end() ) ? it->second : NULL;
+    }
+
+    //Adds the file to the content files, or to those collected for the calling thread
+    void PathManager::AddContentFile( const std::string & PathToFile )
+    {
+        std::map< std::thread::id, std::vector< std::string > * >::const_iterator it = m_collected.find( std::this_thread::get_id() );
+        if( it != m_collected.end() ) it->second->push_back( PathToFile );
+        else m_contentFiles.push_back( PathToFile );
+    }
+
+    //The files registered by the calling thread are put into Files instead of the content files
+    void PathManager::CollectFiles( std::vector< std::string > * Files )
+    {
+        std::lock_guard<std::mutex> Lock( m_mutex );
+        if( Files != NULL ) m_collected[ std::this_thread::get_id() ] = Files;
+        else m_collected.erase( std::this_thread::get_id() );
+    }
+
+    //Appends the collected files to the content files
+    void PathManager::AddContentFiles( const std::vector< std::string > & Files )
+    {
+        std::lock_guard<std::mutex> Lock( m_mutex );
+        m_contentFiles.insert( m_contentFiles.end(), Files.begin(), Files.end() );
+    }
+
+    //Deletes all the parts which have been registered
+    void PathManager::ClearTemp()
+    {
+        m_contentFiles.clear();
+        m_static.clear();
+        m_parts.Clear();
     }
 
 #if ! defined( _WIN32 )     //Linux with Unicode
@@ -22,34 +22,90 @@
 #ifndef XLSX_PATHMANAGER_HPP
 #define XLSX_PATHMANAGER_HPP
 
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "Compression.hpp"
+#include "OutputSink.hpp"
+#include "PartStore.hpp"
+#include "StaticPart.hpp"
+
 namespace SimpleXlsx
 {
 
 class PathManager
 {
     public:
-        inline PathManager( const std::string & temp_path ) : m_temp_path( temp_path ) {}
+        inline PathManager( const std::string & temp_path ) : m_parts( temp_path ), m_streamArchive( NULL ), m_streamQueue( 0 ),
+            m_compression( COMPRESSION_DEFAULT ), m_adaptiveRate( 0.0 ), m_codec( CODEC_DEFAULT ), m_threads( 1 ) {}
 
         inline ~PathManager()
         {
             ClearTemp();
         }
 
-        //Register XML and creating all necessary subdirectories
-        inline const std::string RegisterXML( const std::string & PathToFile )
+        //Register XML. Returns the sink which writes into the part store.
+        OutputSink * RegisterXML( const std::string & PathToFile );
+
+        //Copy image file into the part store
+        bool RegisterImage( const std::string & LocalPath, const std::string & XLSX_Path );
+
+        //Register a part whose content is the same in every workbook, it is added to the archive by Part
+        void RegisterStatic( const std::string & PathToFile, const StaticPart & Part );
+        //The static part registered for the path, NULL if the part is in the part store
+        const StaticPart * Static( const std::string & PathToFile ) const;
+
+        //Total size of the parts kept in memory, beyond it they are moved into a temporary file
+        inline void SetMemoryLimit( size_t Bytes )
         {
-            return RegisterFile( PathToFile );
+            m_parts.SetMemoryLimit( Bytes );
+        }
+        //Content of the registered parts
+        inline const PartStore & Parts() const
+        {
+            return m_parts;
         }
 
-        //Creating all necessary subdirectories and copy image file
-        bool RegisterImage( const std::string & LocalPath, const std::string & XLSX_Path );
+        // *INDENT-OFF*   For AStyle tool
+        //Archive (HZIP) opened for the streaming mode, NULL if the parts are saved into the temporary directory
+        inline void SetStreamArchive( void * Archive )  { m_streamArchive = Archive; }
+        inline void * StreamArchive() const             { return m_streamArchive; }
+        //Size limit of the XML queued for the background compression of the streamed items, 0 to deflate in place
+        inline void SetStreamQueue( size_t Size )       { m_streamQueue = Size; }
+        inline size_t StreamQueue() const               { return m_streamQueue; }
+        //Compression level (ECompression or 1..9) of all parts, and of the parts whose path begins with Prefix
+        inline void SetCompression( int Level )                                 { m_compression = Level; }
+        inline void SetCompression( const std::string & Prefix, int Level )     { m_partCompression[ Prefix ] = Level; }
+        //Output rate (bytes per second) COMPRESSION_ADAPTIVE chooses the levels for, 0 for the default one
+        inline void SetAdaptiveRate( double BytesPerSecond )                    { m_adaptiveRate = BytesPerSecond; }
+        //Deflate engine (ECompressionCodec) of the archive items
+        inline void SetCodec( int Codec )                                       { m_codec = Codec; }
+        inline int Codec() const                                                { return m_codec; }
+        //Threads the built-in engine deflates each part on, 0 for one per CPU
+        inline void SetThreads( unsigned Threads )                              { m_threads = Threads; }
+        // *INDENT-ON*   For AStyle tool
+
+        //Compression level of the part: the longest matching prefix wins
+        int CompressionLevel( const std::string & PathToFile ) const;
+        //Sets the compression of the next item of the archive (HZIP)
+        bool PrepareArchiveItem( void * Archive, const std::string & PathToFile ) const;
 
-        //Deletes all temporary files and directories which have been created
+        //Opens an item of the streaming archive, so that XML is deflated directly into it.
+        //Returns NULL if there is no streaming archive or another item is being streamed now.
+        OutputSink * RegisterStream( const std::string & PathToFile );
+
+        //Deletes all the parts which have been registered
         void ClearTemp();
 
+        //The files registered by the calling thread are put into Files instead of the content files
+        //(NULL stops it), so that the parts saved by several threads can be archived in a fixed order
+        void CollectFiles( std::vector< std::string > * Files );
+        //Appends the collected files to the content files
+        void AddContentFiles( const std::vector< std::string > & Files );
+
         inline const std::vector< std::string > & ContentFiles() const
         {
             return m_contentFiles;
@@ -67,25 +123,21 @@ class PathManager
         PathManager( const PathManager & that );
         PathManager & operator=( const PathManager & );
 
-        const std::string     &     m_temp_path;    ///< path to the temporary directory (unique for a book)
-        std::vector< std::string >  m_temp_dirs;    ///< a series of temporary subdirectories
+        PartStore                   m_parts;        ///< content of the parts
+        std::map< std::string, const StaticPart * > m_static;  ///< the static parts by the path
         std::vector< std::string >  m_contentFiles; ///< a series of relative file pathes to be saved inside xlsx archive
-
-        // ****************************************************************************
-        /// @brief  Function to create nested directories` tree
-        /// @param  dirName directories` tree to be created
-        /// @return Boolean result of the operation
-        // ****************************************************************************
-        bool MakeDirectory( const std::string & dirName );
-
-        //Register file for XLSX and creating all necessary subdirectories
-        inline const std::string RegisterFile( const std::string & PathToFile )
-        {
-            std::string Result = m_temp_path + PathToFile;
-            MakeDirectory( Result );
-            m_contentFiles.push_back( PathToFile );
-            return Result;
-        }
+        void            *           m_streamArchive;///< archive for the streaming mode (HZIP) or NULL
+        size_t                      m_streamQueue;  ///< queue size limit for the background compression or 0
+        int                         m_compression;  ///< compression level of the parts without a prefix of their own
+        std::map< std::string, int >m_partCompression;  ///< compression levels of the parts by the path prefix
+        double                      m_adaptiveRate; ///< output rate for COMPRESSION_ADAPTIVE or 0
+        int                         m_codec;        ///< deflate engine or CODEC_DEFAULT
+        unsigned                    m_threads;      ///< threads of the built-in deflate engine
+        std::mutex                  m_mutex;        ///< guards the registration of the files by several threads
+        std::map< std::thread::id, std::vector< std::string > * > m_collected; ///< files collected for the threads
+
+        //Adds the file to the content files, or to those collected for the calling thread (locked by the caller)
+        void AddContentFile( const std::string & PathToFile );
 };
 
 }
@@ -0,0 +1,104 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "StaticPart.hpp"
+#include "Compression.hpp"
+#include "OutputSink.hpp"
+#include "XMLWriter.hpp"
+#include "Zip/zip.h"
+
+namespace SimpleXlsx
+{
+
+//Appends the deflated data to the vector
+static bool AppendDeflated( void * Param, const char * Data, unsigned int Size )
+{
+    std::vector<char> * Target = static_cast< std::vector<char> * >( Param );
+    Target->insert( Target->end(), Data, Data + Size );
+    return true;
+}
+
+// ****************************************************************************
+/// @brief  The constructor. Nothing is generated until the part is added into an archive.
+/// @param  Generate function which writes the content of the part
+// ****************************************************************************
+StaticPart::StaticPart( Generator Generate ) : m_Generate( Generate ), m_Generated( false ), m_Crc( 0 )
+{
+}
+
+// ****************************************************************************
+/// @brief  The constructor of the part with the ready content
+/// @param  Content content of the part
+// ****************************************************************************
+StaticPart::StaticPart( const std::vector<char> & Content ) : m_Generate( NULL ), m_Generated( false ), m_Content( Content ), m_Crc( 0 )
+{
+}
+
+// ****************************************************************************
+/// @brief  Adds the part into the archive. The content deflated at the level by the codec
+///         is kept for the next archives; the other levels store the content or let
+///         the archive choose the level (COMPRESSION_ADAPTIVE).
+/// @param  Archive opened archive (HZIP), prepared for the item
+/// @param  Name name of the item
+/// @param  Level compression level of the item
+/// @param  Codec deflate engine of the archive, -1 for a custom one
+/// @return Result of the zip function (ZRESULT)
+// ****************************************************************************
+unsigned long StaticPart::AddTo( void * Archive, const char * Name, int Level, int Codec ) const
+{
+    const std::vector<char> * Deflated = NULL;
+    {
+        std::lock_guard<std::mutex> Lock( m_Mutex );
+        if( ! m_Generated )
+        {
+            if( m_Generate != NULL )
+            {
+                XMLWriter xmlw( new MemorySink( m_Content ) );
+                m_Generate( xmlw );
+            }
+            m_Crc = ZipCrc32( 0, m_Content.data(), ( unsigned int )m_Content.size() );
+            m_Generated = true;
+        }
+        if( ( Level >= COMPRESSION_FAST ) && ( Level <= COMPRESSION_BEST ) && ( Codec >= 0 ) )
+        {
+            const int Key = Codec * 16 + Level;
+            std::map< int, std::vector<char> >::iterator it = m_Deflated.find( Key );
+            if( it == m_Deflated.end() )
+            {
+                TZipCodec * Engine = NewZipCodec( Codec );
+                if( Engine == NULL ) return ZR_NOCODEC;
+                std::vector<char> Data;
+                const bool Ok = Engine->Begin( Level, AppendDeflated, & Data ) &&
+                                Engine->Write( m_Content.data(), ( unsigned int )m_Content.size(), true );
+                delete Engine;
+                if( ! Ok ) return ZR_FLATE;
+                it = m_Deflated.insert( std::make_pair( Key, Data ) ).first;
+            }
+            Deflated = & it->second;
+        }
+    }
+    //The content and the deflated data are never changed once made
+    if( Deflated != NULL )
+        return ZipAddDeflated( ( HZIP )Archive, Name, const_cast<char *>( Deflated->data() ), ( unsigned int )Deflated->size(), m_Crc, m_Content.size() );
+    return ZipAdd( ( HZIP )Archive, Name, const_cast<char *>( m_Content.data() ), ( unsigned int )m_Content.size() );
+}
+
+}
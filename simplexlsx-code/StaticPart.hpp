@@ -0,0 +1,71 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_STATICPART_HPP
+#define XLSX_STATICPART_HPP
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SimpleXlsx
+{
+
+class XMLWriter;
+
+// ****************************************************************************
+/// @brief  A part whose content is the same in every workbook (the theme, the package
+///         relationships) or in every workbook made from a template. It is generated
+///         and deflated once, and then copied into every archive as it is, with the CRC
+///         computed beforehand. The instances are shared by the workbooks and threads.
+// ****************************************************************************
+class StaticPart
+{
+    public:
+        //Writes the content of the part
+        typedef void ( * Generator )( XMLWriter & xmlw );
+
+        explicit StaticPart( Generator Generate );
+        //The part with the ready content (see CWorkbookTemplate)
+        explicit StaticPart( const std::vector<char> & Content );
+
+        //Adds the part into the archive (HZIP) as the item Name. Level (ECompression or 1..9)
+        //and Codec (ECompressionCodec, CODEC_DEFAULT is not accepted) are those of the item.
+        //Returns the result of the zip function (ZRESULT).
+        unsigned long AddTo( void * Archive, const char * Name, int Level, int Codec ) const;
+
+    private:
+        //Disable copy and assignment
+        StaticPart( const StaticPart & that );
+        StaticPart & operator=( const StaticPart & );
+
+        const Generator                     m_Generate;     ///< NULL if the content is given
+        mutable std::mutex                  m_Mutex;        ///< guards the members below
+        mutable bool                        m_Generated;    ///< m_Content and m_Crc are made
+        mutable std::vector<char>           m_Content;
+        mutable unsigned long               m_Crc;
+        mutable std::map< int, std::vector<char> > m_Deflated;  ///< raw deflate data by the codec and the level
+};
+
+}
+
+#endif // XLSX_STATICPART_HPP
@@ -0,0 +1,154 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TaskPool.hpp"
+
+namespace SimpleXlsx
+{
+
+//Threads of TaskPool and the tasks being run
+struct TaskPool::State
+{
+    std::mutex                  Mutex;
+    std::condition_variable     Ready;      ///< a task can be started or the end is requested
+    std::condition_variable     Finished;   ///< a task is done
+    std::vector<std::thread>    Threads;
+    TaskList            *       Tasks;      ///< tasks being run, NULL between the calls of Run
+    size_t                      Next;       ///< first task not started yet
+    size_t                      Limit;      ///< tasks below it may be started
+    std::vector<char>           Status;     ///< of each task: 0 - not done yet, 1 - done, 2 - failed
+    bool                        Stop;       ///< the threads are to quit
+};
+
+// ****************************************************************************
+/// @brief  Starts the threads
+/// @param  Threads number of the threads, 0 for one per CPU
+// ****************************************************************************
+TaskPool::TaskPool( unsigned Threads ) : m_Threads( Threads ), m_State( NULL )
+{
+    if( m_Threads == 0 ) m_Threads = std::thread::hardware_concurrency();
+    if( m_Threads <= 1 )
+    {
+        m_Threads = 1;
+        return;
+    }
+    m_State = new State;
+    m_State->Tasks = NULL;
+    m_State->Next = m_State->Limit = 0;
+    m_State->Stop = false;
+    for( unsigned i = 0; i < m_Threads; i++ )
+        m_State->Threads.push_back( std::thread( & TaskPool::Work, this ) );
+}
+
+// ****************************************************************************
+/// @brief  Stops and joins the threads
+// ****************************************************************************
+TaskPool::~TaskPool()
+{
+    if( m_State == NULL ) return;
+    {
+        std::lock_guard<std::mutex> Lock( m_State->Mutex );
+        m_State->Stop = true;
+    }
+    m_State->Ready.notify_all();
+    for( size_t i = 0; i < m_State->Threads.size(); i++ )
+        m_State->Threads[ i ].join();
+    delete m_State;
+}
+
+// ****************************************************************************
+/// @brief  Runs the tasks on the threads and takes their results in order
+/// @param  Tasks the work
+/// @param  Count number of the tasks
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool TaskPool::Run( TaskList & Tasks, size_t Count )
+{
+    if( m_State == NULL )
+    {
+        for( size_t i = 0; i < Count; i++ )
+            if( ! Tasks.Run( i ) || ! Tasks.Done( i ) ) return false;
+        return true;
+    }
+
+    const size_t Ahead = 2 * m_Threads;
+    std::unique_lock<std::mutex> Lock( m_State->Mutex );
+    m_State->Tasks = & Tasks;
+    m_State->Next = 0;
+    m_State->Limit = std::min( Count, Ahead );
+    m_State->Status.assign( Count, 0 );
+    m_State->Ready.notify_all();
+
+    bool Ok = true;
+    for( size_t i = 0; Ok && ( i < Count ); i++ )
+    {
+        while( m_State->Status[ i ] == 0 )
+            m_State->Finished.wait( Lock );
+        if( m_State->Status[ i ] != 1 )
+        {
+            Ok = false;
+            break;
+        }
+        m_State->Limit = std::min( Count, i + 1 + Ahead );
+        m_State->Ready.notify_all();
+        Lock.unlock();
+        Ok = Tasks.Done( i );
+        Lock.lock();
+    }
+
+    //After a failure no more tasks are started, and those which are running are waited for
+    m_State->Limit = m_State->Next;
+    for( size_t i = 0; i < m_State->Next; i++ )
+        while( m_State->Status[ i ] == 0 )
+            m_State->Finished.wait( Lock );
+    m_State->Tasks = NULL;
+    return Ok;
+}
+
+//Thread of the pool: runs the tasks which may be started
+void TaskPool::Work()
+{
+    std::unique_lock<std::mutex> Lock( m_State->Mutex );
+    for( ;; )
+    {
+        while( ( m_State->Next >= m_State->Limit ) && ! m_State->Stop )
+            m_State->Ready.wait( Lock );
+        if( m_State->Stop ) break;
+
+        const size_t Index = m_State->Next++;
+        TaskList * Tasks = m_State->Tasks;
+        Lock.unlock();
+
+        const bool Ok = Tasks->Run( Index );
+
+        Lock.lock();
+        m_State->Status[ Index ] = Ok ? 1 : 2;
+        m_State->Finished.notify_all();
+    }
+}
+
+}
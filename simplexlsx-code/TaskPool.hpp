@@ -0,0 +1,85 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_TASKPOOL_HPP
+#define XLSX_TASKPOOL_HPP
+
+#include <cstddef>
+
+namespace SimpleXlsx
+{
+
+// ****************************************************************************
+/// @brief  The work given to TaskPool: a number of independent tasks, whose results
+///         are taken by the calling thread in the order of the tasks.
+// ****************************************************************************
+class TaskList
+{
+    public:
+        virtual ~TaskList() {}
+
+        //Does the task, on any thread of the pool. Returns false if it has failed.
+        virtual bool Run( size_t Index ) = 0;
+        //Takes the result of the task, on the thread of TaskPool::Run: in the order of the
+        //tasks, as soon as the task and all the previous ones are done. Returns false on failure.
+        virtual bool Done( size_t /*Index*/ )
+        {
+            return true;
+        }
+};
+
+// ****************************************************************************
+/// @brief  Threads that run the tasks of a TaskList. At most two tasks per thread are
+///         ahead of the one whose result is waited for, so the memory used is bounded.
+// ****************************************************************************
+class TaskPool
+{
+    public:
+        //Starts the threads: 0 for one per CPU. With 1 thread the tasks are run by Run itself.
+        explicit TaskPool( unsigned Threads );
+        //Stops and joins the threads
+        ~TaskPool();
+
+        //Runs the tasks 0..Count-1 and takes their results in order. After a failure the tasks
+        //not started yet are skipped. Returns false if a task or the taking of a result failed.
+        bool Run( TaskList & Tasks, size_t Count );
+
+        inline unsigned Threads() const
+        {
+            return m_Threads;
+        }
+
+    private:
+        //Disable copy and assignment
+        TaskPool( const TaskPool & that );
+        TaskPool & operator=( const TaskPool & );
+
+        struct State;
+
+        void Work();
+
+        unsigned            m_Threads;      ///< number of the threads
+        State       *       m_State;        ///< threads, tasks and the synchronization, NULL for one thread
+};
+
+}
+
+#endif // XLSX_TASKPOOL_HPP
@@ -0,0 +1,208 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "XMLWriter.hpp"
+
+#include <cctype>
+
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#include <intrin.h>
+#endif
+
+//The SIMD scan reads past the terminating zero (within the aligned block, so it never faults),
+//which the address and thread sanitizers report: with them the scalar scan is used.
+//XLSX_NO_SIMD_ESCAPE turns the SIMD scan off in any build.
+#if defined( __SANITIZE_ADDRESS__ ) || defined( __SANITIZE_THREAD__ )
+#define XLSX_ESCAPE_SANITIZED
+#elif defined( __has_feature )
+#if __has_feature( address_sanitizer ) || __has_feature( thread_sanitizer )
+#define XLSX_ESCAPE_SANITIZED
+#endif
+#endif
+
+#if ! defined( XLSX_NO_SIMD_ESCAPE ) && ! defined( XLSX_ESCAPE_SANITIZED ) && \
+    ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) ) )
+#define XLSX_ESCAPE_SSE2
+#include <emmintrin.h>
+#if defined( __GNUC__ ) || defined( _MSC_VER )
+#define XLSX_ESCAPE_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+namespace SimpleXlsx
+{
+namespace
+{
+#ifndef XLSX_ESCAPE_SSE2
+//Chars which stop the copying of the string: & < > ' " _ and all control chars (including the terminating zero)
+const char * FindSpecialCharScalar( const char * String )
+{
+    for( ;; String++ )
+    {
+        const unsigned char Char = static_cast<unsigned char>( * String );
+        if( ( Char < 0x20 ) || ( Char == '&' ) || ( Char == '<' ) || ( Char == '>' ) || ( Char == '\'' ) || ( Char == '"' ) || ( Char == '_' ) )
+            return String;
+    }
+}
+#endif
+
+#ifdef XLSX_ESCAPE_SSE2
+inline unsigned int CountTrailingZeros( unsigned int Mask )
+{
+#ifdef _MSC_VER
+    unsigned long Index;
+    _BitScanForward( & Index, Mask );
+    return Index;
+#else
+    return __builtin_ctz( Mask );
+#endif
+}
+
+//The loads are aligned, so that they never cross a page boundary beyond the terminating zero.
+//The bytes before the beginning of the string are masked out.
+const char * FindSpecialCharSSE2( const char * String )
+{
+    const __m128i Amp = _mm_set1_epi8( '&' ), Lt = _mm_set1_epi8( '<' ), Gt = _mm_set1_epi8( '>' );
+    const __m128i Apos = _mm_set1_epi8( '\'' ), Quot = _mm_set1_epi8( '"' ), Under = _mm_set1_epi8( '_' );
+    const __m128i CtrlMask = _mm_set1_epi8( char( 0xE0 ) ), Zero = _mm_setzero_si128();
+
+    const size_t Offset = reinterpret_cast<uintptr_t>( String ) & 15;
+    const char * Ptr = String - Offset;
+    unsigned int Skip = 0xFFFFu << Offset;
+    for( ;; )
+    {
+        const __m128i Chars = _mm_load_si128( reinterpret_cast<const __m128i *>( Ptr ) );
+        __m128i Special = _mm_or_si128( _mm_cmpeq_epi8( Chars, Amp ), _mm_cmpeq_epi8( Chars, Lt ) );
+        Special = _mm_or_si128( Special, _mm_or_si128( _mm_cmpeq_epi8( Chars, Gt ), _mm_cmpeq_epi8( Chars, Apos ) ) );
+        Special = _mm_or_si128( Special, _mm_or_si128( _mm_cmpeq_epi8( Chars, Quot ), _mm_cmpeq_epi8( Chars, Under ) ) );
+        Special = _mm_or_si128( Special, _mm_cmpeq_epi8( _mm_and_si128( Chars, CtrlMask ), Zero ) );
+        const unsigned int Mask = static_cast<unsigned int>( _mm_movemask_epi8( Special ) ) & Skip;
+        if( Mask != 0 ) return Ptr + CountTrailingZeros( Mask );
+        Ptr += 16;
+        Skip = 0xFFFFu;
+    }
+}
+#endif
+
+#ifdef XLSX_ESCAPE_AVX2
+#ifdef __GNUC__
+__attribute__( ( target( "avx2" ) ) )
+#endif
+const char * FindSpecialCharAVX2( const char * String )
+{
+    const __m256i Amp = _mm256_set1_epi8( '&' ), Lt = _mm256_set1_epi8( '<' ), Gt = _mm256_set1_epi8( '>' );
+    const __m256i Apos = _mm256_set1_epi8( '\'' ), Quot = _mm256_set1_epi8( '"' ), Under = _mm256_set1_epi8( '_' );
+    const __m256i CtrlMask = _mm256_set1_epi8( char( 0xE0 ) ), Zero = _mm256_setzero_si256();
+
+    const size_t Offset = reinterpret_cast<uintptr_t>( String ) & 31;
+    const char * Ptr = String - Offset;
+    unsigned int Skip = 0xFFFFFFFFu << Offset;
+    for( ;; )
+    {
+        const __m256i Chars = _mm256_load_si256( reinterpret_cast<const __m256i *>( Ptr ) );
+        __m256i Special = _mm256_or_si256( _mm256_cmpeq_epi8( Chars, Amp ), _mm256_cmpeq_epi8( Chars, Lt ) );
+        Special = _mm256_or_si256( Special, _mm256_or_si256( _mm256_cmpeq_epi8( Chars, Gt ), _mm256_cmpeq_epi8( Chars, Apos ) ) );
+        Special = _mm256_or_si256( Special, _mm256_or_si256( _mm256_cmpeq_epi8( Chars, Quot ), _mm256_cmpeq_epi8( Chars, Under ) ) );
+        Special = _mm256_or_si256( Special, _mm256_cmpeq_epi8( _mm256_and_si256( Chars, CtrlMask ), Zero ) );
+        const unsigned int Mask = static_cast<unsigned int>( _mm256_movemask_epi8( Special ) ) & Skip;
+        if( Mask != 0 ) return Ptr + CountTrailingZeros( Mask );
+        Ptr += 32;
+        Skip = 0xFFFFFFFFu;
+    }
+}
+
+bool IsAVX2Supported()
+{
+#ifdef _MSC_VER
+    int Info[ 4 ];
+    __cpuid( Info, 0 );
+    if( Info[ 0 ] < 7 ) return false;
+    __cpuid( Info, 1 );
+    const bool OSXSave = ( Info[ 2 ] & ( 1 << 27 ) ) != 0;
+    if( ! OSXSave || ( ( _xgetbv( 0 ) & 6 ) != 6 ) ) return false;    // YMM state is saved by OS
+    __cpuidex( Info, 7, 0 );
+    return ( Info[ 1 ] & ( 1 << 5 ) ) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+#endif
+}
+#endif
+
+typedef const char * ( * TFindSpecialChar )( const char * );
+
+TFindSpecialChar SelectFindSpecialChar()
+{
+#ifdef XLSX_ESCAPE_AVX2
+    if( IsAVX2Supported() ) return & FindSpecialCharAVX2;
+#endif
+#ifdef XLSX_ESCAPE_SSE2
+    return & FindSpecialCharSSE2;
+#else
+    return & FindSpecialCharScalar;
+#endif
+}
+}
+
+// ****************************************************************************
+/// @brief  Finds the first char which must be escaped or the end of the string
+/// @param  String zero-terminated string
+/// @return Pointer to the found char: & < > ' " _ control char or terminating zero
+// ****************************************************************************
+const char * XMLWriter::FindSpecialChar( const char * String )
+{
+    static const TFindSpecialChar Impl = SelectFindSpecialChar();
+    return Impl( String );
+}
+
+// ****************************************************************************
+/// @brief  Writes the control char, which is not allowed in XML, as _xHHHH_
+/// @param  Char control char
+/// @return no
+// ****************************************************************************
+void XMLWriter::WriteControlChar( char Char )
+{
+    static const char HexDigits[] = "0123456789ABCDEF";
+    char Buffer[] = "_x0000_";
+    Buffer[ 4 ] = HexDigits[ ( Char >> 4 ) & 0x0F ];
+    Buffer[ 5 ] = HexDigits[ Char & 0x0F ];
+    Write( Buffer, 7 );
+}
+
+// ****************************************************************************
+/// @brief  Writes the underscore, escaped as _x005F_ if it starts a text which looks like _xHHHH_,
+///         so that the text is not read back as an escaped char
+/// @param  Underscore pointer to the underscore in the zero-terminated string
+/// @return no
+// ****************************************************************************
+void XMLWriter::WriteUnderscore( const char * Underscore )
+{
+    bool Escape = ( Underscore[ 1 ] == 'x' );
+    for( int i = 2; Escape && ( i < 6 ); i++ )
+        Escape = ( isxdigit( static_cast<unsigned char>( Underscore[ i ] ) ) != 0 );
+    if( Escape && ( Underscore[ 6 ] == '_' ) )
+        Write( "_x005F_", 7 );
+    else
+        Put( '_' );
+}
+
+}
@@ -23,45 +23,91 @@
 #define XMLWRITER_H
 
 #include <cassert>
-#include <limits>
+#include <cstring>
 #include <iostream>
-#include <ostream>
-#include <stack>
+#include <locale>
+#include <sstream>
 #include <string>
 
+#include "NumberFormatter.hpp"
+#include "OutputSink.hpp"
+
 namespace SimpleXlsx
 {
 
 class XMLWriter
 {
     public:
+        //The buffer starts small and grows up to the size given to the constructor,
+        //so the small parts (rels, content types, styles) do not take a large one
+        static const size_t DefaultBufferSize = 1 << 20;
+        static const size_t InitialBufferSize = 4 << 10;
+
         inline XMLWriter( const std::string & FileName ) : m_TagOpen( false ), m_SelfClosed( true )
         {
-            Init( FileName );
+            assert( ! FileName.empty() );
+            Init( new FileSink( FileName ), true, DefaultBufferSize, true );
+        }
+
+        //Writes into the sink (for example, directly into an archive item, into memory or to the user function).
+        //If OwnSink is true, XMLWriter deletes the sink after the last flush.
+        //Without the declaration the writer makes a fragment to be inserted into another document (see Raw).
+        inline XMLWriter( OutputSink * Sink, bool OwnSink = true, size_t BufferSize = DefaultBufferSize, bool WithDeclaration = true ) :
+            m_TagOpen( false ), m_SelfClosed( true )
+        {
+            assert( Sink != NULL );
+            Init( Sink, OwnSink, BufferSize, WithDeclaration );
         }
 
         inline ~XMLWriter()
         {
-            EndAll();
-            DebugCheckIsLightTagOpened();
+            Close();
+            if( m_OwnSink ) delete m_Sink;
+            delete[] m_Buffer;
+        }
+
+        //Closes all the tags, passes the rest of the data and closes the own sink (the destructor does it too).
+        //Returns false if the document has not been written completely.
+        inline bool Close()
+        {
+            if( ! m_Closed )
+            {
+                m_Closed = true;
+                EndAll();
+                DebugCheckIsLightTagOpened();
+                if( Flush() && m_OwnSink && ! m_Sink->Close() ) m_WriteFailed = true;
+            }
+            return IsOk();
         }
 
         inline bool IsOk() const
         {
-            return m_OStream.is_open();
+            return m_Sink->IsOk() && ! m_WriteFailed;
+        }
+
+        //Passes the buffered data to the sink
+        inline bool Flush()
+        {
+            const size_t Size = m_Pos - m_Buffer;
+            m_Pos = m_Buffer;
+            if( ( Size != 0 ) && ! m_WriteFailed && ! m_Sink->Write( m_Buffer, Size ) ) m_WriteFailed = true;
+            return ! m_WriteFailed;
         }
 
         //Returns the current precision of floating point
         std::streamsize GetFloatPrecision()
         {
-            return m_OStream.precision();
+            return m_FloatPrecision;
         }
 
         //Set the current precision for floating point.
+        //0 (by default) - the shortest text which is read back into the same value.
         //Returns the precision before the call this function.
         std::streamsize SetFloatPrecision( std::streamsize NewPrecision )
         {
-            return m_OStream.precision( NewPrecision );
+            const std::streamsize Result = m_FloatPrecision;
+            m_FloatPrecision = NewPrecision;
+            return Result;
         }
 
         //Light version without using stack of Tag Names.
@@ -72,7 +118,8 @@ class XMLWriter
             assert( TagName != NULL );
             DebugCheckAndIncLightTag();
             CloseOpenedTag();
-            m_OStream << '<' << TagName;
+            Put( '<' );
+            Write( TagName );
             m_TagOpen = true;
             m_SelfClosed = false;
             return * this;
@@ -84,40 +131,62 @@ class XMLWriter
         inline XMLWriter & EndL()
         {
             DebugCheckAndDecLightTag();
-            m_OStream << "/>";
+            Write( "/>", 2 );
             m_TagOpen = false;
             return * this;
         }
 
+        //The name is not copied, it must live until the tag is closed (string literals are used everywhere).
+        //The tags nested deeper than MaxTagDepth fail the writer (see IsOk).
         inline XMLWriter & Tag( const char * TagName )
         {
             assert( TagName != NULL );
+            if( m_TagDepth >= MaxTagDepth )
+            {
+                m_WriteFailed = true;
+                m_TagDepth++;   // only counted, so that its End is matched
+                return * this;
+            }
             CloseOpenedTag();
             DebugCheckIsLightTagOpened();
-            m_OStream << '<' << TagName;
+            const size_t NameLength = strlen( TagName );
+            Put( '<' );
+            Write( TagName, NameLength );
             m_TagOpen = true;
             m_SelfClosed = true;
-            m_Tags.push( TagName );
+            m_Tags[ m_TagDepth ].Name = TagName;
+            m_Tags[ m_TagDepth ].Length = NameLength;
+            m_TagDepth++;
             return * this;
         }
 
         inline XMLWriter & End( const char * TagName = NULL )
         {
-            assert( ! m_Tags.empty() );
+            assert( m_TagDepth > 0 );
+            if( m_TagDepth == 0 )
+            {
+                m_WriteFailed = true;
+                return * this;
+            }
+            if( m_TagDepth > MaxTagDepth )
+            {
+                m_TagDepth--;   // the tag beyond the stack, the writer has failed already
+                return * this;
+            }
             DebugCheckIsLightTagOpened();
-            if( m_SelfClosed ) m_OStream << "/>";
-            else m_OStream << "</" << m_Tags.top() << '>';
+            const TagEntry & Top = m_Tags[ --m_TagDepth ];
+            if( m_SelfClosed ) Write( "/>", 2 );
+            else WriteClosingTag( Top.Name, Top.Length );
 #ifndef NDEBUG
             if( TagName != NULL )
             {
-                if( m_Tags.top() != TagName )
-                    std::cerr << "Wrong TagName for End: " << TagName << ". Wanted: " << m_Tags.top() << std::endl;
-                assert( m_Tags.top() == TagName );
+                if( strcmp( Top.Name, TagName ) != 0 )
+                    std::cerr << "Wrong TagName for End: " << TagName << ". Wanted: " << Top.Name << std::endl;
+                assert( strcmp( Top.Name, TagName ) == 0 );
             }
 #else
             ( void )TagName;
 #endif
-            m_Tags.pop();
             m_TagOpen = false;
             m_SelfClosed = false;
             return * this;
@@ -125,7 +194,7 @@ class XMLWriter
 
         inline XMLWriter & EndAll()
         {
-            while( ! m_Tags.empty() )
+            while( m_TagDepth > 0 )
                 this->End();
             return * this;
         }
@@ -135,9 +204,10 @@ class XMLWriter
             assert( TagName != NULL );
             CloseOpenedTag();
             DebugCheckIsLightTagOpened();
-            m_OStream << '<' << TagName << '>';
-            WriteStringEscape( ContentString );
-            m_OStream << "</" << TagName << '>';
+            const size_t NameLength = strlen( TagName );
+            WriteOpeningTag( TagName, NameLength );
+            WriteStringEscape( ContentString, true );
+            WriteClosingTag( TagName, NameLength );
             m_SelfClosed = false;
             return * this;
         }
@@ -153,7 +223,10 @@ class XMLWriter
         {
             CloseOpenedTag();
             DebugCheckIsLightTagOpened();
-            m_OStream << '<' << TagName << '>' << Value << "</" << TagName << '>';
+            const size_t NameLength = strlen( TagName );
+            WriteOpeningTag( TagName, NameLength );
+            WriteValue( Value );
+            WriteClosingTag( TagName, NameLength );
             m_SelfClosed = false;
             return *this;
         }
@@ -166,7 +239,9 @@ class XMLWriter
         {
             assert( AttrName != NULL );
             assert( m_TagOpen );
-            m_OStream << ' ' << AttrName << "=\"" << String << '"';
+            WriteAttrName( AttrName );
+            Write( String );
+            Put( '"' );
             return * this;
         }
 
@@ -188,9 +263,9 @@ class XMLWriter
         {
             assert( AttrName != NULL );
             assert( m_TagOpen );
-            m_OStream.put( ' ' );
-            m_OStream << AttrName << "=\"" << Value;
-            m_OStream.put( '"' );
+            WriteAttrName( AttrName );
+            WriteValue( Value );
+            Put( '"' );
             return *this;
         }
 
@@ -202,7 +277,7 @@ class XMLWriter
         {
             CloseOpenedTag();
             DebugCheckIsLightTagOpened();
-            WriteStringEscape( String );
+            WriteStringEscape( String, true );
             m_SelfClosed = false;
             return * this;
         }
@@ -225,7 +300,7 @@ class XMLWriter
         {
             CloseOpenedTag();
             DebugCheckIsLightTagOpened();
-            m_OStream << Value;
+            WriteValue( Value );
             m_SelfClosed = false;
             return *this;
         }
@@ -233,63 +308,270 @@ class XMLWriter
         template <typename _T>
         inline XMLWriter & Cont( _T * Value );
 
+        //Writes the ready markup as is, without escaping. The opened tag is closed before.
+        inline XMLWriter & Raw( const char * Data, size_t Size )
+        {
+            CloseOpenedTag();
+            DebugCheckIsLightTagOpened();
+            Write( Data, Size );
+            m_SelfClosed = false;
+            return * this;
+        }
+
+        inline XMLWriter & Raw( const std::string & Markup )
+        {
+            return Raw( Markup.c_str(), Markup.size() );
+        }
+
+        //Closes the opened tag and passes all the markup written so far to the sink,
+        //so that another writer can continue it (see Resume)
+        inline bool Suspend()
+        {
+            CloseOpenedTag();
+            m_SelfClosed = false;
+            return Flush();
+        }
+
+        //Continues the markup of another writer: Data is what it has written after the declaration,
+        //Names are the tags it has left opened, the outermost first (the names are not copied)
+        inline XMLWriter & Resume( const char * Data, size_t Size, const char * const * Names, size_t Count )
+        {
+            if( m_TagDepth + Count > MaxTagDepth )
+            {
+                m_WriteFailed = true;
+                return * this;
+            }
+            CloseOpenedTag();
+            Write( Data, Size );
+            for( size_t i = 0; i < Count; i++, m_TagDepth++ )
+            {
+                m_Tags[ m_TagDepth ].Name = Names[ i ];
+                m_Tags[ m_TagDepth ].Length = strlen( Names[ i ] );
+            }
+            m_SelfClosed = false;
+            return * this;
+        }
+
+        //The XML declaration every document begins with
+        static inline const char * Declaration()
+        {
+            return "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n";
+        }
+
     private:
         bool                    m_TagOpen, m_SelfClosed;
-        std::ofstream           m_OStream;
-        std::stack<std::string> m_Tags;
-
-        inline void Init( const std::string & FileName )
+        OutputSink       *      m_Sink;             ///< destination of the buffered data
+        bool                    m_OwnSink;          ///< delete the sink in the destructor
+        bool                    m_WriteFailed;      ///< the sink has failed to accept the data
+        bool                    m_Closed;           ///< Close has been called
+        char             *      m_Buffer;           ///< output buffer
+        char             *      m_Pos;              ///< current position in the buffer
+        char             *      m_End;              ///< end of the buffer
+        size_t                  m_BufferLimit;      ///< size the buffer may grow up to
+        std::streamsize         m_FloatPrecision;   ///< 0 - the shortest round-trip text, otherwise significant digits
+
+        struct TagEntry
+        {
+            const char  *   Name;
+            size_t          Length;
+        };
+        static const size_t     MaxTagDepth = 64;
+        TagEntry                m_Tags[ MaxTagDepth ];  ///< names of the opened tags
+        size_t                  m_TagDepth;             ///< number of the opened tags
+
+        //Disable copy and assignment
+        XMLWriter( const XMLWriter & that );
+        XMLWriter & operator=( const XMLWriter & );
+
+        inline void Init( OutputSink * Sink, bool OwnSink, size_t BufferSize, bool WithDeclaration )
         {
-            assert( ! FileName.empty() );
-#ifndef NDEBUG
             m_LightTagCounter = 0;
-#endif
-            m_OStream.open( FileName.c_str(), std::ios_base::out );
-            m_OStream.imbue( std::locale( "C" ) );
-            SetFloatPrecision( std::numeric_limits<double>::digits10 + 1 );
-            m_OStream << "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n";
+            m_Sink = Sink;
+            m_OwnSink = OwnSink;
+            m_WriteFailed = false;
+            m_Closed = false;
+            if( BufferSize < 64 ) BufferSize = 64;
+            m_BufferLimit = BufferSize;
+            if( BufferSize > InitialBufferSize ) BufferSize = InitialBufferSize;
+            m_Buffer = new char[ BufferSize ];
+            m_Pos = m_Buffer;
+            m_End = m_Buffer + BufferSize;
+            m_FloatPrecision = 0;
+            m_TagDepth = 0;
+            if( WithDeclaration ) Write( Declaration() );
+        }
+
+        // *INDENT-OFF*   For AStyle tool
+        inline void Put( char Char )                        { if( m_Pos == m_End ) MakeRoom( 1 ); * m_Pos++ = Char; }
+        inline void Write( const char * String )            { Write( String, strlen( String ) ); }
+        // *INDENT-ON*   For AStyle tool
+
+        inline void Write( const char * Data, size_t Size )
+        {
+            if( Size <= static_cast<size_t>( m_End - m_Pos ) )
+            {
+                memcpy( m_Pos, Data, Size );
+                m_Pos += Size;
+            }
+            else WriteLong( Data, Size );
+        }
+
+        //The rest of the buffer is less than Size: the buffer grows up to its limit, then it is flushed
+        inline void MakeRoom( size_t Size )
+        {
+            const size_t Used = m_Pos - m_Buffer;
+            size_t Capacity = m_End - m_Buffer;
+            if( ( Capacity < m_BufferLimit ) && ( Used + Size <= m_BufferLimit ) )
+            {
+                while( Capacity < Used + Size ) Capacity *= 2;
+                if( Capacity > m_BufferLimit ) Capacity = m_BufferLimit;
+                char * Buffer = new char[ Capacity ];
+                memcpy( Buffer, m_Buffer, Used );
+                delete[] m_Buffer;
+                m_Buffer = Buffer;
+                m_Pos = m_Buffer + Used;
+                m_End = m_Buffer + Capacity;
+            }
+            else Flush();
+        }
+
+        //The data does not fit into the rest of the buffer
+        inline void WriteLong( const char * Data, size_t Size )
+        {
+            MakeRoom( Size );
+            if( Size <= static_cast<size_t>( m_End - m_Pos ) )
+            {
+                memcpy( m_Pos, Data, Size );
+                m_Pos += Size;
+            }
+            else if( ! m_WriteFailed && ! m_Sink->Write( Data, Size ) ) m_WriteFailed = true;
+        }
+
+        inline void WriteOpeningTag( const char * TagName, size_t NameLength )
+        {
+            Put( '<' );
+            Write( TagName, NameLength );
+            Put( '>' );
+        }
+
+        inline void WriteClosingTag( const char * TagName, size_t NameLength )
+        {
+            Write( "</", 2 );
+            Write( TagName, NameLength );
+            Put( '>' );
+        }
+
+        inline void WriteAttrName( const char * AttrName )
+        {
+            Put( ' ' );
+            Write( AttrName );
+            Write( "=\"", 2 );
         }
 
         inline void CloseOpenedTag()
         {
             if( ! m_TagOpen ) return;
-            m_OStream.put( '>' );
+            Put( '>' );
             m_TagOpen = false;
         }
 
-        inline void WriteStringEscape( const char * String )
+        //Numbers are converted by NumberFormatter, other types are written through a string stream
+        template <typename _T>
+        inline void WriteValue( const _T & Value )
+        {
+            std::ostringstream Stream;
+            Stream.imbue( std::locale::classic() );
+            if( m_FloatPrecision != 0 ) Stream.precision( m_FloatPrecision );
+            Stream << Value;
+            const std::string & Text = Stream.str();
+            Write( Text.c_str(), Text.size() );
+        }
+        // *INDENT-OFF*   For AStyle tool
+        inline void WriteValue( short Value )               { WriteInteger( static_cast<int64_t>( Value ) ); }
+        inline void WriteValue( int Value )                 { WriteInteger( static_cast<int64_t>( Value ) ); }
+        inline void WriteValue( long Value )                { WriteInteger( static_cast<int64_t>( Value ) ); }
+        inline void WriteValue( long long Value )           { WriteInteger( static_cast<int64_t>( Value ) ); }
+        inline void WriteValue( unsigned short Value )      { WriteInteger( static_cast<uint64_t>( Value ) ); }
+        inline void WriteValue( unsigned int Value )        { WriteInteger( static_cast<uint64_t>( Value ) ); }
+        inline void WriteValue( unsigned long Value )       { WriteInteger( static_cast<uint64_t>( Value ) ); }
+        inline void WriteValue( unsigned long long Value )  { WriteInteger( static_cast<uint64_t>( Value ) ); }
+        inline void WriteValue( float Value )               { WriteFloat( Value ); }
+        inline void WriteValue( double Value )              { WriteFloat( Value ); }
+        // *INDENT-ON*   For AStyle tool
+
+        template <typename _T>
+        inline void WriteInteger( _T Value )
+        {
+            if( static_cast<size_t>( m_End - m_Pos ) < NumberFormatter::BufferSize ) MakeRoom( NumberFormatter::BufferSize );
+            m_Pos += NumberFormatter::Format( Value, m_Pos );
+        }
+
+        template <typename _T>
+        inline void WriteFloat( _T Value )
+        {
+            if( m_FloatPrecision != 0 )
+            {
+                WriteValue<_T>( Value );
+                return;
+            }
+            if( static_cast<size_t>( m_End - m_Pos ) < NumberFormatter::BufferSize ) MakeRoom( NumberFormatter::BufferSize );
+            m_Pos += NumberFormatter::Format( Value, m_Pos );
+        }
+
+        //Clean runs of chars are found by SIMD scanning and copied at once
+        //In the element content a text like _xHHHH_ is escaped (see WriteUnderscore), in the attribute it is kept:
+        //VML uses such ids as they are
+        inline void WriteStringEscape( const char * String, bool IsContent )
         {
-            for( ; * String; String++ )
-                switch( * String )
+            for( ;; )
+            {
+                const char * Special = FindSpecialChar( String );
+                Write( String, Special - String );
+                switch( * Special )
                 {
-                    case '&'    :   m_OStream << "&amp;";        break;
-                    case '<'    :   m_OStream << "&lt;";         break;
-                    case '>'    :   m_OStream << "&gt;";         break;
-                    case '\''   :   m_OStream << "&apos;";       break;
-                    case '"'    :   m_OStream << "&quot;";       break;
-                    default     :   m_OStream.put( * String );   break;
+                    case '\0'   :   return;
+                    case '&'    :   Write( "&amp;", 5 );    break;
+                    case '<'    :   Write( "&lt;", 4 );     break;
+                    case '>'    :   Write( "&gt;", 4 );     break;
+                    case '\''   :   Write( "&apos;", 6 );   break;
+                    case '"'    :   Write( "&quot;", 6 );   break;
+                    case '_'    :
+                        if( IsContent ) WriteUnderscore( Special );
+                        else Put( '_' );
+                        break;
+                    case '\t'   :
+                    case '\n'   :
+                    case '\r'   :   Put( * Special );       break;
+                    default     :   WriteControlChar( * Special );  break;
                 }
+                String = Special + 1;
+            }
         }
 
+        //Returns the first char to be escaped or the terminating zero
+        static const char * FindSpecialChar( const char * String );
+        void WriteControlChar( char Char );
+        void WriteUnderscore( const char * Underscore );
+
         //Write an attribute for the current Tag
         inline XMLWriter & AttrInt( const char * AttrName, const char * String )
         {
             assert( AttrName != NULL );
             assert( m_TagOpen );
-            m_OStream << ' ' << AttrName << "=\"";
-            WriteStringEscape( String );
-            m_OStream.put( '"' );
+            WriteAttrName( AttrName );
+            WriteStringEscape( String, false );
+            Put( '"' );
             return * this;
         }
 
-        //Debug version for checking TagL and EndL
+        //Debug version for checking TagL and EndL. The counter exists in any build, so that the layout
+        //is the same for the library and the code inlined into the application built otherwise.
+        intptr_t    m_LightTagCounter;
 #ifdef NDEBUG
         inline void DebugCheckAndIncLightTag()      {}
         inline void DebugCheckAndDecLightTag()      {}
         inline void DebugCheckIsLightTagOpened()    {}
 #else
-        intptr_t    m_LightTagCounter;
-
         inline void DebugCheckAndIncLightTag()
         {
             assert( m_LightTagCounter == 0 );
@@ -82,7 +82,7 @@ bool CChart::Save()
     // [- /xl/charts/chartX.xml
     if( m_seriesSet.empty() ) return false;
 
-    std::stringstream FileName;
+    ClassicStream FileName;
     FileName << "/xl/charts/chart" << m_index << ".xml";
     XMLWriter xmlw( m_pathManager.RegisterXML( FileName.str() ) );
 
@@ -952,7 +952,7 @@ void CChart::AddDataLabels( XMLWriter & xmlw, const CChart::DataLabels & dataLab
 std::string CChart::CellRangeString( const std::string & Title, const CellCoord & CellFrom, const CellCoord & szCellTo )
 {
     CellCoord::TConvBuf Buffer;
-    std::stringstream RangeStream;
+    ClassicStream RangeStream;
     RangeStream << '\'' << Title << "\'!$" << CellFrom.ToString( Buffer ) << ":$" << szCellTo.ToString( Buffer );
     return RangeStream.str();
 }
@@ -66,10 +66,10 @@ CChartsheet::CChartsheet( size_t index, CChart & chart, CDrawing & drawing, Path
     {
         {
             // [- /xl/chartsheets/_rels/sheetX.xml.rels
-            std::stringstream FileName;
+            ClassicStream FileName;
             FileName << "/xl/chartsheets/_rels/sheet" << m_index << ".xml.rels";
 
-            std::stringstream Target;
+            ClassicStream Target;
             Target << "../drawings/drawing" << m_Drawing.GetIndex() << ".xml";
 
             XMLWriter xmlw( m_pathManager.RegisterXML( FileName.str() ) );
@@ -82,7 +82,7 @@ CChartsheet::CChartsheet( size_t index, CChart & chart, CDrawing & drawing, Path
 
         {
             // [- /xl/chartsheets/sheetX.xml
-            std::stringstream FileName;
+            ClassicStream FileName;
             FileName << "/xl/chartsheets/sheet" << m_index << ".xml";
 
             XMLWriter xmlw( m_pathManager.RegisterXML( FileName.str() ) );
@@ -51,7 +51,7 @@ namespace SimpleXlsx
     // [- /xl/drawings/_rels/drawingX.xml.rels
     void CDrawing::SaveDrawingRels()
     {
-        std::stringstream FileName;
+        ClassicStream FileName;
         FileName << "/xl/drawings/_rels/drawing" << m_index << ".xml.rels";
 
         XMLWriter xmlw( m_pathManager.RegisterXML( FileName.str() ) );
@@ -59,7 +59,7 @@ namespace SimpleXlsx
         int rId = 1;
         for( std::vector<DrawingInfo>::const_iterator it = m_drawings.begin(); it != m_drawings.end(); it++, rId++ )
         {
-            std::stringstream Target, rIdStream;
+            ClassicStream Target, rIdStream;
             const char * TypeString = NULL;
             switch( ( * it ).AType )
             {
@@ -88,7 +88,7 @@ namespace SimpleXlsx
     // [- /xl/drawings/drawingX.xml
     void CDrawing::SaveDrawing()
     {
-        std::stringstream FileName;
+        ClassicStream FileName;
         FileName << "/xl/drawings/drawing" << m_index << ".xml";
 
         XMLWriter xmlw( m_pathManager.RegisterXML( FileName.str() ) );
@@ -142,7 +142,7 @@ namespace SimpleXlsx
 
     void CDrawing::SaveChartSection( XMLWriter & xmlw, CChart * chart, int rId )
     {
-        std::stringstream rIdStream;
+        ClassicStream rIdStream;
         rIdStream << "rId" << rId;
 
         xmlw.Tag( "xdr:graphicFrame" ).Attr( "macro", "" ).Tag( "xdr:nvGraphicFramePr" );
@@ -165,7 +165,7 @@ namespace SimpleXlsx
 
     void CDrawing::SaveImageSection( XMLWriter & xmlw, CImage * image, int rId )
     {
-        std::stringstream rIdStream;
+        ClassicStream rIdStream;
         rIdStream << "rId" << rId;
 
         xmlw.Tag( "xdr:pic" ).Tag( "xdr:nvPicPr" );
@@ -0,0 +1,248 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_RECORDS_H
+#define XLSX_RECORDS_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Worksheet.h"
+#include "SharedStrings.h"
+
+#include "../NumberFormatter.hpp"
+#include "../XMLWriter.hpp"
+
+// ****************************************************************************
+/// @brief  Describes the fields of the structure written by CWorksheet::AddRecords,
+///         one cell per field in the given order. Must be used at the global scope.
+/// @note   Supported field types are int32_t, uint32_t, int64_t, uint64_t, float,
+///         double, const char *, char arrays and std::string (up to 32 fields)
+/// @example
+///         struct Trade { int64_t id; std::string ticker; double price; };
+///         XLSX_RECORD( Trade, id, ticker, price )
+///         ...
+///         sheet.AddRecords( trades, styles );
+// ****************************************************************************
+#define XLSX_RECORD( Type, ... )                                                            \
+    namespace SimpleXlsx {                                                                  \
+    template<> struct RecordSchema< Type >                                                  \
+    {                                                                                       \
+        enum { FieldCount = XLSX_RECORD_COUNT( __VA_ARGS__ ) };                             \
+        template<typename Visitor>                                                          \
+        static inline void Visit( Visitor & V, const Type & R )                             \
+        {                                                                                   \
+            XLSX_RECORD_EXPAND( XLSX_RECORD_CONCAT( XLSX_RECORD_FIELDS_,                    \
+                                XLSX_RECORD_COUNT( __VA_ARGS__ ) )( XLSX_RECORD_FIELD, __VA_ARGS__ ) ) \
+        }                                                                                   \
+    };                                                                                      \
+    }
+
+#define XLSX_RECORD_FIELD( Field ) V( R.Field );
+#define XLSX_RECORD_EXPAND( x ) x
+#define XLSX_RECORD_CONCAT( a, b ) XLSX_RECORD_CONCAT_IMPL( a, b )
+#define XLSX_RECORD_CONCAT_IMPL( a, b ) a##b
+
+#define XLSX_RECORD_FIELDS_1( M, F ) M( F )
+#define XLSX_RECORD_FIELDS_2( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_1( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_3( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_2( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_4( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_3( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_5( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_4( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_6( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_5( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_7( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_6( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_8( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_7( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_9( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_8( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_10( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_9( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_11( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_10( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_12( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_11( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_13( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_12( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_14( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_13( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_15( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_14( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_16( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_15( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_17( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_16( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_18( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_17( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_19( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_18( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_20( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_19( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_21( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_20( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_22( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_21( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_23( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_22( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_24( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_23( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_25( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_24( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_26( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_25( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_27( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_26( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_28( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_27( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_29( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_28( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_30( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_29( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_31( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_30( M, __VA_ARGS__ ) )
+#define XLSX_RECORD_FIELDS_32( M, F, ... ) M( F ) XLSX_RECORD_EXPAND( XLSX_RECORD_FIELDS_31( M, __VA_ARGS__ ) )
+
+#define XLSX_RECORD_COUNT( ... ) XLSX_RECORD_EXPAND( XLSX_RECORD_COUNT_N( __VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 ) )
+#define XLSX_RECORD_COUNT_N( _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ... ) N
+
+namespace SimpleXlsx
+{
+//Schema of the structure, specialized by XLSX_RECORD
+template<typename Record> struct RecordSchema;
+
+//Whether the field goes to the shared strings
+template<typename T> struct RecordFieldTraits                   { static const bool IsString = false; };
+template<> struct RecordFieldTraits<const char *>               { static const bool IsString = true; };
+template<> struct RecordFieldTraits<char *>                     { static const bool IsString = true; };
+template<> struct RecordFieldTraits<std::string>                { static const bool IsString = true; };
+template<size_t N> struct RecordFieldTraits<char[ N ]>          { static const bool IsString = true; };
+
+// ****************************************************************************
+/// @brief  Writes a block of rows with the fixed set of columns. The row header,
+///         cell references and style attributes are prepared once for the block,
+///         only the values and the row number are formatted for a row.
+// ****************************************************************************
+class CWorksheet::CellBlockWriter
+{
+    public:
+        CellBlockWriter( CWorksheet & Sheet, size_t ColumnCount, uint32_t Offset, double Height );
+        ~CellBlockWriter();
+
+        //Prepares the markup of the column, must be called for all the columns before the first row
+        void SetColumn( size_t Column, size_t Style, bool IsString );
+
+        inline void BeginRow()
+        {
+            m_Field = 0;
+            m_RowLength = NumberFormatter::Format( static_cast<uint64_t>( ++m_Sheet.m_row_index ), m_RowDigits );
+            m_XMLWriter.Raw( "<row r=\"", 8 ).Raw( m_RowDigits, m_RowLength ).Raw( m_RowTail );
+        }
+
+        inline void EndRow()
+        {
+            m_XMLWriter.Raw( "</row>", 6 );
+        }
+
+        template<typename T>
+        inline void Number( size_t Column, T Value )
+        {
+            const CellMarkup & Cell = m_Markup[ Column ];
+            m_XMLWriter.Raw( Cell.Head ).Raw( m_RowDigits, m_RowLength ).Raw( Cell.Tail ).Cont( Value ).Raw( "</v></c>", 8 );
+        }
+
+        inline void String( size_t Column, const char * Value, size_t Length )
+        {
+            if( Length == 0 )
+                Empty( Column );
+            else if( Value[ 0 ] == '=' )    // formula goes the usual way
+                Formula( Column, Value );
+            else
+            {
+                assert( m_Sheet.m_sharedStrings != NULL );
+                Number( Column, m_Sheet.m_sharedStrings->Add( Value, Length ) );
+            }
+        }
+
+        inline void Empty( size_t Column )
+        {
+            const CellMarkup & Cell = m_Markup[ Column ];
+            if( ! Cell.EmptyTail.empty() )  // empty cell with style
+                m_XMLWriter.Raw( Cell.Head ).Raw( m_RowDigits, m_RowLength ).Raw( Cell.EmptyTail );
+        }
+
+        // *INDENT-OFF*   For AStyle tool
+        //Fields of the record, one by one from the row begining
+        inline void operator()( int32_t Value )             { Number( m_Field++, Value ); }
+        inline void operator()( uint32_t Value )            { Number( m_Field++, Value ); }
+        inline void operator()( int64_t Value )             { Number( m_Field++, Value ); }
+        inline void operator()( uint64_t Value )            { Number( m_Field++, Value ); }
+        inline void operator()( float Value )               { Number( m_Field++, Value ); }
+        inline void operator()( double Value )              { Number( m_Field++, Value ); }
+        inline void operator()( const char * Value )        { String( m_Field++, Value, ( Value != NULL ) ? strlen( Value ) : 0 ); }
+        inline void operator()( const std::string & Value ) { String( m_Field++, Value.c_str(), Value.size() ); }
+        // *INDENT-ON*   For AStyle tool
+
+    private:
+        //Markup of a cell of the column: Head + row digits + Tail + value + "</v></c>", or Head + row digits + EmptyTail
+        struct CellMarkup
+        {
+            std::string Head, Tail, EmptyTail;
+            size_t      Style;
+
+            CellMarkup() : Style( 0 ) {}
+        };
+
+        void Formula( size_t Column, const char * Value );
+
+        CWorksheet          &   m_Sheet;
+        XMLWriter           &   m_XMLWriter;
+        uint32_t                m_Offset;
+        std::string             m_RowTail;          ///< row attributes after the row number
+        std::vector<CellMarkup> m_Markup;
+        NumberFormatter::TBuffer m_RowDigits;       ///< number of the current row
+        size_t                  m_RowLength;
+        size_t                  m_Field;            ///< next field of the record
+};
+
+//Collects the kinds of the record fields
+class RecordFieldKinds
+{
+    public:
+        std::vector<bool> IsString;
+
+        template<typename T>
+        inline void operator()( const T & )
+        {
+            IsString.push_back( RecordFieldTraits<T>::IsString );
+        }
+};
+
+// ****************************************************************************
+/// @brief  Appends the records as rows, one cell per field described by XLSX_RECORD
+/// @param  records records to be added
+/// @param  styles style indexes of the fields (default style for missed ones)
+/// @param  offset the offset from the row begining (0 by default)
+/// @param	height row height (default if 0)
+/// @return Reference to this object
+// ****************************************************************************
+template<typename Record>
+CWorksheet & CWorksheet::AddRecords( const std::vector<Record> & records, const std::vector<size_t> & styles, uint32_t offset, double height )
+{
+    typedef RecordSchema<Record> Schema;
+
+    EndRow();
+    if( records.empty() )
+        return * this;
+
+    RecordFieldKinds Kinds;
+    Schema::Visit( Kinds, records.front() );
+
+    CellBlockWriter Writer( * this, Schema::FieldCount, offset, height );
+    for( size_t i = 0; i < Schema::FieldCount; i++ )
+        Writer.SetColumn( i, ( i < styles.size() ) ? styles[ i ] : 0, Kinds.IsString[ i ] );
+
+    for( typename std::vector<Record>::const_iterator it = records.begin(); it != records.end(); it++ )
+    {
+        Writer.BeginRow();
+        Schema::Visit( Writer, * it );
+        Writer.EndRow();
+    }
+    return * this;
+}
+
+} // namespace SimpleXlsx
+
+#endif	// XLSX_RECORDS_H
@@ -0,0 +1,173 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "RowBlock.h"
+
+#include "../OutputSink.hpp"
+#include "../XMLWriter.hpp"
+
+namespace SimpleXlsx
+{
+// ****************************************************************************
+/// @brief  The constructor reserves the rows and prepares the buffer of the block
+/// @param  Sheet the sheet the rows belong to
+/// @param  Count number of the rows
+/// @note   The block of a finished sheet gets no rows and is failed (see IsOk)
+// ****************************************************************************
+CRowBlock::CRowBlock( CWorksheet & Sheet, uint32_t Count ) : m_Sheet( Sheet ), m_Data( new CWorksheet::RowBlockData ),
+    m_rowCount( Count ), m_current_column( 0 ), m_row_opened( false )
+{
+    m_firstRow = Sheet.ReserveRows( m_rowCount, m_Data->Sequence );
+    m_failed = ( m_firstRow == 0 );
+    m_row_index = m_failed ? 0 : m_firstRow - 1;
+    m_XMLWriter = new XMLWriter( new MemorySink( m_Data->Markup ), true, BufferSize, false );
+}
+
+CRowBlock::~CRowBlock()
+{
+    Submit();   //the result can not be returned from here
+}
+
+// ****************************************************************************
+/// @brief	Generates a header for another row, if there is a reserved row left
+/// @param	height row height (default if 0)
+/// @return	Reference to this object
+/// @note   Beyond the reserved rows the block fails (see IsOk) and Submit drops its rows
+// ****************************************************************************
+CRowBlock & CRowBlock::BeginRow( double height )
+{
+    EndRow();
+    if( m_failed || ( m_row_index - m_firstRow + 1 >= m_rowCount ) )
+    {
+        m_failed = true;
+        return * this;
+    }
+    CWorksheet::WriteRowTag( * m_XMLWriter, ++m_row_index, height );
+
+    m_current_column = 0;
+    m_row_opened = true;
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief	Closes previously began row
+/// @return	Reference to this object
+// ****************************************************************************
+CRowBlock & CRowBlock::EndRow()
+{
+    if( ! m_row_opened )
+        return * this;
+    m_XMLWriter->End( "row" );
+    m_row_opened = false;
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief	Add string-formatted cell with specified style, the same way CWorksheet::AddCell does
+/// @param	value the string, or the formula beginning with '='
+/// @param	style_id style index
+/// @return	Reference to this object
+// ****************************************************************************
+CRowBlock & CRowBlock::AddCell( const char * value, size_t style_id )
+{
+    if( ! m_failed )
+    {
+        const char * Formula = CWorksheet::WriteStringCell( * m_XMLWriter, m_cellRef, m_row_index, m_current_column,
+                                                            m_Sheet.m_sharedStrings, value, style_id );
+        if( Formula != NULL ) m_Data->CalcChain.push_back( Formula );
+    }
+    m_current_column++;
+    return * this;
+}
+
+//Appends the numeric cell. The cells after a row refused by BeginRow are skipped.
+template<typename T>
+CRowBlock & CRowBlock::AddNumber( T value, size_t style_id )
+{
+    if( ! m_failed )
+        CWorksheet::WriteNumberCell( * m_XMLWriter, m_cellRef.Get( m_row_index, m_current_column ), value, style_id );
+    m_current_column++;
+    return * this;
+}
+
+CRowBlock & CRowBlock::AddCell( const CellDataTime & data )
+{
+    return AddNumber( data.XlsxValue(), data.style_id );
+}
+
+CRowBlock & CRowBlock::AddCell( int32_t value, size_t style_id )
+{
+    return AddNumber( value, style_id );
+}
+
+CRowBlock & CRowBlock::AddCell( uint32_t value, size_t style_id )
+{
+    return AddNumber( value, style_id );
+}
+
+CRowBlock & CRowBlock::AddCell( int64_t value, size_t style_id )
+{
+    return AddNumber( value, style_id );
+}
+
+CRowBlock & CRowBlock::AddCell( uint64_t value, size_t style_id )
+{
+    return AddNumber( value, style_id );
+}
+
+CRowBlock & CRowBlock::AddCell( float value, size_t style_id )
+{
+    return AddNumber( value, style_id );
+}
+
+CRowBlock & CRowBlock::AddCell( double value, size_t style_id )
+{
+    return AddNumber( value, style_id );
+}
+
+// ****************************************************************************
+/// @brief  Passes the rows to the sheet
+/// @return Boolean result of the operation, false if the sheet is already finished
+// ****************************************************************************
+bool CRowBlock::Submit()
+{
+    if( m_Data == NULL ) return false;  //already submitted
+    EndRow();
+    bool Result = m_XMLWriter->Flush() && ! m_failed;
+    delete m_XMLWriter;
+    m_XMLWriter = NULL;
+    if( m_firstRow == 0 )   //the sheet has refused the reservation, there is nothing to submit
+    {
+        delete m_Data;
+        m_Data = NULL;
+        return false;
+    }
+    if( ! Result )
+    {
+        m_Data->Markup.clear();
+        m_Data->CalcChain.clear();
+    }
+    if( ! m_Sheet.SubmitRows( m_Data ) ) Result = false;
+    m_Data = NULL;
+    return Result;
+}
+
+} // namespace SimpleXlsx
@@ -0,0 +1,107 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_ROW_BLOCK_H
+#define XLSX_ROW_BLOCK_H
+
+#include "Worksheet.h"
+
+namespace SimpleXlsx
+{
+// ****************************************************************************
+/// @brief  The class CRowBlock is a range of consecutive rows of a worksheet which is filled
+///         apart from the sheet, for example by one of the threads producing the rows of the
+///         same sheet. The constructor reserves the rows, the rows are formatted into the own
+///         buffer of the block, and Submit passes them to the sheet. The sheet writes the blocks
+///         in the order of their reservation, whatever order they are submitted in.
+// ****************************************************************************
+class CRowBlock
+{
+    public:
+        //Reserves the next Count rows of the sheet (fewer if the sheet limit is reached).
+        //The blocks of a sheet may be reserved, filled and submitted on different threads at once.
+        //Rows must not be added to the sheet itself until all its blocks are submitted.
+        //All the blocks must be submitted before the workbook is saved and, in the streaming mode,
+        //before the next sheet is added: the sheet is finished then, and its rows reserved by a block
+        //not submitted stay empty (the save fails). The block of a finished sheet gets no rows (see IsOk).
+        CRowBlock( CWorksheet & Sheet, uint32_t Count );
+        //Submits the block if it is not submitted yet. The result is lost: call Submit to check it.
+        ~CRowBlock();
+
+        // *INDENT-OFF*   For AStyle tool
+        //Number of the first reserved row (from 1, 0 if the sheet is finished) and the number of the reserved rows
+        inline uint32_t FirstRow() const            { return m_firstRow; }
+        inline uint32_t RowCount() const            { return m_rowCount; }
+        inline uint32_t CurrentRowIndex() const     { return m_row_index; }
+        inline uint32_t CurrentColumnIndex() const  { return m_current_column; }
+        //Returns false if the sheet is finished or BeginRow has been refused: the block is failed and Submit drops its rows
+        inline bool IsOk() const                    { return ! m_failed; }
+
+        //Opens the next reserved row. Beyond the reserved rows no row is opened and the block fails.
+        CRowBlock & BeginRow( double height = 0.0 );
+        CRowBlock & EndRow();
+
+        inline CRowBlock & AddCell()                                        { m_current_column++; return * this; }
+        inline CRowBlock & AddEmptyCells( uint32_t Count )                  { m_current_column += Count; return * this; }
+
+        CRowBlock & AddCell( const char * value, size_t style_id = 0 );
+        inline CRowBlock & AddCell( const std::string & value, size_t style_id = 0 )    { return AddCell( value.c_str(), style_id ); }
+        inline CRowBlock & AddCell( const std::wstring & value, size_t style_id = 0 )   { return AddCell( UTF8Encoder::From_wstring( value ), style_id ); }
+        inline CRowBlock & AddCell( const CellDataStr & data )                          { return AddCell( data.value, data.style_id ); }
+        CRowBlock & AddCell( const CellDataTime & data );
+
+        CRowBlock & AddCell( int32_t value, size_t style_id = 0 );
+        CRowBlock & AddCell( uint32_t value, size_t style_id = 0 );
+        CRowBlock & AddCell( int64_t value, size_t style_id = 0 );
+        CRowBlock & AddCell( uint64_t value, size_t style_id = 0 );
+        CRowBlock & AddCell( float value, size_t style_id = 0 );
+        CRowBlock & AddCell( double value, size_t style_id = 0 );
+        // *INDENT-ON*   For AStyle tool
+
+        //Passes the rows to the sheet. Returns false if they can not be formatted, the block has failed
+        //(see IsOk) or the sheet has been finished meanwhile: then the rows are dropped. The block is not usable after.
+        bool Submit();
+
+    private:
+        //Disable copy and assignment
+        CRowBlock( const CRowBlock & that );
+        CRowBlock & operator=( const CRowBlock & );
+
+        template<typename T>
+        CRowBlock & AddNumber( T value, size_t style_id );
+
+        static const size_t BufferSize = 1 << 16;
+
+        CWorksheet                  &   m_Sheet;            ///< the sheet the rows are reserved in
+        CWorksheet::RowBlockData    *   m_Data;             ///< the rows until they are submitted, NULL after
+        XMLWriter                   *   m_XMLWriter;        ///< writes the rows into m_Data
+        uint32_t                        m_firstRow;         ///< first reserved row
+        uint32_t                        m_rowCount;         ///< number of the reserved rows
+        uint32_t                        m_row_index;        ///< current row
+        uint32_t                        m_current_column;   ///< column of the next cell
+        bool                            m_row_opened;       ///< the row tag is opened
+        bool                            m_failed;           ///< the sheet is finished or more rows than reserved have been begun
+        CWorksheet::CellReference       m_cellRef;          ///< reference of the current cell
+};
+
+} // namespace SimpleXlsx
+
+#endif	// XLSX_ROW_BLOCK_H
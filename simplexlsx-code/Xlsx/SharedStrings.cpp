@@ -0,0 +1,169 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SharedStrings.h"
+
+namespace SimpleXlsx
+{
+    static const size_t MinSlotCount = 64;  // of every shard
+
+    CSharedStrings::CSharedStrings() : m_count( 0 )
+    {
+        for( size_t i = 0; i < ShardCount; i++ )
+        {
+            m_shards[ i ].Offsets.push_back( 0 );
+            Rehash( m_shards[ i ], MinSlotCount );
+        }
+    }
+
+    CSharedStrings::CSharedStrings( const CSharedStrings & that ) : m_count( 0 )
+    {
+        * this = that;
+    }
+
+    //Copies the strings and the indexes, the locks are not copied
+    CSharedStrings & CSharedStrings::operator=( const CSharedStrings & that )
+    {
+        for( size_t i = 0; i < ShardCount; i++ )
+            m_shards[ i ] = that.m_shards[ i ];
+        m_count = that.m_count.load();
+        return * this;
+    }
+
+    // ****************************************************************************
+    /// @brief  Reserves memory for the expected number of unique strings
+    /// @param  Count expected number of unique strings
+    /// @param  Bytes expected total length of the unique strings in bytes
+    /// @return no
+    // ****************************************************************************
+    void CSharedStrings::Reserve( size_t Count, size_t Bytes )
+    {
+        //The hash spreads the strings over the shards evenly, a little margin covers the deviation
+        const size_t ShardStrings = Count / ShardCount + Count / ShardCount / 8 + 1;
+        const size_t ShardBytes = Bytes / ShardCount + Bytes / ShardCount / 8;
+        for( size_t i = 0; i < ShardCount; i++ )
+        {
+            Shard & Target = m_shards[ i ];
+            std::lock_guard<std::mutex> Lock( m_locks[ i ] );
+            Target.Offsets.reserve( ShardStrings + 1 );
+            Target.Indexes.reserve( ShardStrings );
+            Target.Arena.reserve( ShardBytes + ShardStrings );  // with terminating zeros
+
+            size_t SlotCount = Target.Slots.size();
+            while( SlotCount < ShardStrings * 2 ) SlotCount *= 2;
+            if( SlotCount != Target.Slots.size() ) Rehash( Target, SlotCount );
+        }
+    }
+
+    // ****************************************************************************
+    /// @brief  Finds the string in its shard or adds it there with the next index
+    /// @param  String string to be found (not necessarily zero-terminated)
+    /// @param  Length string length in bytes
+    /// @return Index of the string
+    // ****************************************************************************
+    uint64_t CSharedStrings::Add( const char * String, size_t Length )
+    {
+        const uint32_t StrHash = Hash( String, Length );
+        const size_t ShardIndex = StrHash >> ( 32 - ShardBits );
+        Shard & Target = m_shards[ ShardIndex ];
+        std::lock_guard<std::mutex> Lock( m_locks[ ShardIndex ] );
+
+        if( ( Target.Indexes.size() + 1 ) * 2 > Target.Slots.size() ) Rehash( Target, Target.Slots.size() * 2 );   // keep the load factor below 0.5
+
+        const size_t Mask = Target.Slots.size() - 1;
+        size_t Pos = StrHash & Mask;
+        for( ; Target.Slots[ Pos ].Index != 0; Pos = ( Pos + 1 ) & Mask )
+        {
+            const Slot & Cur = Target.Slots[ Pos ];
+            if( Cur.Hash != StrHash ) continue;
+
+            const size_t Local = Cur.Index - 1;
+            const size_t Offset = Target.Offsets[ Local ];
+            if( ( Target.Offsets[ Local + 1 ] - Offset - 1 == Length ) && ( memcmp( & Target.Arena[ Offset ], String, Length ) == 0 ) )
+                return Target.Indexes[ Local ];
+        }
+
+        const uint32_t Index = static_cast<uint32_t>( m_count++ );
+        Target.Arena.insert( Target.Arena.end(), String, String + Length );
+        Target.Arena.push_back( '\0' );
+        Target.Offsets.push_back( Target.Arena.size() );
+        Target.Indexes.push_back( Index );
+
+        Target.Slots[ Pos ].Index = static_cast<uint32_t>( Target.Indexes.size() );
+        Target.Slots[ Pos ].Hash = StrHash;
+        return Index;
+    }
+
+    // ****************************************************************************
+    /// @brief  Collects the strings of all shards in the index order
+    /// @param  Strings the pointers to the strings (by their indexes)
+    /// @return no
+    // ****************************************************************************
+    void CSharedStrings::List( std::vector<const char *> & Strings ) const
+    {
+        Strings.assign( Size(), NULL );
+        for( size_t i = 0; i < ShardCount; i++ )
+        {
+            const Shard & Source = m_shards[ i ];
+            for( size_t Local = 0; Local < Source.Indexes.size(); Local++ )
+                Strings[ Source.Indexes[ Local ] ] = & Source.Arena[ Source.Offsets[ Local ] ];
+        }
+    }
+
+    // ****************************************************************************
+    /// @brief  Rebuilds the hash table of the shard with the new size
+    /// @param  Target the shard
+    /// @param  SlotCount new number of slots (power of two)
+    /// @return no
+    // ****************************************************************************
+    void CSharedStrings::Rehash( Shard & Target, size_t SlotCount )
+    {
+        const Slot FreeSlot = { 0, 0 };
+        std::vector<Slot> Slots( SlotCount, FreeSlot );
+        const size_t Mask = SlotCount - 1;
+        for( std::vector<Slot>::const_iterator it = Target.Slots.begin(); it != Target.Slots.end(); it++ )
+        {
+            if( it->Index == 0 ) continue;
+            size_t Pos = it->Hash & Mask;
+            while( Slots[ Pos ].Index != 0 ) Pos = ( Pos + 1 ) & Mask;
+            Slots[ Pos ] = * it;
+        }
+        Target.Slots.swap( Slots );
+    }
+
+    // ****************************************************************************
+    /// @brief  FNV-1a hash of the string
+    /// @param  String string to be hashed
+    /// @param  Length string length in bytes
+    /// @return Hash value
+    // ****************************************************************************
+    uint32_t CSharedStrings::Hash( const char * String, size_t Length )
+    {
+        uint32_t Result = 2166136261u;
+        for( size_t i = 0; i < Length; i++ )
+        {
+            Result ^= static_cast<uint8_t>( String[ i ] );
+            Result *= 16777619u;
+        }
+        return Result;
+    }
+
+}	// namespace SimpleXlsx
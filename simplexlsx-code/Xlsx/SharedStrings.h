@@ -0,0 +1,97 @@
+/*
+  SimpleXlsxWriter
+  Copyright (C) 2012-2020 Pavel Akimov <oxod.pavel@gmail.com>, Alexandr Belyak <programmeralex@bk.ru>
+
+  This software is provided 'as-is', without any express or implied
+  warranty. In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef XLSX_SHARED_STRINGS_H
+#define XLSX_SHARED_STRINGS_H
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <stdint.h>
+
+namespace SimpleXlsx
+{
+    // ****************************************************************************
+    /// @brief  The class CSharedStrings is a table of unique strings of the workbook.
+    ///         The strings are spread over shards by their hash. Every shard has its own lock,
+    ///         arena of the strings and open addressing hash table, so different worksheets
+    ///         may add the strings from different threads at once. The indexes are taken from
+    ///         a common counter: they never change and have no gaps, and on a single thread
+    ///         they follow the order the strings were first added in.
+    // ****************************************************************************
+    class CSharedStrings
+    {
+        public:
+            CSharedStrings();
+            CSharedStrings( const CSharedStrings & that );
+            CSharedStrings & operator=( const CSharedStrings & that );
+
+            //Reserves memory for the expected number of unique strings and their total length in bytes
+            void Reserve( size_t Count, size_t Bytes = 0 );
+
+            //Returns the index of the string. The string is added if it is not in the table yet.
+            //May be called from different threads at once.
+            inline uint64_t Add( const char * String )
+            {
+                return Add( String, strlen( String ) );
+            }
+            uint64_t Add( const char * String, size_t Length );
+
+            // *INDENT-OFF*   For AStyle tool
+            inline size_t Size() const                      { return m_count; }
+            inline bool Empty() const                       { return m_count == 0; }
+            // *INDENT-ON*   For AStyle tool
+
+            //Zero-terminated strings in the index order. They are valid until the table is changed.
+            //Must not be called while some thread adds the strings.
+            void List( std::vector<const char *> & Strings ) const;
+
+        private:
+            static const size_t ShardBits = 5;
+            static const size_t ShardCount = 1 << ShardBits;
+
+            struct Slot
+            {
+                uint32_t Index;     ///< index of the string in the shard plus one, zero for the free slot
+                uint32_t Hash;      ///< hash of the string (to avoid comparing of the strings)
+            };
+
+            struct Shard
+            {
+                std::vector<char>       Arena;      ///< strings of the shard with terminating zeros
+                std::vector<size_t>     Offsets;    ///< offset of every string in the arena, the last item is the arena size
+                std::vector<uint32_t>   Indexes;    ///< index of every string of the shard in the table
+                std::vector<Slot>       Slots;      ///< hash table (linear probing), the size is a power of two
+            };
+
+            Shard                   m_shards[ ShardCount ]; ///< the shard of a string is chosen by the high bits of its hash
+            std::mutex              m_locks[ ShardCount ];  ///< lock of every shard
+            std::atomic<size_t>     m_count;                ///< number of the strings, the next index
+
+            static void Rehash( Shard & Target, size_t SlotCount );
+            static uint32_t Hash( const char * String, size_t Length );
+    };
+
+}	// namespace SimpleXlsx
+
+#endif	// XLSX_SHARED_STRINGS_H
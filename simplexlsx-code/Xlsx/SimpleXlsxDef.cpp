@@ -120,13 +120,46 @@ char * SimpleXlsx::CellCoord::ToStringAbs( SimpleXlsx::CellCoord::TConvBuf & Buf
     return ToString< true >( Buffer );
 }
 
+const SimpleXlsx::CellCoord::TColLetters * SimpleXlsx::CellCoord::ColumnLetters()
+{
+    struct LettersTable
+    {
+        TColLetters Letters[ MaxCols ];
+
+        LettersTable()
+        {
+            for( uint32_t col = 0; col < MaxCols; col++ )
+            {
+                char * Ptr = Letters[ col ] + 3;
+                char Count = 0;
+                for( uint32_t div = col + 1; div != 0; div /= 26 )
+                {
+                    div--;
+                    * --Ptr = static_cast<char>( 'A' + div % 26 );
+                    Count++;
+                }
+                while( Ptr != Letters[ col ] ) * --Ptr = ' ';
+                Letters[ col ][ 3 ] = Count;
+            }
+        }
+    };
+    static const LettersTable Table;
+    return Table.Letters;
+}
+
 
 
 double SimpleXlsx::CellDataTime::From_time_t( time_t val )
 {
     const int64_t secondsFrom1900to1970 = 2208988800u;
     const double excelOneSecond = 0.0000115740740740741;
-    struct tm * t = localtime( & val );
+    struct tm LocalTime;    //localtime() returns a buffer shared by all threads
+#ifdef _WIN32
+    localtime_s( & LocalTime, & val );
+#else
+    localtime_r( & val, & LocalTime );
+#endif
+    const struct tm * t = & LocalTime;
 
     time_t timeSinceEpoch = t->tm_sec + t->tm_min * 60 + t->tm_hour * 3600 + t->tm_yday * 86400 +
                             ( t->tm_year - 70 ) * 31536000 + ( ( t->tm_year - 69 ) / 4 ) * 86400 -
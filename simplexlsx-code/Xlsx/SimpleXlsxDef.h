@@ -27,6 +27,7 @@
 #include <ctime>
 #include <fstream>
 #include <list>
+#include <locale>
 #include <map>
 #include <sstream>
 #include <string>
@@ -41,12 +42,24 @@
 #include <QDateTime>
 #endif
 
+#include "../Compression.hpp"
 #include "../UTF8Encoder.hpp"
 
 #define SIMPLE_XLSX_VERSION	"0.34"
 
 namespace SimpleXlsx
 {
+// String stream for the names, identifiers and numbers written into the parts.
+// It uses the classic locale, so the global one (digit grouping, decimal comma) does not change the output.
+class ClassicStream : public std::stringstream
+{
+    public:
+        ClassicStream()
+        {
+            imbue( std::locale::classic() );
+        }
+};
+
 // Helper class for simultaneous work with std::string and std::wstring
 class UniString
 {
@@ -351,6 +364,7 @@ class CellCoord
 
     public:
         typedef char TConvBuf[ 24 ];    // Max string for $Col$Row\0
+        typedef char TColLetters[ 4 ];  // Column letters aligned to the right of 3 chars, the last char is the letters count
         static const uint32_t   MaxRows = 1048576, MaxCols = 16384; // Excel limits
         uint32_t row;	///< row (starts from 1)
         uint32_t col;	///< col (starts from 0)
@@ -371,6 +385,9 @@ class CellCoord
         std::string ToStringAbs() const;
         char * ToStringAbs( TConvBuf & Buffer ) const;
 
+        // Precomputed letters of all columns from A to XFD (MaxCols items)
+        static const TColLetters * ColumnLetters();
+
     private:
         template< bool AbsColAndRow >
         inline char * ToString( char * Buffer ) const
@@ -663,6 +680,40 @@ class CellDataFlt
         }
 };	///< cell data:style pair
 
+/// @brief	Column of values for CWorksheet::AddColumns. The values are not copied, the array must contain
+///         a value for every added row. Strings are UTF-8; NULL or empty string is an empty cell.
+class ColumnData
+{
+    public:
+        enum EType
+        {
+            COLUMN_EMPTY = 0,
+            COLUMN_INT32,
+            COLUMN_UINT32,
+            COLUMN_INT64,
+            COLUMN_UINT64,
+            COLUMN_FLOAT,
+            COLUMN_DOUBLE,
+            COLUMN_CSTRING,
+            COLUMN_STRING
+        };
+
+        EType type;             ///< type of the values
+        const void * values;    ///< pointer to the first value
+        size_t style_id;        ///< style of all cells of the column
+
+    public:
+        ColumnData() : type( COLUMN_EMPTY ), values( NULL ), style_id( 0 ) {}
+        ColumnData( const int32_t * _values, size_t _style_id = 0 ) : type( COLUMN_INT32 ), values( _values ), style_id( _style_id ) {}
+        ColumnData( const uint32_t * _values, size_t _style_id = 0 ) : type( COLUMN_UINT32 ), values( _values ), style_id( _style_id ) {}
+        ColumnData( const int64_t * _values, size_t _style_id = 0 ) : type( COLUMN_INT64 ), values( _values ), style_id( _style_id ) {}
+        ColumnData( const uint64_t * _values, size_t _style_id = 0 ) : type( COLUMN_UINT64 ), values( _values ), style_id( _style_id ) {}
+        ColumnData( const float * _values, size_t _style_id = 0 ) : type( COLUMN_FLOAT ), values( _values ), style_id( _style_id ) {}
+        ColumnData( const double * _values, size_t _style_id = 0 ) : type( COLUMN_DOUBLE ), values( _values ), style_id( _style_id ) {}
+        ColumnData( const char * const * _values, size_t _style_id = 0 ) : type( COLUMN_CSTRING ), values( _values ), style_id( _style_id ) {}
+        ColumnData( const std::string * _values, size_t _style_id = 0 ) : type( COLUMN_STRING ), values( _values ), style_id( _style_id ) {}
+};	///< column of values:style pair
+
 /// @brief	This structure describes comment item that can added to a cell
 struct Comment
 {
@@ -46,6 +46,7 @@
 #include "XlsxHeaders.h"
 
 #include "../PathManager.hpp"
+#include "../TaskPool.hpp"
 #include "../XMLWriter.hpp"
 
 namespace SimpleXlsx
@@ -61,6 +62,57 @@ namespace SimpleXlsx
 /// @return no
 // ****************************************************************************
 CWorkbook::CWorkbook( const UniString & UserName ) : m_UserName( UserName )
+{
+    Init();
+}
+
+// ****************************************************************************
+/// @brief  The constructor of a workbook made from the template. The images, charts and chart sheets
+///         are those of the prototype, the drawings and the data sheets are its copies.
+/// @param  Template frozen prototype
+/// @param  UserName user name
+/// @return no
+// ****************************************************************************
+CWorkbook::CWorkbook( const CWorkbookTemplate & Template, const UniString & UserName ) : m_UserName( UserName )
+{
+    Init();
+    if( ! Template.IsOk() ) return;
+    m_template = & Template;
+
+    const CWorkbook & Prototype = Template.m_prototype;
+    m_sharedStrings = Prototype.m_sharedStrings;
+    m_comments = Prototype.m_comments;
+    m_commLastId = Prototype.m_commLastId;
+    m_sheetId = Prototype.m_sheetId;
+    m_activeSheetIndex = Prototype.m_activeSheetIndex;
+    m_styleList = Prototype.m_styleList;
+
+    m_images = Prototype.m_images;
+    SaveFrozen( Template.m_imageFiles );
+    m_charts = Prototype.m_charts;
+    m_chartsheets = Prototype.m_chartsheets;
+    for( size_t i = 0; i < Prototype.m_drawings.size(); i++ )
+        CreateDrawing()->m_drawings = Prototype.m_drawings[ i ]->m_drawings;
+    for( size_t i = 0; i < Prototype.m_worksheets.size(); i++ )
+    {
+        const CWorksheet & Source = * Prototype.m_worksheets[ i ];
+        CDrawing & Drawing = * m_drawings[ Source.m_Drawing.GetIndex() - 1 ];
+        InitWorkSheet( new CWorksheet( Source, Template.m_sheetMarkup[ i ], Drawing, * m_pathManager ), Source.GetTitle() );
+    }
+
+    m_definedNames = Prototype.m_definedNames;
+    for( std::map< std::string, DefinedName >::iterator it = m_definedNames.begin(); it != m_definedNames.end(); it++ )
+    {
+        it->second.CSheet = TemplateSheet( it->second.CSheet );
+        it->second.ScopeSheet = TemplateSheet( it->second.ScopeSheet );
+    }
+}
+
+// ****************************************************************************
+/// @brief  Initializes internal variables: the default styles, the temporary path and the user name
+/// @return no
+// ****************************************************************************
+void CWorkbook::Init()
 {
     m_commLastId = 0;
     m_sheetId = 1;
@@ -74,10 +126,8 @@ CWorkbook::CWorkbook( const UniString & UserName ) : m_UserName( UserName )
     style.fill.patternType = PATTERN_GRAY_125;
     m_styleList.Add( style ); // default style
 
-    std::stringstream TmpStringStream;
 #ifdef _WIN32
     m_temp_path = getenv( "TEMP" );
-    TmpStringStream << "xlsx_" << GetCurrentThreadId() << "_" << std::clock();
 #else
 
     const int EnvVarCount = 4;
@@ -93,11 +143,7 @@ CWorkbook::CWorkbook( const UniString & UserName ) : m_UserName( UserName )
     }
     if( m_temp_path.empty() )
         m_temp_path = "/tmp";
-    TmpStringStream << "xlsx_" << std::abs( syscall( SYS_gettid ) ) << "_" << std::clock();
 #endif
-    if( m_temp_path[ m_temp_path.size() - 1 ] != '/' )
-        m_temp_path += "/";
-    m_temp_path += TmpStringStream.str();
 
     //Check the UserName
     if( m_UserName.empty() )
@@ -111,6 +157,10 @@ CWorkbook::CWorkbook( const UniString & UserName ) : m_UserName( UserName )
     }
 
     m_pathManager = new PathManager( m_temp_path );
+    m_streamArchive = NULL;
+    m_streamSink = NULL;
+    m_saveThreads = 1;
+    m_template = NULL;
 }
 
 // ****************************************************************************
@@ -119,17 +169,21 @@ CWorkbook::CWorkbook( const UniString & UserName ) : m_UserName( UserName )
 // ****************************************************************************
 CWorkbook::~CWorkbook()
 {
+    //The chart sheets, charts and images of the prototype are not deleted
+    const CWorkbook * Prototype = ( m_template != NULL ) ? & m_template->m_prototype : NULL;
     for( std::vector<CWorksheet *>::const_iterator it = m_worksheets.begin(); it != m_worksheets.end(); it++ )
         delete * it;
-    for( std::vector<CChartsheet *>::const_iterator it = m_chartsheets.begin(); it != m_chartsheets.end(); it++ )
-        delete * it;
-    for( std::vector<CChart *>::const_iterator it = m_charts.begin(); it != m_charts.end(); it++ )
-        delete * it;
+    for( size_t i = ( Prototype != NULL ) ? Prototype->m_chartsheets.size() : 0; i < m_chartsheets.size(); i++ )
+        delete m_chartsheets[ i ];
+    for( size_t i = ( Prototype != NULL ) ? Prototype->m_charts.size() : 0; i < m_charts.size(); i++ )
+        delete m_charts[ i ];
     for( std::vector<CDrawing *>::const_iterator it = m_drawings.begin(); it != m_drawings.end(); it++ )
         delete * it;
-    for( std::vector<CImage *>::const_iterator it = m_images.begin(); it != m_images.end(); it++ )
-        delete * it;
+    for( size_t i = ( Prototype != NULL ) ? Prototype->m_images.size() : 0; i < m_images.size(); i++ )
+        delete m_images[ i ];
 
+    if( m_streamArchive != NULL ) CloseZip( ( HZIP )m_streamArchive );
+    delete m_streamSink;
     delete m_pathManager;
 }
 
@@ -268,40 +322,23 @@ CWorkbook & CWorkbook::AddDefinedName( const UniString & Name, const UniString &
 // ****************************************************************************
 bool CWorkbook::Save( const std::string & filename )
 {
-    if( !SaveCore() || !SaveApp() || !SaveContentType() || !SaveTheme() ||
-            !SaveComments() || !SaveSharedStrings() || !SaveStyles() || !SaveWorkbook() )
-        return false;
+    if( m_streamArchive != NULL ) return false; // the file is already opened by StreamTo, use Save()
 
-    for( std::vector<CWorksheet *>::const_iterator it = m_worksheets.begin(); it != m_worksheets.end(); it++ )
-        if( ( * it )->Save() == false ) return false;
-
-    for( std::vector<CChartsheet *>::const_iterator it = m_chartsheets.begin(); it != m_chartsheets.end(); it++ )
-        if( ( * it )->Save() == false ) return false;
-    for( std::vector<CChart *>::const_iterator it = m_charts.begin(); it != m_charts.end(); it++ )
-        if( ( * it )->Save() == false ) return false;
-    for( std::vector<CDrawing *>::const_iterator it = m_drawings.begin(); it != m_drawings.end(); it++ )
-        if( ( * it )->Save() == false ) return false;
+    TaskPool Pool( m_saveThreads );
+    if( ! SaveParts( Pool ) )
+    {
+        m_pathManager->ClearTemp();
+        return false;
+    }
 
-    bool bRetCode = true;
+    bool bRetCode = false;
 
     HZIP hZip = CreateZip( filename.c_str(), NULL ); // create .zip without encryption
     if( hZip != 0 )
     {
-        std::vector< std::string >::const_iterator end_it = m_pathManager->ContentFiles().end();
-        for( std::vector< std::string >::const_iterator it = m_pathManager->ContentFiles().begin(); it != end_it; it++ )
-        {
-            const std::string & File = * it;
-            std::string Path = m_temp_path + File;
-            ZRESULT res = ZipAdd( hZip, File.c_str() + 1, Path.c_str() );
-            if( res != ZR_OK )
-            {
-                bRetCode = false;
-                break;
-            }
-        }
+        bRetCode = ZipContentFiles( hZip, Pool );
         CloseZip( hZip );
     }
-    else bRetCode = false;
 
     m_pathManager->ClearTemp();
     return bRetCode;
@@ -311,6 +348,606 @@ bool CWorkbook::Save( const std::wstring & filename )
     return Save( PathManager::PathEncode( filename ) );
 }
 
+// ****************************************************************************
+/// @brief  Saves workbook into memory
+/// @param  data vector the archive is put into
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::Save( std::vector<char> & data )
+{
+    data.clear();
+    MemorySink Sink( data );
+    return SaveTo( Sink );
+}
+
+// ****************************************************************************
+/// @brief  Saves workbook into the stream
+/// @param  stream output stream (need not be seekable)
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::Save( std::ostream & stream )
+{
+    StdStreamSink Sink( stream );
+    return SaveTo( Sink );
+}
+
+// ****************************************************************************
+/// @brief  Saves workbook through the user function
+/// @param  write function the archive is passed to piece by piece, in order
+/// @param  userData first argument of the function
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::Save( bool ( * write )( void * userData, const char * data, size_t size ), void * userData )
+{
+    if( write == NULL ) return false;
+    CallbackSink Sink( write, userData );
+    return SaveTo( Sink );
+}
+
+// ****************************************************************************
+/// @brief  Saves workbook into the file descriptor
+/// @param  descriptor file descriptor opened for writing (need not be seekable)
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::Save( int descriptor )
+{
+    FileSink Sink( descriptor );
+    return SaveTo( Sink );
+}
+
+// Output of the archive created by SaveTo and StreamTo
+static bool WriteToSink( void * Sink, const char * Data, unsigned int Size )
+{
+    return static_cast< OutputSink * >( Sink )->Write( Data, Size );
+}
+
+// ****************************************************************************
+/// @brief  Saves workbook into the sink
+/// @param  Sink destination of the archive
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::SaveTo( OutputSink & Sink )
+{
+    if( ( m_streamArchive != NULL ) || ! Sink.IsOk() ) return false;
+
+    TaskPool Pool( m_saveThreads );
+    if( ! SaveParts( Pool ) )
+    {
+        m_pathManager->ClearTemp();
+        return false;
+    }
+
+    bool bRetCode = false;
+
+    HZIP hZip = CreateZipWriter( WriteToSink, & Sink, NULL ); // create .zip without encryption
+    if( hZip != 0 )
+    {
+        bRetCode = ZipContentFiles( hZip, Pool );
+        if( CloseZip( hZip ) != ZR_OK ) bRetCode = false;   // the central directory is written here
+    }
+
+    m_pathManager->ClearTemp();
+    return bRetCode;
+}
+
+// ****************************************************************************
+/// @brief  Turns on the streaming mode: worksheets XML is deflated directly
+///         into the specified file without the temporary files
+/// @param  name full path to the file
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::StreamTo( const std::string & filename )
+{
+    if( ( m_streamArchive != NULL ) || ! m_worksheets.empty() ) return false;
+
+    HZIP hZip = CreateZip( filename.c_str(), NULL ); // create .zip without encryption
+    if( hZip == 0 ) return false;
+
+    m_streamArchive = hZip;
+    m_pathManager->SetStreamArchive( hZip );
+    return true;
+}
+bool CWorkbook::StreamTo( const std::wstring & filename )
+{
+    return StreamTo( PathManager::PathEncode( filename ) );
+}
+
+// ****************************************************************************
+/// @brief  Turns on the streaming mode into the file descriptor
+/// @param  descriptor file descriptor opened for writing (need not be seekable), it is not closed
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::StreamTo( int descriptor )
+{
+    if( ( m_streamArchive != NULL ) || ! m_worksheets.empty() || ( descriptor < 0 ) ) return false;
+
+    OutputSink * Sink = new FileSink( descriptor );
+    HZIP hZip = CreateZipWriter( WriteToSink, Sink, NULL ); // create .zip without encryption
+    if( hZip == 0 )
+    {
+        delete Sink;
+        return false;
+    }
+
+    m_streamArchive = hZip;
+    m_streamSink = Sink;
+    m_pathManager->SetStreamArchive( hZip );
+    return true;
+}
+
+// ****************************************************************************
+/// @brief  Finishes the file opened by StreamTo
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::Save()
+{
+    if( m_streamArchive == NULL ) return false;
+    FinishStreamedSheet();  //its archive item is closed even if another part fails and stops the saving
+
+    TaskPool Pool( m_saveThreads );
+    bool bRetCode = SaveParts( Pool ) && ZipContentFiles( m_streamArchive, Pool );
+
+    if( CloseZip( ( HZIP )m_streamArchive ) != ZR_OK ) bRetCode = false;
+    m_streamArchive = NULL;
+    m_pathManager->SetStreamArchive( NULL );
+    delete m_streamSink;
+    m_streamSink = NULL;
+
+    m_pathManager->ClearTemp();
+    return bRetCode;
+}
+
+// ****************************************************************************
+/// @brief  Sets the total size of the parts kept in memory until Save
+/// @param  bytes the limit, beyond it the parts are moved into a temporary file
+/// @return Reference to this object
+// ****************************************************************************
+CWorkbook & CWorkbook::SetPartMemoryLimit( size_t bytes )
+{
+    m_pathManager->SetMemoryLimit( bytes );
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  Keeps all the parts in memory whatever their size
+/// @param  inMemory true to keep all the parts in memory, false to return to the default limit
+/// @return Reference to this object
+// ****************************************************************************
+CWorkbook & CWorkbook::KeepPartsInMemory( bool inMemory )
+{
+    return SetPartMemoryLimit( inMemory ? static_cast<size_t>( -1 ) : static_cast<size_t>( PartStore::DefaultMemoryLimit ) );
+}
+
+// ****************************************************************************
+/// @brief  Turns on the background compression of the streamed worksheets
+/// @param  maxQueued size limit of the XML waiting for the compression, 0 turns it off
+/// @return Reference to this object
+/// @note   Takes effect for the worksheets added after the call, see StreamTo
+// ****************************************************************************
+CWorkbook & CWorkbook::SetBackgroundCompression( size_t maxQueued )
+{
+    m_pathManager->SetStreamQueue( maxQueued );
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  Sets the compression level of all parts
+/// @param  level COMPRESSION_STORE, deflate level 1...9 or COMPRESSION_ADAPTIVE
+/// @return Reference to this object
+// ****************************************************************************
+CWorkbook & CWorkbook::SetCompression( int level )
+{
+    m_pathManager->SetCompression( level );
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  Sets the compression level of the parts with the specified path prefix
+/// @param  partPrefix beginning of the path inside the archive, e.g. "xl/worksheets/"
+/// @param  level COMPRESSION_STORE, deflate level 1...9 or COMPRESSION_ADAPTIVE
+/// @return Reference to this object
+// ****************************************************************************
+CWorkbook & CWorkbook::SetCompression( const std::string & partPrefix, int level )
+{
+    m_pathManager->SetCompression( partPrefix, level );
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  Sets the output rate COMPRESSION_ADAPTIVE chooses the levels for
+/// @param  bytesPerSecond expected speed of writing or transferring the file
+/// @return Reference to this object
+// ****************************************************************************
+CWorkbook & CWorkbook::SetAdaptiveCompressionRate( double bytesPerSecond )
+{
+    m_pathManager->SetAdaptiveRate( bytesPerSecond );
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  Sets the deflate engine of the archive
+/// @param  codec CODEC_BUILTIN, CODEC_ZLIB, CODEC_LIBDEFLATE or CODEC_DEFAULT
+/// @return Reference to this object
+/// @note   Takes effect for the parts saved or streamed after the call
+// ****************************************************************************
+CWorkbook & CWorkbook::SetCompressionCodec( int codec )
+{
+    m_pathManager->SetCodec( codec );
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  Checks whether the deflate engine is compiled in
+/// @param  codec CODEC_BUILTIN, CODEC_ZLIB, CODEC_LIBDEFLATE or CODEC_DEFAULT
+/// @return Boolean result of the check
+// ****************************************************************************
+bool CWorkbook::IsCompressionCodecAvailable( int codec )
+{
+    if( codec == CODEC_DEFAULT ) return true;
+    TZipCodec * Codec = NewZipCodec( codec );
+    delete Codec;
+    return Codec != NULL;
+}
+
+// ****************************************************************************
+/// @brief  Sets the number of threads the built-in deflate engine compresses each part on
+/// @param  threads 1 to compress in the calling thread, 0 for one thread per CPU
+/// @return Reference to this object
+/// @note   Takes effect for the parts saved or streamed after the call
+// ****************************************************************************
+CWorkbook & CWorkbook::SetCompressionThreads( unsigned threads )
+{
+    m_pathManager->SetThreads( threads );
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  Sets the number of threads Save generates and deflates the parts on
+/// @param  threads 1 to save in the calling thread, 0 for one thread per CPU
+/// @return Reference to this object
+// ****************************************************************************
+CWorkbook & CWorkbook::SetSaveThreads( unsigned threads )
+{
+    m_saveThreads = threads;
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  The parts generated by Save: those of the workbook, then the sheets, chart sheets,
+///         charts and drawings. They are independent, so they may be saved by several threads;
+///         the files each of them registers are collected and then added to the content files
+///         in the order of the parts.
+// ****************************************************************************
+class CWorkbook::PartTasks : public TaskList
+{
+    public:
+        static const size_t BookParts = 8;
+        static const size_t StylesPart = 6;
+
+        explicit PartTasks( CWorkbook & Book ) : m_Book( Book ), m_Files( Count() ) {}
+
+        inline size_t Count() const
+        {
+            return BookParts + m_Book.m_worksheets.size() + m_Book.m_chartsheets.size() + m_Book.m_charts.size() + m_Book.m_drawings.size();
+        }
+
+        virtual bool Run( size_t Index )
+        {
+            m_Book.m_pathManager->CollectFiles( & m_Files[ Index ] );
+            const bool Ok = Save( Index );
+            m_Book.m_pathManager->CollectFiles( NULL );
+            return Ok;
+        }
+
+        virtual bool Done( size_t Index )
+        {
+            m_Book.m_pathManager->AddContentFiles( m_Files[ Index ] );
+            return true;
+        }
+
+        //The files the part has registered
+        inline const std::vector< std::string > & Files( size_t Index ) const
+        {
+            return m_Files[ Index ];
+        }
+
+    private:
+        //The chart sheets, charts and unchanged drawings of a template are not generated again
+        bool Save( size_t Index )
+        {
+            const CWorkbookTemplate * Template = m_Book.m_template;
+            switch( Index )
+            {
+                case 0: return m_Book.SaveCore();
+                case 1: return m_Book.SaveApp();
+                case 2: return m_Book.SaveContentType();
+                case 3: return m_Book.SaveTheme();
+                case 4: return m_Book.SaveComments();
+                case 5: return m_Book.SaveSharedStrings();
+                case StylesPart: return m_Book.SaveStyles();
+                case 7: return m_Book.SaveWorkbook();
+            }
+            Index -= BookParts;
+            if( Index < m_Book.m_worksheets.size() ) return m_Book.m_worksheets[ Index ]->Save();
+            Index -= m_Book.m_worksheets.size();
+            if( Index < m_Book.m_chartsheets.size() )
+            {
+                if( ( Template != NULL ) && ( Index < Template->m_chartsheetFiles.size() ) )
+                    return m_Book.SaveFrozen( Template->m_chartsheetFiles[ Index ] );
+                return m_Book.m_chartsheets[ Index ]->Save();
+            }
+            Index -= m_Book.m_chartsheets.size();
+            if( Index < m_Book.m_charts.size() )
+            {
+                if( ( Template != NULL ) && ( Index < Template->m_chartFiles.size() ) )
+                    return m_Book.SaveFrozen( Template->m_chartFiles[ Index ] );
+                return m_Book.m_charts[ Index ]->Save();
+            }
+            Index -= m_Book.m_charts.size();
+            if( ( Template != NULL ) && ( Index < Template->m_drawingFiles.size() ) &&
+                    ( m_Book.m_drawings[ Index ]->m_drawings.size() == Template->m_drawingSizes[ Index ] ) )
+                return m_Book.SaveFrozen( Template->m_drawingFiles[ Index ] );
+            return m_Book.m_drawings[ Index ]->Save();
+        }
+
+        CWorkbook                   &           m_Book;
+        std::vector< std::vector< std::string > > m_Files;  ///< files registered by each part
+};
+
+// ****************************************************************************
+/// @brief  Saves all parts of the workbook
+/// @param  Pool threads to save the parts on
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::SaveParts( TaskPool & Pool )
+{
+    PartTasks Tasks( * this );
+    return Pool.Run( Tasks, Tasks.Count() ) && ! m_pathManager->Parts().Failed();
+}
+
+// ****************************************************************************
+/// @brief  Freezes the workbook as the prototype of the template: takes what the worksheets
+///         have written so far, and saves the styles, chart sheets, charts and drawings
+/// @param  Template the template being made
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::Freeze( CWorkbookTemplate & Template )
+{
+    if( ( m_streamArchive != NULL ) || ( m_template != NULL ) ) return false;
+    const PartStore & Parts = m_pathManager->Parts();
+    const size_t DeclarationSize = strlen( XMLWriter::Declaration() );
+    for( std::vector<CWorksheet *>::const_iterator it = m_worksheets.begin(); it != m_worksheets.end(); it++ )
+    {
+        CWorksheet & Sheet = ** it;
+        if( ! Sheet.IsOk() || ( Sheet.m_XMLWriter == NULL ) || ! Sheet.FlushRowBlocks() || Sheet.m_row_opened || ! Sheet.m_XMLWriter->Suspend() ) return false;
+        ClassicStream FileName;
+        FileName << "/xl/worksheets/sheet" << Sheet.GetIndex() << ".xml";
+        std::vector<char> Markup;
+        MemorySink Sink( Markup );
+        if( ! Parts.Read( FileName.str(), Sink ) || ( Markup.size() < DeclarationSize ) ) return false;
+        Template.m_sheetMarkup.push_back( std::string( Markup.begin() + DeclarationSize, Markup.end() ) );
+    }
+
+    for( std::vector<CImage *>::const_iterator it = m_images.begin(); it != m_images.end(); it++ )
+        Template.m_imageFiles.push_back( "/xl/media/" + ( * it )->InternalName );
+    if( ! Template.AddParts( Parts, Template.m_imageFiles ) ) return false;
+
+    PartTasks Tasks( * this );
+    Template.m_styleCount = m_styleList.GetIndexes().size();
+    if( ! Tasks.Run( PartTasks::StylesPart ) || ! Template.AddParts( Parts, Tasks.Files( PartTasks::StylesPart ) ) ) return false;
+    Template.m_styleFiles = Tasks.Files( PartTasks::StylesPart );
+    size_t Index = PartTasks::BookParts + m_worksheets.size();
+    for( size_t i = 0; i < m_chartsheets.size(); i++, Index++ )
+    {
+        if( ! Tasks.Run( Index ) || ! Template.AddParts( Parts, Tasks.Files( Index ) ) ) return false;
+        Template.m_chartsheetFiles.push_back( Tasks.Files( Index ) );
+    }
+    for( size_t i = 0; i < m_charts.size(); i++, Index++ )
+    {
+        if( ! Tasks.Run( Index ) || ! Template.AddParts( Parts, Tasks.Files( Index ) ) ) return false;
+        Template.m_chartFiles.push_back( Tasks.Files( Index ) );
+    }
+    for( size_t i = 0; i < m_drawings.size(); i++, Index++ )
+    {
+        if( ! Tasks.Run( Index ) || ! Template.AddParts( Parts, Tasks.Files( Index ) ) ) return false;
+        Template.m_drawingFiles.push_back( Tasks.Files( Index ) );
+        Template.m_drawingSizes.push_back( m_drawings[ i ]->m_drawings.size() );
+    }
+    return ! Parts.Failed();
+}
+
+// ****************************************************************************
+/// @brief  Registers the frozen parts of the template
+/// @param  Files paths of the parts
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::SaveFrozen( const std::vector< std::string > & Files )
+{
+    for( std::vector< std::string >::const_iterator it = Files.begin(); it != Files.end(); it++ )
+        m_pathManager->RegisterStatic( * it, * m_template->m_parts.find( * it )->second );
+    return true;
+}
+
+//The sheet of the workbook made from the template which corresponds to the sheet of the prototype.
+//The chart sheets are those of the prototype.
+const CSheet * CWorkbook::TemplateSheet( const CSheet * Sheet ) const
+{
+    const std::vector<CWorksheet *> & Sheets = m_template->m_prototype.m_worksheets;
+    for( size_t i = 0; i < Sheets.size(); i++ )
+        if( Sheets[ i ] == Sheet ) return m_worksheets[ i ];
+    return Sheet;
+}
+
+// ****************************************************************************
+/// @brief  The constructor freezes the prototype
+/// @param  Prototype the workbook with the structure of the workbooks to be made
+/// @return no
+// ****************************************************************************
+CWorkbookTemplate::CWorkbookTemplate( CWorkbook & Prototype ) : m_prototype( Prototype ), m_styleCount( 0 )
+{
+    m_isOk = Prototype.Freeze( * this );
+}
+
+CWorkbookTemplate::~CWorkbookTemplate()
+{
+    for( std::map< std::string, StaticPart * >::const_iterator it = m_parts.begin(); it != m_parts.end(); it++ )
+        delete it->second;
+}
+
+// ****************************************************************************
+/// @brief  Keeps the content of the parts saved by the prototype
+/// @param  Parts the part store of the prototype
+/// @param  Paths paths of the parts
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbookTemplate::AddParts( const PartStore & Parts, const Files & Paths )
+{
+    for( Files::const_iterator it = Paths.begin(); it != Paths.end(); it++ )
+    {
+        std::vector<char> Content;
+        MemorySink Sink( Content );
+        if( ! Parts.Read( * it, Sink ) ) return false;
+        StaticPart *& Part = m_parts[ * it ];
+        delete Part;
+        Part = new StaticPart( Content );
+    }
+    return true;
+}
+
+// ****************************************************************************
+/// @brief  The content files added to the archive by Save on several threads: the parts of
+///         a level 1..9 are read and deflated by the threads, the others (and the very big
+///         ones) by the archive itself. All of them are added to the archive in order.
+// ****************************************************************************
+class CWorkbook::ZipTasks : public TaskList
+{
+    public:
+        static const size_t MaxDeflated = 256 << 20;    ///< bigger parts are not read into memory
+
+        inline ZipTasks( const CWorkbook & Book, void * Archive, int Codec ) :
+            m_Book( Book ), m_Archive( Archive ), m_Codec( Codec ), m_Items( Book.m_pathManager->ContentFiles().size() ) {}
+
+        virtual bool Run( size_t Index )
+        {
+            const std::string & File = m_Book.m_pathManager->ContentFiles()[ Index ];
+            const int Level = m_Book.m_pathManager->CompressionLevel( File );
+            Item & It = m_Items[ Index ];
+            It.Deflated = false;
+            if( ( Level < COMPRESSION_FAST ) || ( Level > COMPRESSION_BEST ) || ( m_Codec < 0 ) ) return true;
+            if( m_Book.m_pathManager->Static( File ) != NULL ) return true;     //deflated already
+
+            const PartStore & Parts = m_Book.m_pathManager->Parts();
+            if( Parts.Size( File ) > MaxDeflated ) return true;
+            std::vector<char> Content;
+            const std::vector<char> * Data = Parts.Memory( File );
+            if( Data == NULL )
+            {
+                MemorySink Sink( Content );
+                if( ! Parts.Read( File, Sink ) ) return false;
+                Data = & Content;
+            }
+
+            TZipCodec * Codec = NewZipCodec( m_Codec );
+            if( Codec == NULL ) return false;
+            It.Crc = ZipCrc32( 0, Data->data(), ( unsigned int )Data->size() );
+            It.Size = Data->size();
+            It.Deflated = Codec->Begin( Level, Append, & It.Data ) && Codec->Write( Data->data(), ( unsigned int )Data->size(), true );
+            delete Codec;
+            return It.Deflated;
+        }
+
+        virtual bool Done( size_t Index )
+        {
+            const std::string & File = m_Book.m_pathManager->ContentFiles()[ Index ];
+            Item & It = m_Items[ Index ];
+            if( ! m_Book.m_pathManager->PrepareArchiveItem( m_Archive, File ) ) return false;
+            ZRESULT res;
+            if( It.Deflated )
+                res = ZipAddDeflated( ( HZIP )m_Archive, File.c_str() + 1, It.Data.data(), ( unsigned int )It.Data.size(), It.Crc, It.Size );
+            else
+                res = m_Book.ZipAddPart( m_Archive, File );
+            std::vector<char>().swap( It.Data );
+            return res == ZR_OK;
+        }
+
+    private:
+        struct Item
+        {
+            bool                Deflated;   ///< Data holds the deflated part, otherwise it is added by the archive
+            std::vector<char>   Data;
+            unsigned long       Crc;
+            unsigned long long  Size;
+        };
+
+        static bool Append( void * Param, const char * Data, unsigned int Size )
+        {
+            std::vector<char> * Target = static_cast< std::vector<char> * >( Param );
+            Target->insert( Target->end(), Data, Data + Size );
+            return true;
+        }
+
+        const CWorkbook         &   m_Book;
+        void                    *   m_Archive;  ///< archive (HZIP)
+        int                         m_Codec;    ///< deflate engine of the archive, -1 for a custom one
+        std::vector<Item>           m_Items;
+};
+
+// ****************************************************************************
+/// @brief  Adds the parts saved in the temporary directory into the archive
+/// @param  Archive opened archive (HZIP)
+/// @param  Pool threads to deflate the parts on
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::ZipContentFiles( void * Archive, TaskPool & Pool ) const
+{
+    if( Pool.Threads() > 1 )
+    {
+        int Codec = m_pathManager->Codec();
+        if( ( Codec == CODEC_DEFAULT ) && ( ZipGetCodec( ( HZIP )Archive, & Codec ) != ZR_OK ) ) return false;
+        ZipTasks Tasks( * this, Archive, Codec );
+        return Pool.Run( Tasks, m_pathManager->ContentFiles().size() );
+    }
+
+    std::vector< std::string >::const_iterator end_it = m_pathManager->ContentFiles().end();
+    for( std::vector< std::string >::const_iterator it = m_pathManager->ContentFiles().begin(); it != end_it; it++ )
+    {
+        const std::string & File = * it;
+        if( ! m_pathManager->PrepareArchiveItem( Archive, File ) ) return false;
+        ZRESULT res = ZipAddPart( Archive, File );
+        if( res != ZR_OK ) return false;
+    }
+    return true;
+}
+
+// ****************************************************************************
+/// @brief  Adds the part into the archive: a static part as it was deflated before, the others
+///         at once if they are in memory, otherwise piece by piece as they are read from the temporary file
+/// @param  Archive opened archive (HZIP)
+/// @param  File path of the part
+/// @return Result of the zip function (ZRESULT)
+// ****************************************************************************
+unsigned long CWorkbook::ZipAddPart( void * Archive, const std::string & File ) const
+{
+    const StaticPart * Static = m_pathManager->Static( File );
+    if( Static != NULL )
+    {
+        int Codec = m_pathManager->Codec();
+        if( ( Codec == CODEC_DEFAULT ) && ( ZipGetCodec( ( HZIP )Archive, & Codec ) != ZR_OK ) ) Codec = -1;
+        return Static->AddTo( Archive, File.c_str() + 1, m_pathManager->CompressionLevel( File ), Codec );
+    }
+
+    const PartStore & Parts = m_pathManager->Parts();
+    const std::vector<char> * Data = Parts.Memory( File );
+    if( ( Data != NULL ) && ! Data->empty() && ( Data->size() < 0x80000000u ) )
+        return ZipAdd( ( HZIP )Archive, File.c_str() + 1, const_cast<char *>( Data->data() ), ( unsigned int )Data->size() );
+
+    ZRESULT res = ZipAddStreamBegin( ( HZIP )Archive, File.c_str() + 1 );
+    if( res != ZR_OK ) return res;
+    ZipSink Sink( Archive );    //a part kept in memory is read in one piece, the sink splits it
+    const bool Ok = Parts.Read( File, Sink );
+    return ( Sink.Close() && Ok ) ? ZR_OK : ZR_WRITE;
+}
+
 // ****************************************************************************
 /// @brief  Adds another data sheet into the workbook
 /// @param  title chart page title
@@ -318,6 +955,7 @@ bool CWorkbook::Save( const std::wstring & filename )
 // ****************************************************************************
 CWorksheet & CWorkbook::CreateSheet( const UniString & title )
 {
+    FinishStreamedSheet();
     CWorksheet * sheet = new CWorksheet( m_sheetId++, * CreateDrawing(), * m_pathManager );
     return InitWorkSheet( sheet, title );
 }
@@ -330,6 +968,7 @@ CWorksheet & CWorkbook::CreateSheet( const UniString & title )
 // ****************************************************************************
 CWorksheet & CWorkbook::CreateSheet( const UniString & title, const std::vector<ColumnWidth> & colWidths )
 {
+    FinishStreamedSheet();
     CWorksheet * sheet = new CWorksheet( m_sheetId++, colWidths, * CreateDrawing(), * m_pathManager );
     return InitWorkSheet( sheet, title );
 }
@@ -343,6 +982,7 @@ CWorksheet & CWorkbook::CreateSheet( const UniString & title, const std::vector<
 // ****************************************************************************
 CWorksheet & CWorkbook::CreateSheet( const UniString & title, uint32_t frozenWidth, uint32_t frozenHeight )
 {
+    FinishStreamedSheet();
     CWorksheet * sheet = new CWorksheet( m_sheetId++, frozenWidth, frozenHeight, * CreateDrawing(), * m_pathManager );
     return InitWorkSheet( sheet, title );
 }
@@ -357,6 +997,7 @@ CWorksheet & CWorkbook::CreateSheet( const UniString & title, uint32_t frozenWid
 // ****************************************************************************
 CWorksheet & CWorkbook::CreateSheet( const UniString & title, uint32_t frozenWidth, uint32_t frozenHeight, const std::vector<ColumnWidth> & colWidths )
 {
+    FinishStreamedSheet();
     CWorksheet * sheet = new CWorksheet( m_sheetId++, frozenWidth, frozenHeight, colWidths, * CreateDrawing(), * m_pathManager );
     return InitWorkSheet( sheet, title );
 }
@@ -365,11 +1006,22 @@ CWorksheet & CWorkbook::InitWorkSheet( CWorksheet * sheet, const UniString & tit
 {
     sheet->SetTitle( title );
     sheet->SetSharedStr( & m_sharedStrings );
-    sheet->SetComments( & m_comments );
+    sheet->SetComments( & m_comments, & m_commentsLock );
     m_worksheets.push_back( sheet );
     return * sheet;
 }
 
+// ****************************************************************************
+/// @brief  In the streaming mode finishes the last worksheet, so that the archive
+///         is free for the next one
+/// @return no
+// ****************************************************************************
+void CWorkbook::FinishStreamedSheet()
+{
+    if( ( m_streamArchive != NULL ) && ! m_worksheets.empty() )
+        m_worksheets.back()->Save();
+}
+
 CChartsheet & CWorkbook::CreateChartSheet( const UniString & title, EChartTypes type )
 {
     CChart * chart = new CChart( m_charts.size() + 1, type, * m_pathManager );
@@ -573,7 +1225,7 @@ CImage * CWorkbook::CreateImage( const std::string & filename )
                 || ( ImWidth == 0 ) || ( ImHeight == 0 ) )
             return NULL;
 
-        std::stringstream IntFileName;
+        ClassicStream IntFileName;
         IntFileName << "image" << m_images.size() + 1 << Ext;
         image = new CImage( filename, IntFileName.str(), Ptr->ImageType, ImWidth, ImHeight );
         if( ! m_pathManager->RegisterImage( filename, "/xl/media/" + image->InternalName ) )
@@ -587,7 +1239,25 @@ CImage * CWorkbook::CreateImage( const std::string & filename )
 }
 
 // ****************************************************************************
-/// @brief  ...
+/// @brief  Writes the package relationships, which are the same in every workbook
+/// @param  xmlw writer of the part
+// ****************************************************************************
+static void WritePackageRels( XMLWriter & xmlw )
+{
+    // [- zip/_rels/.rels
+    xmlw.Tag( "Relationships" ).Attr( "xmlns", ns_relationships );
+    const char * Node = "Relationship";
+    xmlw.TagL( Node ).Attr( "Id", "rId3" ).Attr( "Type", type_app ).Attr( "Target", "docProps/app.xml" ).EndL();
+    xmlw.TagL( Node ).Attr( "Id", "rId2" ).Attr( "Type", type_core ).Attr( "Target", "docProps/core.xml" ).EndL();
+    xmlw.TagL( Node ).Attr( "Id", "rId1" ).Attr( "Type", type_book ).Attr( "Target", "xl/workbook.xml" ).EndL();
+    xmlw.End( "Relationships" );
+    // zip/_rels/.rels -]
+}
+
+static const StaticPart PackageRelsPart( WritePackageRels );
+
+// ****************************************************************************
+/// @brief  Saves the document properties and registers the package relationships
 /// @return Boolean result of the operation
 // ****************************************************************************
 bool CWorkbook::SaveCore()
@@ -596,7 +1266,13 @@ bool CWorkbook::SaveCore()
         std::time_t t = std::time( NULL );
         const size_t MAX_USER_TIME_LENGTH   =   32;
         char UserTime[ MAX_USER_TIME_LENGTH ] = { 0 };
-        std::strftime( UserTime, MAX_USER_TIME_LENGTH, "%Y-%m-%dT%H:%M:%SZ", std::localtime( & t ) ) ;
+        std::tm LocalTime;
+#ifdef _WIN32
+        localtime_s( & LocalTime, & t );
+#else
+        localtime_r( & t, & LocalTime );
+#endif
+        std::strftime( UserTime, MAX_USER_TIME_LENGTH, "%Y-%m-%dT%H:%M:%SZ", & LocalTime ) ;
 
         // [- zip/docProps/core.xml
         XMLWriter xmlw( m_pathManager->RegisterXML( "/docProps/core.xml" ) );
@@ -609,17 +1285,7 @@ bool CWorkbook::SaveCore()
         xmlw.End( "cp:coreProperties" );
         // zip/docProps/core.xml -]
     }
-    {
-        // [- zip/_rels/.rels
-        XMLWriter xmlw( m_pathManager->RegisterXML( "/_rels/.rels" ) );
-        xmlw.Tag( "Relationships" ).Attr( "xmlns", ns_relationships );
-        const char * Node = "Relationship";
-        xmlw.TagL( Node ).Attr( "Id", "rId3" ).Attr( "Type", type_app ).Attr( "Target", "docProps/app.xml" ).EndL();
-        xmlw.TagL( Node ).Attr( "Id", "rId2" ).Attr( "Type", type_core ).Attr( "Target", "docProps/core.xml" ).EndL();
-        xmlw.TagL( Node ).Attr( "Id", "rId1" ).Attr( "Type", type_book ).Attr( "Target", "xl/workbook.xml" ).EndL();
-        xmlw.End( "Relationships" );
-        // zip/_rels/.rels -]
-    }
+    m_pathManager->RegisterStatic( "/_rels/.rels", PackageRelsPart );
     return true;
 }
 
@@ -640,7 +1306,7 @@ bool CWorkbook::SaveContentType()
     bool bFormula = false;
     for( std::vector<CWorksheet *>::const_iterator it = m_worksheets.begin(); it != m_worksheets.end(); it++ )
     {
-        std::stringstream PropValue;
+        ClassicStream PropValue;
         PropValue << "/xl/worksheets/sheet" << ( * it )->GetIndex() << ".xml";
         xmlw.TagL( "Override" ).Attr( "PartName", PropValue.str() ).Attr( "ContentType", content_sheet ).EndL();
         if( ( * it )->IsThereFormula() ) bFormula = true;
@@ -653,7 +1319,7 @@ bool CWorkbook::SaveContentType()
 
     for( std::vector<CChartsheet *>::const_iterator it = m_chartsheets.begin(); it != m_chartsheets.end(); it++ )
     {
-        std::stringstream PropValue;
+        ClassicStream PropValue;
         PropValue << "/xl/chartsheets/sheet" << ( * it )->GetIndex() << ".xml";
         xmlw.TagL( "Override" ).Attr( "PartName", PropValue.str() ).Attr( "ContentType", content_chartsheet ).EndL();
     }
@@ -661,19 +1327,19 @@ bool CWorkbook::SaveContentType()
     xmlw.TagL( "Override" ).Attr( "PartName", "/xl/theme/theme1.xml" ).Attr( "ContentType", content_theme ).EndL();
     xmlw.TagL( "Override" ).Attr( "PartName", "/xl/styles.xml" ).Attr( "ContentType", content_styles ).EndL();
 
-    if( ! m_sharedStrings.empty() )
+    if( ! m_sharedStrings.Empty() )
         xmlw.TagL( "Override" ).Attr( "PartName", "/xl/sharedStrings.xml" ).Attr( "ContentType", content_sharedStr ).EndL();
 
     for( std::vector<CDrawing *>::const_iterator it = m_drawings.begin(); it != m_drawings.end(); it++ )
         if( ( * it )->IsEmpty() == false )
         {
-            std::stringstream PropValue;
+            ClassicStream PropValue;
             PropValue << "/xl/drawings/drawing" << ( * it )->GetIndex() << ".xml";
             xmlw.TagL( "Override" ).Attr( "PartName", PropValue.str() ).Attr( "ContentType", content_drawing ).EndL();
         }
     for( std::vector<CChart *>::const_iterator it = m_charts.begin(); it != m_charts.end(); it++ )
     {
-        std::stringstream PropValue;
+        ClassicStream PropValue;
         PropValue << "/xl/charts/chart" << ( * it )->GetIndex() << ".xml";
         xmlw.TagL( "Override" ).Attr( "PartName", PropValue.str() ).Attr( "ContentType", content_chart ).EndL();
     }
@@ -686,7 +1352,7 @@ bool CWorkbook::SaveContentType()
         {
             if( ( * it )->IsThereComment() )
             {
-                std::stringstream Temp;
+                ClassicStream Temp;
                 Temp << "/xl/comments" << ( * it )->GetIndex() << ".xml";
                 xmlw.TagL( "Override" ).Attr( "PartName", Temp.str() ).Attr( "ContentType", content_comment ).EndL();
             }
@@ -746,13 +1412,12 @@ bool CWorkbook::SaveApp()
 }
 
 // ****************************************************************************
-/// @brief  ...
-/// @return Boolean result of the operation
+/// @brief  Writes the theme, which is the same in every workbook
+/// @param  xmlw writer of the part
 // ****************************************************************************
-bool CWorkbook::SaveTheme()
+static void WriteTheme( XMLWriter & xmlw )
 {
     // [- zip/xl/theme/theme1.xml
-    XMLWriter xmlw( m_pathManager->RegisterXML( "/xl/theme/theme1.xml" ) );
     xmlw.Tag( "a:theme" ).Attr( "xmlns:a", ns_a ).Attr( "name", "Office Theme" );
     xmlw.Tag( "a:themeElements" );
 
@@ -915,6 +1580,17 @@ bool CWorkbook::SaveTheme()
     xmlw.TagL( "a:extraClrSchemeLst" ).EndL();
     xmlw.End( "a:theme" );
     // zip/xl/theme/theme1.xml -]
+}
+
+static const StaticPart ThemePart( WriteTheme );
+
+// ****************************************************************************
+/// @brief  Registers the theme, it is generated and deflated once for all workbooks
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorkbook::SaveTheme()
+{
+    m_pathManager->RegisterStatic( "/xl/theme/theme1.xml", ThemePart );
     return true;
 }
 
@@ -924,6 +1600,9 @@ bool CWorkbook::SaveTheme()
 // ****************************************************************************
 bool CWorkbook::SaveStyles()
 {
+    if( ( m_template != NULL ) && ( m_styleList.GetIndexes().size() == m_template->m_styleCount ) )
+        return SaveFrozen( m_template->m_styleFiles );
+
     // [- zip/xl/styles.xml
     XMLWriter xmlw( m_pathManager->RegisterXML( "/xl/styles.xml" ) );
     xmlw.Tag( "styleSheet" ).Attr( "xmlns", ns_book ).Attr( "xmlns:mc", ns_mc ).Attr( "mc:Ignorable", "x14ac" ).Attr( "xmlns:x14ac", ns_x14ac );
@@ -1417,7 +2096,7 @@ bool CWorkbook::SaveCommentList( const std::vector<Comment *> & comments )
     assert( ! comments.empty() );
     {
         // [- zip/xl/commentsN.xml
-        std::stringstream FileName;
+        ClassicStream FileName;
         FileName << "/xl/comments" << comments[ 0 ]->sheetIndex << ".xml";
 
         XMLWriter xmlw( m_pathManager->RegisterXML( FileName.str() ) );
@@ -1430,7 +2109,7 @@ bool CWorkbook::SaveCommentList( const std::vector<Comment *> & comments )
     }
     {
         // [- zip/xl/drawings/vmlDrawingN.xml
-        std::stringstream FileName;
+        ClassicStream FileName;
         FileName << "/xl/drawings/vmlDrawing" << comments[ 0 ]->sheetIndex << ".vml";
 
         XMLWriter xmlw( m_pathManager->RegisterXML( FileName.str() ) );
@@ -1482,7 +2161,7 @@ void CWorkbook::AddComment( XMLWriter & xmlw, const Comment & comment ) const
 // ****************************************************************************
 void CWorkbook::AddCommentDrawing( XMLWriter & xmlw, const Comment & comment )
 {
-    std::stringstream IdValue, StyleValue;
+    ClassicStream IdValue, StyleValue;
     IdValue << "_x0000_s" << 1000u + ( ++m_commLastId );
 
     if( ( comment.x >= 0 ) && ( comment.y >= 0 ) && ( comment.width > 0 ) && ( comment.height > 0 ) )
@@ -1531,19 +2210,15 @@ void CWorkbook::AddCommentDrawing( XMLWriter & xmlw, const Comment & comment )
 bool CWorkbook::SaveSharedStrings()
 {
     // [- zip/xl/sharedStrings.xml
-    if( m_sharedStrings.empty() ) return true;
+    if( m_sharedStrings.Empty() ) return true;
 
     XMLWriter xmlw( m_pathManager->RegisterXML( "/xl/sharedStrings.xml" ) );
-    xmlw.Tag( "sst" ).Attr( "xmlns", ns_book ).Attr( "count", m_sharedStrings.size() ).Attr( "uniqueCount", m_sharedStrings.size() );
-
-    std::vector< std::pair<const std::string, uint64_t> *> pointers_to_hash;
-    pointers_to_hash.resize( m_sharedStrings.size() );
-    for( std::map<std::string, uint64_t>::iterator it = m_sharedStrings.begin(); it != m_sharedStrings.end(); it++ )
-        pointers_to_hash[it->second] = & ( * it );
+    xmlw.Tag( "sst" ).Attr( "xmlns", ns_book ).Attr( "count", m_sharedStrings.Size() ).Attr( "uniqueCount", m_sharedStrings.Size() );
 
-    std::vector< std::pair<const std::string, uint64_t> *>::const_iterator it = pointers_to_hash.begin();
-    for( ; it != pointers_to_hash.end(); it++ )
-        xmlw.Tag( "si" ).TagOnlyContent( "t", ( * it )->first ).End( "si" );
+    std::vector<const char *> Strings;
+    m_sharedStrings.List( Strings );
+    for( size_t i = 0; i < Strings.size(); i++ )
+        xmlw.Tag( "si" ).TagOnlyContent( "t", Strings[ i ] ).End( "si" );
 
     xmlw.End( "sst" );
     // zip/xl/sharedStrings.xml -]
@@ -1567,7 +2242,7 @@ bool CWorkbook::SaveWorkbook()
         {
             //sprintf( szId, "rId%zu", ( * it )->GetIndex() );
             sprintf( szId, "rId%u", unsigned( ( * it )->GetIndex() ) );
-            std::stringstream PropValue;
+            ClassicStream PropValue;
             PropValue << "worksheets/sheet" << ( * it )->GetIndex() << ".xml";
             xmlw.TagL( "Relationship" ).Attr( "Id", szId ).Attr( "Type", type_sheet ).Attr( "Target", PropValue.str() ).EndL();
             if( ( * it )->IsThereFormula() ) bFormula = true;
@@ -1576,7 +2251,7 @@ bool CWorkbook::SaveWorkbook()
         {
             //sprintf( szId, "rId%zu", ( * it )->GetIndex() );
             sprintf( szId, "rId%u", unsigned( ( * it )->GetIndex() ) );
-            std::stringstream PropValue;
+            ClassicStream PropValue;
             PropValue << "chartsheets/sheet" << ( * it )->GetIndex() << ".xml";
             xmlw.TagL( "Relationship" ).Attr( "Id", szId ).Attr( "Type", type_chartsheet ).Attr( "Target", PropValue.str() ).EndL();
         }
@@ -1587,7 +2262,7 @@ bool CWorkbook::SaveWorkbook()
             sprintf( szId, "rId%u", unsigned( id++ ) );
             xmlw.TagL( "Relationship" ).Attr( "Id", szId ).Attr( "Type", type_chain ).Attr( "Target", "calcChain.xml" ).EndL();
         }
-        if( ! m_sharedStrings.empty() )
+        if( ! m_sharedStrings.Empty() )
         {
             //sprintf( szId, "rId%zu", id++ );
             sprintf( szId, "rId%u", unsigned( id++ ) );
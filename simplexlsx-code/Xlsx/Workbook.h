@@ -25,6 +25,8 @@
 #include "SimpleXlsxDef.h"
 
 #include "Chartsheet.h"
+#include "SharedStrings.h"
+#include "RowBlock.h"
 #include "Worksheet.h"
 
 namespace SimpleXlsx
@@ -32,7 +34,12 @@ namespace SimpleXlsx
 class CChart;
 class CDrawing;
 
+class CWorkbookTemplate;
+class OutputSink;
+class PartStore;
 class PathManager;
+class StaticPart;
+class TaskPool;
 class XMLWriter;
 
 // ****************************************************************************
@@ -40,14 +47,15 @@ class XMLWriter;
 // ****************************************************************************
 class CWorkbook
 {
-        std::string                 m_temp_path;		///< path to the temporary directory (unique for a book)
+        std::string                 m_temp_path;		///< path to the temporary directory (the parts beyond the memory limit go there)
         std::vector<CWorksheet *>   m_worksheets;		///< a series of data sheets
         std::vector<CChartsheet *>  m_chartsheets;		///< a series of chart sheets
         std::vector<CChart *>       m_charts;           ///< a series of charts
         std::vector<CDrawing *>     m_drawings;         ///< a series of drawings
         std::vector<CImage *>       m_images;           ///< a series of images
-        std::map<std::string, uint64_t> m_sharedStrings;///<
+        CSharedStrings              m_sharedStrings;    ///< unique strings of all sheets
         std::vector<Comment>		m_comments;			///<
+        std::mutex                  m_commentsLock;     ///< lock of m_comments: the sheets may be filled on different threads
 
         size_t                      m_commLastId;		///< m_commLastId comments counter
         UniString                   m_UserName;
@@ -58,6 +66,10 @@ class CWorkbook
         mutable std::string         m_currencySymbol;   ///<
 
         PathManager        *        m_pathManager;      ///<
+        void               *        m_streamArchive;    ///< archive opened by StreamTo (HZIP) or NULL
+        OutputSink         *        m_streamSink;       ///< descriptor the archive opened by StreamTo writes into or NULL
+        unsigned                    m_saveThreads;      ///< threads Save generates and deflates the parts on
+        const CWorkbookTemplate  *  m_template;         ///< template the workbook is made from or NULL
 
         struct DefinedName
         {
@@ -67,7 +79,7 @@ class CWorkbook
             inline DefinedName( double AConstant, const UniString & AComment, const SimpleXlsx::CSheet * AScopeSheet ) :
                 CSheet( NULL ), ScopeSheet( AScopeSheet ), Comment( AComment )
             {
-                std::ostringstream ConvStream;
+                ClassicStream ConvStream;
                 ConvStream << AConstant;
                 PostFix = ConvStream.str();
             }
@@ -92,11 +104,16 @@ class CWorkbook
     public:
         // @section    Constructors / destructor
         CWorkbook( const UniString & UserName = "" );
+        //Makes the workbook from the template: it has the styles, sheets, charts, images and defined names
+        //of the prototype, and its sheets continue after their last rows. The settings of Save are not copied.
+        CWorkbook( const CWorkbookTemplate & Template, const UniString & UserName = "" );
         virtual ~CWorkbook();
 
         // @section    User interface
 
-        //Adds another data sheet into the workbook
+        //Adds another data sheet into the workbook.
+        //Different data sheets may be filled (rows, cells, comments) on different threads at once,
+        //except in the streaming mode. The workbook itself is used by one thread at a time.
         inline CWorksheet & AddSheet( const std::string & title )
         {
             return CreateSheet( NormalizeSheetName( title ) );
@@ -171,6 +188,13 @@ class CWorkbook
         //Vector with exist fonts
         inline const std::vector<Font> & GetFonts()	const       { return m_styleList.GetFonts(); }
 
+        //Reserves memory for the expected number of unique strings and their total length in bytes
+        inline CWorkbook & ReserveSharedStrings( size_t Count, size_t Bytes = 0 )  { m_sharedStrings.Reserve( Count, Bytes ); return * this; }
+
+        //Number of data sheets and the data sheet by its number (start from 0)
+        inline size_t GetSheetCount() const                     { return m_worksheets.size(); }
+        inline CWorksheet & GetSheet( size_t index )            { return * m_worksheets[ index ]; }
+
         //Get active (opened) sheet
         inline size_t GetActiveSheetIndex() const               { return m_activeSheetIndex; }
         //Set active (opened) sheet (start from 0).
@@ -191,6 +215,60 @@ class CWorkbook
         //Save current workbook
         bool Save( const std::string & filename );
         bool Save( const std::wstring & filename );
+        //Save current workbook into memory: the archive is put into data, written into stream,
+        //or passed to write piece by piece (which returns false if it can not be accepted).
+        //The archive is written sequentially, so its items carry data descriptors.
+        bool Save( std::vector<char> & data );
+        bool Save( std::ostream & stream );
+        bool Save( bool ( * write )( void * userData, const char * data, size_t size ), void * userData );
+        //Save current workbook into the file descriptor opened for writing, which need not be seekable
+        //(a pipe, a socket or stdout). Each part is written as soon as it is deflated.
+        bool Save( int descriptor );
+        //Until Save the parts are kept in memory up to this many bytes in all (64M by default). Beyond the limit
+        //a part being written is moved into a single anonymous temporary file, which disappears when it is closed.
+        CWorkbook & SetPartMemoryLimit( size_t bytes );
+        //Keeps all the parts in memory whatever their size, so that Save does not touch the disk
+        CWorkbook & KeepPartsInMemory( bool inMemory = true );
+
+        //Turns on the streaming mode: worksheets are deflated directly into the specified file
+        //instead of the temporary directory. Must be called before the first sheet is added.
+        //A worksheet is finished when the next one is added, so its cells, charts, images,
+        //comments and merged cells must be added before that.
+        bool StreamTo( const std::string & filename );
+        bool StreamTo( const std::wstring & filename );
+        //The same into the file descriptor opened for writing, which need not be seekable (a pipe, a socket
+        //or stdout): each worksheet reaches the reader as soon as it is finished, while the next ones are filled.
+        //The descriptor is not closed.
+        bool StreamTo( int descriptor );
+        //Finishes the file opened by StreamTo
+        bool Save();
+
+        //In the streaming mode worksheets are deflated by a background thread while the rows are being added.
+        //The XML waiting for the compression is limited by maxQueued bytes: when the limit is reached,
+        //adding of the rows waits for the compression. 0 turns the background compression off.
+        //It is off by default: it gains only the time of formatting the XML, and only with a spare CPU
+        //(on a single CPU no thread is started).
+        CWorkbook & SetBackgroundCompression( size_t maxQueued = 16 << 20 );
+
+        //Compression of the parts: COMPRESSION_STORE, deflate level 1 (fastest) ... 9 (smallest) or COMPRESSION_ADAPTIVE.
+        //The second form overrides it for the parts whose path in the archive begins with partPrefix,
+        //e.g. "xl/worksheets/" or "xl/sharedStrings.xml"; the longest matching prefix wins.
+        //Takes effect for the parts saved or streamed after the call.
+        CWorkbook & SetCompression( int level );
+        CWorkbook & SetCompression( const std::string & partPrefix, int level );
+        //COMPRESSION_ADAPTIVE chooses the level that minimizes the compression time plus the time
+        //to output the result at this rate: low for downloads (favours size), high for fast disks (speed)
+        CWorkbook & SetAdaptiveCompressionRate( double bytesPerSecond );
+        //Deflate engine of the archive (ECompressionCodec). Saving fails if it is not compiled in,
+        //which IsCompressionCodecAvailable tells beforehand.
+        CWorkbook & SetCompressionCodec( int codec );
+        static bool IsCompressionCodecAvailable( int codec );
+        //The built-in engine deflates each part on this many threads (0 for one per CPU, 1 by default).
+        //A big part is cut into chunks of 256K that are deflated at once: a little bigger, much faster.
+        CWorkbook & SetCompressionThreads( unsigned threads );
+        //Save generates the parts and deflates them on this many threads (0 for one per CPU, 1 by default).
+        //The parts are added to the archive in the same order whatever the number of threads.
+        CWorkbook & SetSaveThreads( unsigned threads );
 
     private:
         //Disable copy and assignment
@@ -203,6 +281,11 @@ class CWorkbook
         CWorksheet & CreateSheet( const UniString & title, uint32_t frozenWidth, uint32_t frozenHeight,
                                   const std::vector<ColumnWidth> & colWidths );
         CWorksheet & InitWorkSheet( CWorksheet * sheet, const UniString & title );
+        void FinishStreamedSheet();
+        void Init();
+        bool Freeze( CWorkbookTemplate & Template );
+        bool SaveFrozen( const std::vector< std::string > & Files );
+        const CSheet * TemplateSheet( const CSheet * Sheet ) const;
 
         CChartsheet & CreateChartSheet( const UniString & title, EChartTypes type );
         CDrawing * CreateDrawing();
@@ -224,6 +307,13 @@ class CWorkbook
             return Result;
         }
 
+        class PartTasks;
+        class ZipTasks;
+
+        bool SaveParts( TaskPool & Pool );
+        bool SaveTo( OutputSink & Sink );
+        bool ZipContentFiles( void * Archive, TaskPool & Pool ) const;
+        unsigned long ZipAddPart( void * Archive, const std::string & File ) const;
         bool SaveCore();
         bool SaveContentType();
         bool SaveApp();
@@ -248,6 +338,57 @@ class CWorkbook
         std::string GetFormatCodeString( const NumFormat & fmt ) const;
         static std::string GetFormatCodeColor( ENumericStyleColor color );
         static std::string CurrencySymbol();
+
+        friend class CWorkbookTemplate;
+};
+
+// ****************************************************************************
+/// @brief  The frozen structure of a workbook, to make many similar workbooks fast.
+///         The prototype is a workbook with the styles, sheets (with their column widths,
+///         frozen panes and the rows which every workbook begins with), chart sheets, charts,
+///         images and defined names. The template keeps what the sheets have written so far,
+///         and the styles, charts, chart sheets, drawings and images as the parts which are
+///         generated and deflated once (see StaticPart). The workbooks made from the template
+///         only generate their rows and the small parts which list the content. A part whose
+///         object is changed by the workbook (a style or a picture is added) is generated again.
+// ****************************************************************************
+class CWorkbookTemplate
+{
+    public:
+        //Freezes the prototype. It must not be changed or saved afterwards, and must live
+        //(as the template itself) until the workbooks made from the template are destroyed.
+        //The prototype must not be in the streaming mode nor be made from a template.
+        explicit CWorkbookTemplate( CWorkbook & Prototype );
+        ~CWorkbookTemplate();
+
+        //Returns false if the prototype can not be frozen: then the workbooks made from the template are empty
+        inline bool IsOk() const
+        {
+            return m_isOk;
+        }
+
+    private:
+        //Disable copy and assignment
+        CWorkbookTemplate( const CWorkbookTemplate & that );
+        CWorkbookTemplate & operator=( const CWorkbookTemplate & );
+
+        typedef std::vector< std::string > Files;
+
+        const CWorkbook         &   m_prototype;
+        std::vector< std::string >  m_sheetMarkup;      ///< XML every worksheet has written so far, after the declaration
+        size_t                      m_styleCount;       ///< number of the styles in styles.xml
+        Files                       m_styleFiles;       ///< the files saved for the styles
+        std::vector< Files >        m_chartsheetFiles;  ///< the files saved for every chart sheet
+        std::vector< Files >        m_chartFiles;       ///< the files saved for every chart
+        std::vector< Files >        m_drawingFiles;     ///< the files saved for every drawing
+        std::vector< size_t >       m_drawingSizes;     ///< number of the charts and images of every drawing
+        Files                       m_imageFiles;       ///< the files of the images
+        std::map< std::string, StaticPart * > m_parts;  ///< content of all the files above
+        bool                        m_isOk;
+
+        bool AddParts( const PartStore & Parts, const Files & Paths );
+
+        friend class CWorkbook;
 };
 
 }	// namespace SimpleXlsx
@@ -23,30 +23,41 @@
 #include <iomanip>
 
 #include "Worksheet.h"
+#include "Records.h"
 #include "XlsxHeaders.h"
 #include "Drawing.h"
+#include "SharedStrings.h"
 
+#include "../NumberFormatter.hpp"
 #include "../PathManager.hpp"
 #include "../XMLWriter.hpp"
 
 namespace SimpleXlsx
 {
 // ****************************************************************************
-/// @brief  Appends another a group of cells into a row
-/// @param  data template data value
-/// @param	style style index
+/// @brief  Writes the numeric cell
+/// @param  Writer the sheet or the row block writer
+/// @param  Ref reference of the cell
+/// @param  value the number
+/// @param	style_id style index
 /// @return no
 // ****************************************************************************
 template<typename T>
-static CWorksheet & AddCellRoutineTempl( T data, size_t style, const std::string & CellCoord, XMLWriter & xmlw, CWorksheet * WorkSheet )
+void CWorksheet::WriteNumberCell( XMLWriter & Writer, const char * Ref, T value, size_t style_id )
 {
-    xmlw.Tag( "c" ).Attr( "r", CellCoord );
-    if( style != 0 )    // default style is not necessary to sign explicitly
-        xmlw.Attr( "s", style );
-    xmlw.TagOnlyContent( "v", data ).End( "c" );
-    return * WorkSheet;
+    Writer.Tag( "c" ).Attr( "r", Ref );
+    if( style_id != 0 )    // default style is not necessary to sign explicitly
+        Writer.Attr( "s", style_id );
+    Writer.TagOnlyContent( "v", value ).End( "c" );
 }
 
+template void CWorksheet::WriteNumberCell<int32_t>( XMLWriter &, const char *, int32_t, size_t );
+template void CWorksheet::WriteNumberCell<uint32_t>( XMLWriter &, const char *, uint32_t, size_t );
+template void CWorksheet::WriteNumberCell<int64_t>( XMLWriter &, const char *, int64_t, size_t );
+template void CWorksheet::WriteNumberCell<uint64_t>( XMLWriter &, const char *, uint64_t, size_t );
+template void CWorksheet::WriteNumberCell<float>( XMLWriter &, const char *, float, size_t );
+template void CWorksheet::WriteNumberCell<double>( XMLWriter &, const char *, double, size_t );
+
 
 // ****************************************************************************
 /// @brief      The class constructor
@@ -103,6 +114,42 @@ CWorksheet::CWorksheet( size_t index, uint32_t width, uint32_t height, const std
     Init( width, height, colWidths );
 }
 
+// ****************************************************************************
+/// @brief      The class constructor of a sheet of a workbook made from a template (see CWorkbookTemplate)
+/// @param      prototype the sheet of the prototype workbook, the new sheet continues it
+/// @param      markup XML of the prototype sheet written so far (after the declaration)
+/// @return     no
+// ****************************************************************************
+CWorksheet::CWorksheet( const CWorksheet & prototype, const std::string & markup, CDrawing & drawing, PathManager & pathmanager ) :
+    CSheet( prototype.m_index ), m_pathManager( pathmanager ), m_Drawing( drawing )
+{
+    m_calcChain = prototype.m_calcChain;
+    m_sharedStrings = NULL;
+    m_comments = NULL;
+    m_commentsLock = NULL;
+    m_mergedCells = prototype.m_mergedCells;
+    m_autoFilter = prototype.m_autoFilter;
+    m_title = prototype.m_title;
+    m_withFormula = prototype.m_withFormula;
+    m_withComments = prototype.m_withComments;
+    m_row_index = prototype.m_row_index;
+    m_row_opened = false;
+    m_current_column = 0;
+    m_offset_column = 0;
+    m_page_orientation = prototype.m_page_orientation;
+    m_blockCount = 0;
+    m_blocksClosed = false;
+    m_submittedBlocks = NULL;
+    m_blockWriting = false;
+    m_nextBlock = 0;
+    m_saveResult = true;
+
+    m_isOk = OpenXML();
+    if( ! m_isOk ) return;
+    static const char * const OpenedTags[] = { "worksheet", "sheetData" };
+    m_XMLWriter->Resume( markup.data(), markup.size(), OpenedTags, 2 );
+}
+
 // ****************************************************************************
 /// @brief  The class destructor (virtual)
 /// @return no
@@ -110,6 +157,14 @@ CWorksheet::CWorksheet( size_t index, uint32_t width, uint32_t height, const std
 CWorksheet::~CWorksheet()
 {
     delete m_XMLWriter;
+    for( RowBlockData * Block = m_submittedBlocks; Block != NULL; )
+    {
+        RowBlockData * Next = Block->Next;
+        delete Block;
+        Block = Next;
+    }
+    for( std::map<uint64_t, RowBlockData *>::const_iterator it = m_waitingBlocks.begin(); it != m_waitingBlocks.end(); it++ )
+        delete it->second;
 }
 
 // ****************************************************************************
@@ -122,6 +177,7 @@ CWorksheet::~CWorksheet()
 void CWorksheet::Init( uint32_t frozenWidth, uint32_t frozenHeight, const std::vector<ColumnWidth> & colWidths )
 {
     m_isOk = true;
+    m_saveResult = true;
     m_row_opened = false;
     m_current_column = 0;
     m_offset_column = 0;
@@ -131,14 +187,17 @@ void CWorksheet::Init( uint32_t frozenWidth, uint32_t frozenHeight, const std::v
     m_calcChain.clear();
     m_sharedStrings = NULL;
     m_comments = NULL;
+    m_commentsLock = NULL;
     m_mergedCells.clear();
     m_row_index = 0;
     m_page_orientation = PAGE_PORTRAIT;
+    m_blockCount = 0;
+    m_blocksClosed = false;
+    m_submittedBlocks = NULL;
+    m_blockWriting = false;
+    m_nextBlock = 0;
 
-    std::stringstream FileName;
-    FileName << "/xl/worksheets/sheet" << m_index << ".xml";
-    m_XMLWriter = new XMLWriter( m_pathManager.RegisterXML( FileName.str() ) );
-    if( ( m_XMLWriter == NULL ) || ! m_XMLWriter->IsOk() )
+    if( ! OpenXML() )
     {
         m_isOk = false;
         return;
@@ -162,6 +221,21 @@ void CWorksheet::Init( uint32_t frozenWidth, uint32_t frozenHeight, const std::v
     m_XMLWriter->Tag( "sheetData" );    // open sheetData tag
 }
 
+// ****************************************************************************
+/// @brief  Registers the sheet xml and creates its writer: into the streaming archive or the part store
+/// @return Boolean result of the operation
+// ****************************************************************************
+bool CWorksheet::OpenXML()
+{
+    ClassicStream FileName;
+    FileName << "/xl/worksheets/sheet" << m_index << ".xml";
+    OutputSink * Sink = m_pathManager.RegisterStream( FileName.str() );
+    if( Sink == NULL )
+        Sink = m_pathManager.RegisterXML( FileName.str() );
+    m_XMLWriter = new XMLWriter( Sink );
+    return ( m_XMLWriter != NULL ) && m_XMLWriter->IsOk();
+}
+
 // ****************************************************************************
 /// @brief	Generates a header for another row
 /// @param	height row height (default if 0)
@@ -171,10 +245,7 @@ CWorksheet & CWorksheet::BeginRow( double height )
 {
     if( m_row_opened )
         m_XMLWriter->End( "row" );
-    m_XMLWriter->Tag( "row" ).Attr( "r", ++m_row_index ).Attr( "x14ac:dyDescent", 0.25 );
-
-    if( height > 0.0 )
-        m_XMLWriter->Attr( "ht", height ).Attr( "customHeight", 1 );
+    WriteRowTag( * m_XMLWriter, ++m_row_index, height );
 
     m_current_column = 0;
     m_row_opened = true;
@@ -201,45 +272,13 @@ CWorksheet & CWorksheet::EndRow()
 // ****************************************************************************
 CWorksheet & CWorksheet::AddCell( const char * value, size_t style_id )
 {
-    if( value[ 0 ] != '\0' )
+    const char * Formula = WriteStringCell( * m_XMLWriter, m_cellRef, m_row_index, m_offset_column + m_current_column,
+                                            m_sharedStrings, value, style_id );
+    if( Formula != NULL )
     {
-        const std::string szCoord = CellCoord( m_row_index, m_offset_column + m_current_column ).ToString();
-        m_XMLWriter->Tag( "c" ).Attr( "r", szCoord );
-
-        if( style_id != 0 )
-            m_XMLWriter->Attr( "s", style_id );  // default style is not necessary to sign explisitly
-
-        if( value[ 0 ] == '=' )
-        {
-            m_XMLWriter->TagOnlyContent( "f", value + 1 );
-
-            m_withFormula = true;
-            m_calcChain.push_back( szCoord );
-        }
-        else
-        {
-            assert( m_sharedStrings != NULL );
-            uint64_t str_index = 0;
-            std::string StdStrVal( value );
-            std::map<std::string, uint64_t>::iterator it = m_sharedStrings->find( StdStrVal );
-            if( it == m_sharedStrings->end() )
-            {
-                str_index = m_sharedStrings->size();
-                ( *m_sharedStrings )[ StdStrVal ] = str_index;
-            }
-            else str_index = it->second;
-            m_XMLWriter->Attr( "t", "s" ).TagOnlyContent( "v", str_index );
-        }
-        m_XMLWriter->End( "c" );
-    }
-    ///  empty cell with style   ---
-    else if( style_id != 0 )
-    {
-        CellCoord::TConvBuf Buffer;
-        const char * szCoord = CellCoord( m_row_index, m_offset_column + m_current_column ).ToString( Buffer );
-        m_XMLWriter->Tag( "c" ).Attr( "r", szCoord ).Attr( "s", style_id ).End( "c" );
+        m_withFormula = true;
+        m_calcChain.push_back( Formula );
     }
-    ///  empty cell with style   ---
     m_current_column++;
     return * this;
 }
@@ -251,37 +290,44 @@ CWorksheet & CWorksheet::AddCell( const char * value, size_t style_id )
 // ****************************************************************************
 CWorksheet & CWorksheet::AddCell( const CellDataTime & data )
 {
-    return AddCellRoutineTempl( data.XlsxValue(), data.style_id, GetCellCoordStrAndIncColumn(), * m_XMLWriter, this );
+    WriteNumberCell( * m_XMLWriter, GetCellCoordStrAndIncColumn(), data.XlsxValue(), data.style_id );
+    return * this;
 }
 
 CWorksheet & CWorksheet::AddCell( int32_t value, size_t style_id )
 {
-    return AddCellRoutineTempl( value, style_id, GetCellCoordStrAndIncColumn(), * m_XMLWriter, this );
+    WriteNumberCell( * m_XMLWriter, GetCellCoordStrAndIncColumn(), value, style_id );
+    return * this;
 }
 
 CWorksheet & CWorksheet::AddCell( uint32_t value, size_t style_id )
 {
-    return AddCellRoutineTempl( value, style_id, GetCellCoordStrAndIncColumn(), * m_XMLWriter, this );
+    WriteNumberCell( * m_XMLWriter, GetCellCoordStrAndIncColumn(), value, style_id );
+    return * this;
 }
 
 CWorksheet & CWorksheet::AddCell( int64_t value, size_t style_id )
 {
-    return AddCellRoutineTempl( value, style_id, GetCellCoordStrAndIncColumn(), * m_XMLWriter, this );
+    WriteNumberCell( * m_XMLWriter, GetCellCoordStrAndIncColumn(), value, style_id );
+    return * this;
 }
 
 CWorksheet & CWorksheet::AddCell( uint64_t value, size_t style_id )
 {
-    return AddCellRoutineTempl( value, style_id, GetCellCoordStrAndIncColumn(), * m_XMLWriter, this );
+    WriteNumberCell( * m_XMLWriter, GetCellCoordStrAndIncColumn(), value, style_id );
+    return * this;
 }
 
 CWorksheet & CWorksheet::AddCell( float value, size_t style_id )
 {
-    return AddCellRoutineTempl( value, style_id, GetCellCoordStrAndIncColumn(), * m_XMLWriter, this );
+    WriteNumberCell( * m_XMLWriter, GetCellCoordStrAndIncColumn(), value, style_id );
+    return * this;
 }
 
 CWorksheet & CWorksheet::AddCell( double value, size_t style_id )
 {
-    return AddCellRoutineTempl( value, style_id, GetCellCoordStrAndIncColumn(), * m_XMLWriter, this );
+    WriteNumberCell( * m_XMLWriter, GetCellCoordStrAndIncColumn(), value, style_id );
+    return * this;
 }
 
 // ****************************************************************************
@@ -323,9 +369,80 @@ void CWorksheet::AddFrozenPane( uint32_t width, uint32_t height )
         m_XMLWriter->TagL( "selection" ).Attr( "pane", "bottomLeft" ).Attr( "activeCell", szCoord ).Attr( "sqref", szCoord ).EndL();
 }
 
+// ****************************************************************************
+/// @brief  Puts the digits of the row into the cell reference buffer
+/// @param  Row row index
+/// @return no
+// ****************************************************************************
+void CWorksheet::CellReference::FormatRow( uint32_t Row )
+{
+    const size_t Count = NumberFormatter::Format( static_cast<uint64_t>( Row ), m_buffer + 3 );
+    m_buffer[ 3 + Count ] = '\0';
+    m_row = Row;
+}
+
+// ****************************************************************************
+/// @brief	Opens the row tag
+/// @param  Writer the sheet or the row block writer
+/// @param  Row row index
+/// @param	Height row height (default if 0)
+/// @return no
+// ****************************************************************************
+void CWorksheet::WriteRowTag( XMLWriter & Writer, uint32_t Row, double Height )
+{
+    Writer.Tag( "row" ).Attr( "r", Row ).Attr( "x14ac:dyDescent", 0.25 );
+    if( Height > 0.0 )
+        Writer.Attr( "ht", Height ).Attr( "customHeight", 1 );
+}
+
+// ****************************************************************************
+/// @brief	Writes the string-formatted cell: the shared string, the formula or the empty cell with style
+/// @param  Writer the sheet or the row block writer
+/// @param  Ref reference of the current cell of the writer
+/// @param  Row row index
+/// @param  Col column index
+/// @param  SharedStrings the shared strings of the workbook
+/// @param	value the string, or the formula beginning with '='
+/// @param	style_id style index
+/// @return Reference of the formula cell, to be added to the calc chain, or NULL
+// ****************************************************************************
+const char * CWorksheet::WriteStringCell( XMLWriter & Writer, CellReference & Ref, uint32_t Row, uint32_t Col,
+                                          CSharedStrings * SharedStrings, const char * value, size_t style_id )
+{
+    const char * Formula = NULL;
+    if( value[ 0 ] != '\0' )
+    {
+        const char * szCoord = Ref.Get( Row, Col );
+        Writer.Tag( "c" ).Attr( "r", szCoord );
+
+        if( style_id != 0 )
+            Writer.Attr( "s", style_id );  // default style is not necessary to sign explisitly
+
+        if( value[ 0 ] == '=' )
+        {
+            Writer.TagOnlyContent( "f", value + 1 );
+            Formula = szCoord;
+        }
+        else
+        {
+            assert( SharedStrings != NULL );
+            const uint64_t str_index = SharedStrings->Add( value );
+            Writer.Attr( "t", "s" ).TagOnlyContent( "v", str_index );
+        }
+        Writer.End( "c" );
+    }
+    ///  empty cell with style   ---
+    else if( style_id != 0 )
+    {
+        Writer.Tag( "c" ).Attr( "r", Ref.Get( Row, Col ) ).Attr( "s", style_id ).End( "c" );
+    }
+    ///  empty cell with style   ---
+    return Formula;
+}
+
 void CWorksheet::AddRowHeader( std::size_t Size, double Height )
 {
-    std::stringstream Spans;
+    ClassicStream Spans;
     Spans << m_offset_column + 1 << ':' << Size + m_offset_column + 1;
     m_XMLWriter->Tag( "row" ).Attr( "r", ++m_row_index ).Attr( "spans", Spans.str() ).Attr( "x14ac:dyDescent", 0.25 );
     if( Height > 0 )
@@ -337,6 +454,277 @@ void CWorksheet::AddRowFooter() const
     m_XMLWriter->End( "row" );
 }
 
+//Appends the text of the number to the markup
+template<typename T>
+static void AppendNumber( std::string & Markup, T Value )
+{
+    NumberFormatter::TBuffer Buffer;
+    Markup.append( Buffer, NumberFormatter::Format( Value, Buffer ) );
+}
+
+// ****************************************************************************
+/// @brief  Prepares the row header of the block
+/// @param  Sheet sheet to be written
+/// @param  ColumnCount number of the cells in a row
+/// @param  Offset the offset from the row begining
+/// @param	Height row height (default if 0)
+// ****************************************************************************
+CWorksheet::CellBlockWriter::CellBlockWriter( CWorksheet & Sheet, size_t ColumnCount, uint32_t Offset, double Height ) :
+    m_Sheet( Sheet ), m_XMLWriter( * Sheet.m_XMLWriter ), m_Offset( Offset ), m_Markup( ColumnCount ), m_RowLength( 0 ), m_Field( 0 )
+{
+    m_RowTail = "\" spans=\"";
+    AppendNumber( m_RowTail, static_cast<uint64_t>( Offset ) + 1 );
+    m_RowTail += ':';
+    AppendNumber( m_RowTail, static_cast<uint64_t>( Offset ) + ColumnCount + 1 );
+    m_RowTail += "\" x14ac:dyDescent=\"0.25\"";
+    if( Height > 0 )
+    {
+        m_RowTail += " ht=\"";
+        AppendNumber( m_RowTail, Height );
+        m_RowTail += "\" customHeight=\"1\"";
+    }
+    m_RowTail += '>';
+}
+
+CWorksheet::CellBlockWriter::~CellBlockWriter()
+{
+    m_Sheet.m_current_column = static_cast<uint32_t>( m_Markup.size() );
+}
+
+// ****************************************************************************
+/// @brief  Prepares the cell reference letters and attributes of the column
+/// @param  Column column index from the block begining
+/// @param  Style style index of the column cells
+/// @param  IsString whether the cells refer to the shared strings
+/// @return no
+// ****************************************************************************
+void CWorksheet::CellBlockWriter::SetColumn( size_t Column, size_t Style, bool IsString )
+{
+    CellMarkup & Cell = m_Markup[ Column ];
+    Cell.Style = Style;
+    const uint32_t Col = m_Offset + static_cast<uint32_t>( Column );
+    Cell.Head = "<c r=\"";
+    if( Col < CellCoord::MaxCols )
+    {
+        const CellCoord::TColLetters & Letters = CellCoord::ColumnLetters()[ Col ];
+        Cell.Head.append( Letters + 3 - Letters[ 3 ], Letters[ 3 ] );
+    }
+    else
+    {
+        CellCoord::TConvBuf Buffer;
+        const std::string Ref = CellCoord( 1, Col ).ToString( Buffer );
+        Cell.Head.append( Ref, 0, Ref.size() - 1 );
+    }
+    std::string StyleAttr;
+    if( Style != 0 )
+    {
+        StyleAttr = " s=\"";
+        AppendNumber( StyleAttr, static_cast<uint64_t>( Style ) );
+        StyleAttr += '"';
+        Cell.EmptyTail = '"' + StyleAttr + "/>";
+    }
+    Cell.Tail = '"' + StyleAttr + ( IsString ? " t=\"s\"><v>" : "><v>" );
+}
+
+// ****************************************************************************
+/// @brief  Writes the formula cell through CWorksheet::AddCell
+/// @param  Column column index from the block begining
+/// @param  Value formula beginning with '='
+/// @return no
+// ****************************************************************************
+void CWorksheet::CellBlockWriter::Formula( size_t Column, const char * Value )
+{
+    m_Sheet.m_offset_column = m_Offset;
+    m_Sheet.m_current_column = static_cast<uint32_t>( Column );
+    m_Sheet.AddCell( Value, m_Markup[ Column ].Style );
+    m_Sheet.m_offset_column = 0;
+}
+
+// ****************************************************************************
+/// @brief  Appends a block of rows, the values of the cells are taken from the columns
+/// @param  columns columns of values, one per cell of a row
+/// @param  rowCount number of rows to be added
+/// @param  offset the offset from the row begining (0 by default)
+/// @param	height row height (default if 0)
+/// @return Reference to this object
+/// @note   The row header, cell references and style attributes are prepared once
+///         for the block, only the values and the row number are formatted for a row
+// ****************************************************************************
+CWorksheet & CWorksheet::AddColumns( const std::vector<ColumnData> & columns, size_t rowCount, uint32_t offset, double height )
+{
+    EndRow();
+
+    CellBlockWriter Writer( * this, columns.size(), offset, height );
+    for( size_t i = 0; i < columns.size(); i++ )
+    {
+        const bool IsString = ( columns[ i ].type == ColumnData::COLUMN_CSTRING ) || ( columns[ i ].type == ColumnData::COLUMN_STRING );
+        Writer.SetColumn( i, columns[ i ].style_id, IsString );
+    }
+
+    for( size_t Row = 0; Row < rowCount; Row++ )
+    {
+        Writer.BeginRow();
+        for( size_t i = 0; i < columns.size(); i++ )
+        {
+            const ColumnData & Column = columns[ i ];
+            switch( Column.type )
+            {
+                case ColumnData::COLUMN_EMPTY :
+                    Writer.Empty( i );
+                    break;
+                case ColumnData::COLUMN_INT32 :
+                    Writer.Number( i, static_cast<const int32_t *>( Column.values )[ Row ] );
+                    break;
+                case ColumnData::COLUMN_UINT32 :
+                    Writer.Number( i, static_cast<const uint32_t *>( Column.values )[ Row ] );
+                    break;
+                case ColumnData::COLUMN_INT64 :
+                    Writer.Number( i, static_cast<const int64_t *>( Column.values )[ Row ] );
+                    break;
+                case ColumnData::COLUMN_UINT64 :
+                    Writer.Number( i, static_cast<const uint64_t *>( Column.values )[ Row ] );
+                    break;
+                case ColumnData::COLUMN_FLOAT :
+                    Writer.Number( i, static_cast<const float *>( Column.values )[ Row ] );
+                    break;
+                case ColumnData::COLUMN_DOUBLE :
+                    Writer.Number( i, static_cast<const double *>( Column.values )[ Row ] );
+                    break;
+                case ColumnData::COLUMN_CSTRING :
+                {
+                    const char * String = static_cast<const char * const *>( Column.values )[ Row ];
+                    Writer.String( i, String, ( String != NULL ) ? strlen( String ) : 0 );
+                    break;
+                }
+                case ColumnData::COLUMN_STRING :
+                {
+                    const std::string & String = static_cast<const std::string *>( Column.values )[ Row ];
+                    Writer.String( i, String.c_str(), String.size() );
+                    break;
+                }
+            }
+        }
+        Writer.EndRow();
+    }
+    return * this;
+}
+
+// ****************************************************************************
+/// @brief  Reserves the next rows of the sheet for a row block. The row left opened by BeginRow is closed.
+/// @param  Count number of the rows, it is reduced if the sheet limit is reached
+/// @param  Sequence receives the number of the block in the order of the reservation
+/// @return Number of the first reserved row or 0 if the sheet is finished (then Count is 0 too)
+// ****************************************************************************
+uint32_t CWorksheet::ReserveRows( uint32_t & Count, uint64_t & Sequence )
+{
+    std::lock_guard<std::mutex> Lock( m_blockLock );
+    if( m_blocksClosed || ! m_isOk || ( m_XMLWriter == NULL ) )
+    {
+        Count = 0;
+        return 0;
+    }
+    EndRow();   //no block is reserved before the first one, so nobody writes into the sheet yet
+    if( Count > CellCoord::MaxRows - m_row_index ) Count = CellCoord::MaxRows - m_row_index;
+    Sequence = m_blockCount++;
+    const uint32_t First = m_row_index + 1;
+    m_row_index += Count;
+    return First;
+}
+
+// ****************************************************************************
+/// @brief  Takes the submitted block and writes the blocks which are next in the order
+/// @param  Block the block, it is deleted by the sheet
+/// @return false if the sheet is already finished: the block is dropped
+// ****************************************************************************
+bool CWorksheet::SubmitRows( RowBlockData * Block )
+{
+    {
+        //the lock keeps FlushRowBlocks from taking the stack before the block is there
+        std::lock_guard<std::mutex> Lock( m_blockLock );
+        if( ! m_blocksClosed )
+        {
+            Block->Next = m_submittedBlocks.load();
+            while( ! m_submittedBlocks.compare_exchange_weak( Block->Next, Block ) ) {}
+            Block = NULL;
+        }
+    }
+    if( Block != NULL )
+    {
+        delete Block;
+        return false;
+    }
+    WriteRowBlocks();
+    return true;
+}
+
+// ****************************************************************************
+/// @brief  Writes the submitted blocks which are next in the order of the reservation.
+///         One thread writes at a time: the thread which finds another one writing leaves
+///         its block to it, and the writer looks for the new blocks again after it is done.
+/// @return no
+// ****************************************************************************
+void CWorksheet::WriteRowBlocks()
+{
+    for( ;; )
+    {
+        bool Writing = false;
+        if( ! m_blockWriting.compare_exchange_strong( Writing, true ) ) return;
+
+        for( RowBlockData * Block = m_submittedBlocks.exchange( NULL ); Block != NULL; )
+        {
+            RowBlockData * Next = Block->Next;
+            m_waitingBlocks[ Block->Sequence ] = Block;
+            Block = Next;
+        }
+        std::map<uint64_t, RowBlockData *>::iterator it;
+        while( ( it = m_waitingBlocks.find( m_nextBlock ) ) != m_waitingBlocks.end() )
+        {
+            WriteRowBlock( * it->second );
+            delete it->second;
+            m_waitingBlocks.erase( it );
+            m_nextBlock++;
+        }
+
+        m_blockWriting = false;
+        if( m_submittedBlocks.load() == NULL ) return;
+    }
+}
+
+//Writes the rows and the formulae of the block into the sheet
+void CWorksheet::WriteRowBlock( const RowBlockData & Block )
+{
+    if( ! Block.Markup.empty() )
+        m_XMLWriter->Raw( Block.Markup.data(), Block.Markup.size() );
+    if( ! Block.CalcChain.empty() )
+    {
+        m_withFormula = true;
+        m_calcChain.insert( m_calcChain.end(), Block.CalcChain.begin(), Block.CalcChain.end() );
+    }
+}
+
+// ****************************************************************************
+/// @brief  Writes the blocks left when the sheet is finished, no block is taken after it.
+///         The rows of a block which has not been submitted stay empty, the following blocks are written.
+/// @return false if some reserved block has not been submitted
+// ****************************************************************************
+bool CWorksheet::FlushRowBlocks()
+{
+    {
+        std::lock_guard<std::mutex> Lock( m_blockLock );
+        m_blocksClosed = true;
+    }
+    WriteRowBlocks();
+    const bool Complete = ( m_nextBlock == m_blockCount );
+    for( std::map<uint64_t, RowBlockData *>::const_iterator it = m_waitingBlocks.begin(); it != m_waitingBlocks.end(); it++ )
+    {
+        WriteRowBlock( * it->second );
+        delete it->second;
+    }
+    m_waitingBlocks.clear();
+    m_nextBlock = m_blockCount;
+    return Complete;
+}
+
 // ****************************************************************************
 /// @brief  Appends merged cells range into the sheet
 /// @param  cellFrom (row value from 1, col value from 0)
@@ -380,6 +768,9 @@ const CWorksheet & CWorksheet::GetCurrentCellCoord( CellCoord & currCell ) const
 // ****************************************************************************
 bool CWorksheet::Save()
 {
+    if( m_XMLWriter == NULL ) return m_saveResult;  // already saved (streaming mode)
+
+    const bool BlocksComplete = FlushRowBlocks();
     m_XMLWriter->End( "sheetData" );    // close sheetData tag
 
     if( ! m_mergedCells.empty() )
@@ -407,14 +798,14 @@ bool CWorksheet::Save()
     size_t rId = 1;
     if( ! m_Drawing.IsEmpty() )
     {
-        std::stringstream rIdStream;
+        ClassicStream rIdStream;
         rIdStream << "rId" << rId;
         m_XMLWriter->TagL( "drawing" ).Attr( "r:id", rIdStream.str() ).EndL();
         rId++;
     }
     if( m_withComments )
     {
-        std::stringstream rIdStream;
+        ClassicStream rIdStream;
         rIdStream << "rId" << rId;
         m_XMLWriter->TagL( "legacyDrawing" ).Attr( "r:id", rIdStream.str() ).EndL();
         rId += 2;
@@ -422,14 +813,15 @@ bool CWorksheet::Save()
 
     m_XMLWriter->End( "worksheet" );
 
-    // by deleting the stream the end of file writes and closes the stream
+    // by closing the stream the end of file writes and the archive item is finished
+    m_saveResult = m_XMLWriter->Close() && BlocksComplete;
     delete m_XMLWriter;
     m_XMLWriter = NULL;
 
-    if( ( rId != 1 ) && ! SaveSheetRels() ) { return false; }
+    if( m_saveResult && ( rId != 1 ) && ! SaveSheetRels() ) m_saveResult = false;
 
     m_isOk = false;
-    return true;
+    return m_saveResult;
 }
 
 // ****************************************************************************
@@ -439,7 +831,7 @@ bool CWorksheet::Save()
 bool CWorksheet::SaveSheetRels()
 {
     // [- zip/xl/worksheets/_rels/sheetN.xml.rels
-    std::stringstream FileName;
+    ClassicStream FileName;
     FileName << "/xl/worksheets/_rels/sheet" << m_index << ".xml.rels";
 
     XMLWriter xmlw( m_pathManager.RegisterXML( FileName.str() ) );
@@ -447,7 +839,7 @@ bool CWorksheet::SaveSheetRels()
     size_t rId = 1;
     if( ! m_Drawing.IsEmpty() )
     {
-        std::stringstream rIdStream, Drawing;
+        ClassicStream rIdStream, Drawing;
         rIdStream << "rId" << rId;
         Drawing << "../drawings/drawing" << m_index << ".xml";
         xmlw.TagL( "Relationship" ).Attr( "Id", rIdStream.str() ).Attr( "Type", type_drawing ).Attr( "Target", Drawing.str() ).EndL();
@@ -455,7 +847,7 @@ bool CWorksheet::SaveSheetRels()
     }
     if( m_withComments )
     {
-        std::stringstream Vml, Comments, rIdVml, rIdComments;
+        ClassicStream Vml, Comments, rIdVml, rIdComments;
         Vml << "../drawings/vmlDrawing" << m_index << ".vml";
         Comments << "../comments" << m_index << ".xml";
         rIdVml << "rId" << rId;
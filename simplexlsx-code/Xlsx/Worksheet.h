@@ -22,8 +22,11 @@
 #ifndef XLSX_WORKSHEET_H
 #define XLSX_WORKSHEET_H
 
+#include <atomic>
+#include <cstring>
 #include <list>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -32,6 +35,8 @@
 namespace SimpleXlsx
 {
 class CDrawing;
+class CRowBlock;
+class CSharedStrings;
 
 class PathManager;
 class XMLWriter;
@@ -52,25 +57,74 @@ class CWorksheet : public CSheet
     private:
         XMLWriter       *       m_XMLWriter;        ///< xml output stream
         std::vector<std::string>m_calcChain;        ///< list of cells with formulae
-        std::map<std::string, uint64_t> * m_sharedStrings; ///< pointer to the list of string supposed to be into shared area
+        CSharedStrings     *    m_sharedStrings;    ///< pointer to the list of string supposed to be into shared area
         std::vector<Comment> *	m_comments;         ///< pointer to the vector of comments
+        std::mutex      *       m_commentsLock;     ///< lock of the vector of comments (it is shared by all sheets)
         std::list<std::string>  m_mergedCells;	///< list of merged cells` ranges (e.g. A1:B2)
     std::string             m_autoFilter;       ///< autofilter range (e.g. A1:B2)
         UniString             	m_title;            ///< page title
         bool                    m_withFormula;      ///< indicates whether the sheet contains formulae
         bool					m_withComments;		///< indicates whether the sheet contains any comments
         bool                    m_isOk;             ///< indicates initialization successfulness
+        bool                    m_saveResult;       ///< result of Save, returned by the later calls once the XML is finished
         bool                    m_isDataPresented;  ///< indicates whether the sheet contains a data
         uint32_t				m_row_index;        ///< since data add row-by-row it contains current row to write
         bool					m_row_opened;		///< indicates whether row tag is opened
         uint32_t				m_current_column;	///< used at separate row generation - last cell column number to be added
         uint32_t				m_offset_column;	///< used at entire row addition (implicit parameter for AddCell method)
 
+        static const uint32_t   InvalidRow = 0xFFFFFFFF;
+
+        //Reference of a cell. Row digits are formatted once per row, column letters are taken from the table.
+        class CellReference
+        {
+            public:
+                inline CellReference() : m_row( InvalidRow ), m_colLetters( CellCoord::ColumnLetters() ) {}
+
+                inline const char * Get( uint32_t Row, uint32_t Col )
+                {
+                    if( Col >= CellCoord::MaxCols )
+                    {
+                        m_row = InvalidRow;
+                        return CellCoord( Row, Col ).ToString( m_buffer );
+                    }
+                    if( m_row != Row ) FormatRow( Row );
+                    memcpy( m_buffer, m_colLetters[ Col ], 3 );
+                    return m_buffer + 3 - m_colLetters[ Col ][ 3 ];
+                }
+
+            private:
+                void FormatRow( uint32_t Row );
+
+                CellCoord::TConvBuf             m_buffer;       ///< column letters are put before the row digits
+                uint32_t                        m_row;          ///< row which digits are in m_buffer now
+                const CellCoord::TColLetters *  m_colLetters;   ///< letters of all columns
+        };
+
+        CellReference           m_cellRef;          ///< reference of the current cell
+
         EPageOrientation		m_page_orientation;	///< defines page orientation for printing
 
         PathManager      &      m_pathManager;      ///< reference to XML PathManager
         CDrawing        &       m_Drawing;          ///< Reference to drawing object
 
+        //Rows of a block (see CRowBlock) submitted to the sheet
+        struct RowBlockData
+        {
+            RowBlockData    *       Next;           ///< next block in the stack of the submitted ones
+            uint64_t                Sequence;       ///< number of the block in the order of the reservation
+            std::vector<char>       Markup;         ///< the rows
+            std::vector<std::string>CalcChain;      ///< cells with formulae
+        };
+
+        std::mutex                  m_blockLock;        ///< guards the reservation of the rows for the blocks
+        uint64_t                    m_blockCount;       ///< number of the reserved blocks
+        bool                        m_blocksClosed;     ///< the rows are finished, no block is taken any more
+        std::atomic<RowBlockData *> m_submittedBlocks;  ///< lock-free stack of the submitted blocks not taken by the writer yet
+        std::atomic<bool>           m_blockWriting;     ///< some thread writes the blocks into the sheet now
+        std::map<uint64_t, RowBlockData *> m_waitingBlocks; ///< blocks waiting for the previous ones (the writer only)
+        uint64_t                    m_nextBlock;        ///< number of the block to be written next (the writer only)
+
     public:
         // *INDENT-OFF*   For AStyle tool
 
@@ -91,6 +145,7 @@ class CWorksheet : public CSheet
         {
             if( m_comments == NULL )
                 return * this;
+            std::lock_guard<std::mutex> Lock( * m_commentsLock );
             m_comments->push_back( comment );
             m_comments->back().sheetIndex = m_index;
             m_withComments = true;
@@ -140,6 +195,13 @@ class CWorksheet : public CSheet
         CWorksheet & AddRow( const std::vector<CellDataFlt> & data, uint32_t offset = 0, double height = 0.0 )  { return AddRowTempl( data, offset, height ); }
         CWorksheet & AddRow( const std::vector<CellDataDbl> & data, uint32_t offset = 0, double height = 0.0 )  { return AddRowTempl( data, offset, height ); }
 
+        CWorksheet & AddColumns( const std::vector<ColumnData> & columns, size_t rowCount, uint32_t offset = 0, double height = 0.0 );
+
+        //The fields of the record are described by XLSX_RECORD, see Records.h
+        template<typename Record>
+        CWorksheet & AddRecords( const std::vector<Record> & records, const std::vector<size_t> & styles = std::vector<size_t>(),
+                                 uint32_t offset = 0, double height = 0.0 );
+
         CWorksheet & AddEmptyRow( double height = 0.0 ) { return BeginRow( height ).EndRow(); }
         CWorksheet & AddEmptyRows( size_t count, double height = 0.0 ) { for( size_t i = 0; i < count; ++i ) AddEmptyRow( height ); return * this; }
 
@@ -186,6 +248,7 @@ class CWorksheet : public CSheet
         CWorksheet( size_t index, uint32_t width, uint32_t height, CDrawing & drawing, PathManager & pathmanager );
         CWorksheet( size_t index, uint32_t width, uint32_t height, const std::vector<ColumnWidth> & colHeights,
                     CDrawing & drawing, PathManager & pathmanager );
+        CWorksheet( const CWorksheet & prototype, const std::string & markup, CDrawing & drawing, PathManager & pathmanager );
         virtual ~CWorksheet();
 
     private:
@@ -196,11 +259,12 @@ class CWorksheet : public CSheet
         bool Save();
 
         // *INDENT-OFF*   For AStyle tool
-        inline void     SetSharedStr( std::map<std::string, uint64_t> * share ) { m_sharedStrings = share; }
-        inline void     SetComments( std::vector<Comment> * share )             { m_comments = share; }
+        inline void     SetSharedStr( CSharedStrings * share )                  { m_sharedStrings = share; }
+        inline void     SetComments( std::vector<Comment> * share, std::mutex * lock )  { m_comments = share; m_commentsLock = lock; }
         // *INDENT-ON*   For AStyle tool
 
         void Init( uint32_t frozenWidth, uint32_t frozenHeight, const std::vector<ColumnWidth> & colHeights );
+        bool OpenXML();
         void AddFrozenPane( uint32_t width, uint32_t height );
 
         template<typename T>
@@ -214,13 +278,36 @@ class CWorksheet : public CSheet
 
         bool SaveSheetRels();
 
-        inline std::string GetCellCoordStrAndIncColumn()
+        //Reference of the current cell
+        inline const char * GetCellCoordStr()
+        {
+            return m_cellRef.Get( m_row_index, m_offset_column + m_current_column );
+        }
+
+        inline const char * GetCellCoordStrAndIncColumn()
         {
-            std::string Result = CellCoord( m_row_index, m_offset_column + m_current_column ).ToString();
+            const char * Result = GetCellCoordStr();
             m_current_column++;
             return Result;
         }
 
+        //The markup of the rows and cells, the same for the sheet and its row blocks (see CRowBlock)
+        static void WriteRowTag( XMLWriter & Writer, uint32_t Row, double Height );
+        //Returns the reference of a formula cell, to be added to the calc chain, or NULL
+        static const char * WriteStringCell( XMLWriter & Writer, CellReference & Ref, uint32_t Row, uint32_t Col,
+                                             CSharedStrings * SharedStrings, const char * value, size_t style_id );
+        template<typename T>
+        static void WriteNumberCell( XMLWriter & Writer, const char * Ref, T value, size_t style_id );
+
+        uint32_t ReserveRows( uint32_t & Count, uint64_t & Sequence );
+        bool SubmitRows( RowBlockData * Block );
+        void WriteRowBlocks();
+        void WriteRowBlock( const RowBlockData & Block );
+        bool FlushRowBlocks();
+
+        class CellBlockWriter;
+
+        friend class CRowBlock;
         friend class CWorkbook;
 };
 
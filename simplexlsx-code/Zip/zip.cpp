@@ -1,3 +1,8 @@
+// the archive and its items may be larger than 2 GB on 32-bit POSIX systems too
+#if !defined(_WIN32) && !defined(_FILE_OFFSET_BITS)
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdint.h>
 
 #include "../PathManager.hpp"
@@ -39,8 +44,29 @@
 #endif
 
 #include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "zip.h"
 
+// crc32 uses carry-less multiplication where the cpu has it (checked at run time)
+#if !defined(ZIP_NO_PCLMUL) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define ZIP_CRC_PCLMUL
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>      // _BitScanForward for the match lengths
+#endif
+
 // The latest modifications were made by Pavel Akimov.
 // Added port into UNIX-based systems. Windows version didn`t change.
 // In UNIX port the compressing files functionality only available.
@@ -109,6 +135,8 @@
 typedef uint8_t uch;      // unsigned 8-bit value
 typedef uint16_t ush;     // unsigned 16-bit value
 typedef uint32_t ulg;      // unsigned 32-bit value
+typedef int64_t zoff_t;         // file size or offset, -1 if unknown
+typedef uint64_t uzoff_t;       // file size or offset in the zip (Zip64)
 typedef size_t extent;          // file size
 typedef uint32_t Pos;   // must be at least 32 bits
 typedef uint32_t IPos; // A Pos is an index in the character window. Pos is used only for parameter passing
@@ -161,6 +189,8 @@ typedef uint32_t IPos; // A Pos is an index in the character window. Pos is used
 #define LOCHEAD 26
 #define CENHEAD 42
 #define ENDHEAD 18
+#define ZIP64ENDHEAD 52
+#define ZIP64LOCHEAD 16
 
 // Definitions for extra field handling:
 #define EB_HEADSIZE       4     /* length of a extra field block header */
@@ -174,11 +204,37 @@ typedef uint32_t IPos; // A Pos is an index in the character window. Pos is used
 #define EB_UT_LEN(n)      (EB_UT_MINLEN + 4 * (n))
 #define EB_L_UT_SIZE    (EB_HEADSIZE + EB_UT_LEN(3))
 #define EB_C_UT_SIZE    (EB_HEADSIZE + EB_UT_LEN(1))
+#define EF_ZIP64          0x0001 /* Zip64 extended information extra field */
+#define EB_L_ZIP64_SIZE   (EB_HEADSIZE + 16)      /* uncompressed and compressed sizes */
+#define EB_C_ZIP64_SIZE   (EB_HEADSIZE + 24)      /* sizes and the local header offset */
+
+// Zip64 is used when a size or an offset does not fit into 32 bits,
+// or there are too many entries for the end of the central directory
+#define ZIP64_LIMIT       0xFFFFFFFFUL
+#define ZIP64_ENTRIES     0xFFFF
+// Items that may grow up to ZIP64_LIMIT when compressed get the Zip64 extra field in the
+// local header from the start, so that it can be rewritten in place. The margin covers
+// the deflate overhead of incompressible data.
+#define ZIP64_LOCAL_LIMIT (ZIP64_LIMIT - (ZIP64_LIMIT >> 10))
+
+// ZIP_LEVEL_ADAPTIVE compresses this much of the start of an item at each candidate level.
+// Items smaller than ZIP_SAMPLE_MIN just get the default level: there is little to gain.
+#define ZIP_SAMPLE_SIZE   (128*1024)
+#define ZIP_SAMPLE_MIN    (4*ZIP_SAMPLE_SIZE)
+#define ZIP_ADAPTIVE_RATE (10.0*1024*1024)  // bytes per second, e.g. a network share or a download
+
+#define ZIP_PARALLEL_CHUNK (256*1024) // input of a chunk deflated on its own, see ZipSetThreads
+#define ZIP_WRITER_BUFFER (64*1024)   // the output of CreateZipWriter is passed in blocks of this size
+
+#ifndef ZIP_CODEC_DEFAULT
+#define ZIP_CODEC_DEFAULT ZIP_CODEC_BUILTIN // the deflate engine of a new zip, see ZipSetCodec
+#endif
 
 
 // Macros for writing machine integers to little-endian format
 #define PUTSH(a,f) {char _putsh_c=(char)((a)&0xff); wfunc(param,&_putsh_c,1); _putsh_c=(char)((a)>>8); wfunc(param,&_putsh_c,1);}
 #define PUTLG(a,f) {PUTSH((a) & 0xffff,(f)) PUTSH((a) >> 16,(f))}
+#define PUTLL(a,f) {PUTLG((ulg)((a) & 0xffffffff),(f)) PUTLG((ulg)((uzoff_t)(a) >> 32),(f))}
 
 
 // -- Structure of a ZIP file --
@@ -187,6 +243,8 @@ typedef uint32_t IPos; // A Pos is an index in the character window. Pos is used
 #define CENSIG     0x02014b50L
 #define ENDSIG     0x06054b50L
 #define EXTLOCSIG  0x08074b50L
+#define ZIP64ENDSIG 0x06064b50L
+#define ZIP64LOCSIG 0x07064b50L
 
 
 #define MIN_MATCH  3
@@ -215,6 +273,8 @@ typedef uint32_t IPos; // A Pos is an index in the character window. Pos is used
 #define ZIP_FILENAME 2
 #define ZIP_MEMORY   3
 #define ZIP_FOLDER   4
+#define ZIP_DEFLATED 5   // memory holding deflate data, see ZipAddDeflated
+#define ZIP_WRITER   6   // output through a function, see CreateZipWriter
 
 
 
@@ -252,10 +312,12 @@ typedef uint32_t IPos; // A Pos is an index in the character window. Pos is used
 #define DYN_TREES    2
 // The three kinds of block type
 
-#define LIT_BUFSIZE  0x8000
+#define LIT_BUFSIZE  0x10000
 #define DIST_BUFSIZE  LIT_BUFSIZE
-// Sizes of match buffers for literals/lengths and distances.  There are
-// 4 reasons for limiting LIT_BUFSIZE to 64K:
+// Sizes of match buffers for literals/lengths and distances. Repetitive input
+// such as XML compresses well in big blocks: the trees are sent less often.
+// (The frequencies still fit 16 bits since a block ends at LIT_BUFSIZE-1.)
+// There are 4 reasons for limiting LIT_BUFSIZE to 64K:
 //   - frequencies can be kept in 16 bit counters
 //   - if compression is not successful for the first block, all input data is
 //     still in the window so we can still emit a stored block even when input
@@ -312,8 +374,11 @@ typedef uint32_t IPos; // A Pos is an index in the character window. Pos is used
 
 // DEFLATE.CPP HEADER
 
-#define HASH_BITS  15
-// For portability to 16 bit machines, do not use values above 15.
+#define HASH_BITS  16
+#define HASH_BYTES 4
+// The hash is of the next HASH_BYTES bytes. Hashing 4 bytes instead of MIN_MATCH
+// keeps the chains of repetitive input short, at the price of most matches of
+// length 3, which are worth little anyway.
 
 #define HASH_SIZE (unsigned)(1<<HASH_BITS)
 #define HASH_MASK (HASH_SIZE-1)
@@ -339,11 +404,9 @@ typedef uint32_t IPos; // A Pos is an index in the character window. Pos is used
 // ===========================================================================
 // Local data used by the "longest match" routines.
 
-#define H_SHIFT  ((HASH_BITS+MIN_MATCH-1)/MIN_MATCH)
-// Number of bits by which ins_h and del_h must be shifted at each
-// input step. It must be such that after MIN_MATCH steps, the oldest
-// byte no longer takes part in the hash key, that is:
-//   H_SHIFT * MIN_MATCH >= HASH_BITS
+#define WPAD 8
+// The window is followed by WPAD bytes, since matches are compared a word
+// at a time and may read that far beyond strstart+MAX_MATCH.
 
 #define max_insert_length  max_lazy_match
 // Insert new strings in the hash table only if the match length
@@ -394,6 +457,15 @@ const config configuration_table[10] = {
 
 // Note: the deflate() code requires max_lazy >= MIN_MATCH and max_chain >= 4
 // For deflate_fast() (levels <= 3) good is ignored and lazy has a different meaning.
+// Level 9 doesn't use the table: it's parsed by deflate_opt() with the values below.
+
+#define OPT_CHUNK   4096
+// deflate_opt() chooses the matches of OPT_CHUNK positions at once. The chunks
+// are aligned (WSIZE is a multiple) so that they don't depend on how the input
+// arrives when streaming.
+#define OPT_MATCHES 8    // most matches kept per position, of increasing lengths
+#define OPT_CHAIN   32   // longest hash chain searched
+#define OPT_NICE    128  // the positions a match this long covers aren't searched
 
 
 
@@ -488,10 +560,10 @@ class TTreeState
   ulg opt_len;          // bit length of current block with optimal trees
   ulg static_len;       // bit length of current block with static trees
 
-  ulg cmpr_bytelen;     // total byte length of compressed file
+  uzoff_t cmpr_bytelen; // total byte length of compressed file
   ulg cmpr_len_bits;    // number of bits past 'cmpr_bytelen'
 
-  ulg input_len;        // total byte length of input file
+  uzoff_t input_len;    // total byte length of input file
   // input_len is for debugging only since we can get it by other means.
 
   ush *file_type;       // pointer to UNKNOWN, BINARY or ASCII
@@ -527,7 +599,7 @@ class TBitState
   // On 16 bit machines, the buffer is limited to 64K.
   unsigned out_size;
   // Size of current output buffer
-  ulg bits_sent;   // bit length of the compressed data  only needed for debugging???
+  uzoff_t bits_sent; // bit length of the compressed data  only needed for debugging???
 };
 
 
@@ -538,9 +610,9 @@ class TBitState
 
 class TDeflateState
 { public:
-  TDeflateState() {window_size=0;}
+  TDeflateState() {window_size=0; memset(window+2L*WSIZE,0,WPAD);}
 
-  uch    window[2L*WSIZE];
+  uch    window[2L*WSIZE+WPAD];
   // Sliding window. Input bytes are read into the second half of the window,
   // and move to the first half later to keep a dictionary of at least WSIZE
   // bytes. With this organization, matches are limited to a distance of
@@ -568,7 +640,7 @@ class TDeflateState
   int sliding;
   // Set to false when the input file is already in memory
 
-  unsigned ins_h;  // hash index of string to be inserted
+  unsigned ins_h;  // hash index of the last string inserted
 
   unsigned int prev_length;
   // Length of the best match at previous step. Matches not greater than this
@@ -592,6 +664,25 @@ class TDeflateState
   // Use a faster search when the previous match is longer than this
 
   int nice_match; // Stop searching when current match exceeds this
+
+  int streaming;  // input is pushed piece by piece instead of being pulled by readfunc
+  int finishing;  // streaming: no more input will be pushed, compress up to the end
+  int starved;    // streaming: the pushed input is exhausted, wait for more
+
+  int match_available;    // lazy deflate() state kept between streamed pieces
+  unsigned match_length;
+
+  int partial;    // the input is a chunk of the item, whose output mustn't end it (see flush_last)
+
+  // deflate_opt() state: the bit costs of the symbols, taken from the trees of
+  // the last block (opt_costs is cleared when a block is flushed), and the
+  // matches found at each position of the chunk with the cheapest parse.
+  int opt_costs, opt_trees;
+  ulg opt_litcost[LITERALS], opt_lencost[MAX_MATCH+1], opt_distcost[D_CODES];
+  ush opt_len[OPT_CHUNK*OPT_MATCHES], opt_dist[OPT_CHUNK*OPT_MATCHES];
+  uch opt_nmatch[OPT_CHUNK];
+  ulg opt_price[OPT_CHUNK+1];
+  ush opt_choice[OPT_CHUNK], opt_choicedist[OPT_CHUNK];
 };
 
 typedef int64_t lutime_t;       // define it ourselves since we don't include time.h
@@ -602,10 +693,13 @@ typedef struct iztimes {
 
 typedef struct zlist {
   ush vem, ver, flg, how;       // See central header in zipfile.c for what vem..off are
-  ulg tim, crc, siz, len;
+  ulg tim, crc;
+  uzoff_t siz, len;
   extent nam, ext, cext, com;   // offset of ext must be >= LOCHEAD
   ush dsk, att, lflg;           // offset of lflg must be >= LOCHEAD
-  ulg atx, off;
+  ulg atx;
+  uzoff_t off;
+  int zip64;                    // the local header has the Zip64 extra field (the last one in extra)
   char name[MAX_PATH];          // File name in zip file
   char *extra;                  // Extra field (set only if ext != 0)
   char *cextra;                 // Extra in central (set only if cext != 0)
@@ -1196,7 +1290,7 @@ void send_all_trees(TState &state,int lcodes, int dcodes, int blcodes)
  * trees or store, and output the encoded block to the zip file. This function
  * returns the total compressed length (in bytes) for the file so far.
  */
-ulg flush_block(TState &state,char *buf, ulg stored_len, int eof)
+uzoff_t flush_block(TState &state,char *buf, ulg stored_len, int eof)
 {
     ulg opt_lenb, static_lenb; /* opt_len and static_len in bytes */
     int max_blindex;  /* index of last bit length code of non zero freq */
@@ -1513,32 +1607,65 @@ void copy_block(TState &state, char *block, unsigned len, int header)
  */
 
 void fill_window  (TState &state);
-ulg deflate_fast  (TState &state);
+int  stream_refill(TState &state);
+void lm_dict(TState &state, unsigned dictlen);
+uzoff_t flush_last(TState &state);
+void slide_window(TState &state);
+uzoff_t deflate_fast(TState &state);
+uzoff_t deflate_opt(TState &state);
 
 int  longest_match (TState &state,IPos cur_match);
 
 
 /* ===========================================================================
- * Update a hash value with the given input byte
- * IN  assertion: all calls to to UPDATE_HASH are made with consecutive
- *    input characters, so that a running hash key can be computed from the
- *    previous key instead of complete recalculation each time.
+ * Hash of the HASH_BYTES bytes at p (multiplicative, Knuth's golden ratio)
  */
-#define UPDATE_HASH(h,c) (h = (((h)<<H_SHIFT) ^ (c)) & HASH_MASK)
+#define HASH(p) ((unsigned)((((ulg)(p)[0] | ((ulg)(p)[1]<<8) | ((ulg)(p)[2]<<16) | ((ulg)(p)[3]<<24)) \
+                 * 2654435761U) >> (32-HASH_BITS)))
 
 /* ===========================================================================
  * Insert string s in the dictionary and set match_head to the previous head
- * of the hash chain (the most recent string with same hash key). Return
- * the previous length of the hash chain.
- * IN  assertion: all calls to to INSERT_STRING are made with consecutive
- *    input characters and the first MIN_MATCH bytes of s are valid
- *    (except for the last MIN_MATCH-1 bytes of the input file).
+ * of the hash chain (the most recent string with same hash key).
+ * IN  assertion: the first HASH_BYTES bytes of s are valid.
  */
 #define INSERT_STRING(s, match_head) \
-   (UPDATE_HASH(state.ds.ins_h, state.ds.window[(s) + (MIN_MATCH-1)]), \
+   (state.ds.ins_h = HASH(state.ds.window + (s)), \
     state.ds.prev[(s) & WMASK] = match_head = state.ds.head[state.ds.ins_h], \
     state.ds.head[state.ds.ins_h] = (s))
 
+/* ===========================================================================
+ * Length of the common prefix of two strings, up to MAX_MATCH. It's compared
+ * a word at a time where the byte order is known, and may read a word beyond.
+ */
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+static inline unsigned ctz64(uint64_t x)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+  unsigned long i; _BitScanForward64(&i,x); return (unsigned)i;
+#elif defined(_MSC_VER)
+  unsigned long i; if (_BitScanForward(&i,(unsigned long)x)) return (unsigned)i;
+  _BitScanForward(&i,(unsigned long)(x>>32)); return (unsigned)i+32;
+#else
+  return (unsigned)__builtin_ctzll(x);
+#endif
+}
+static inline unsigned match_len(const uch *scan, const uch *match)
+{ unsigned len = 0;
+  do
+  { uint64_t a, b; memcpy(&a,scan+len,8); memcpy(&b,match+len,8);
+    if (a!=b) {len += ctz64(a^b)>>3; return len < MAX_MATCH ? len : MAX_MATCH;}
+    len += 8;
+  } while (len < MAX_MATCH);
+  return MAX_MATCH;
+}
+#else
+static inline unsigned match_len(const uch *scan, const uch *match)
+{ unsigned len = 0;
+  while (len < MAX_MATCH && scan[len]==match[len]) len++;
+  return len;
+}
+#endif
+
 /* ===========================================================================
  * Initialize the "longest match" routines for a new file
  *
@@ -1552,7 +1679,7 @@ void lm_init (TState &state, int pack_level, ush *flags)
 {
     unsigned j;
 
-    Assert(state,pack_level>=1 && pack_level<=8,"bad pack level");
+    Assert(state,pack_level>=1 && pack_level<=9,"bad pack level");
 
     /* Do not slide the window if the whole input is already in memory
      * (window_size > 0)
@@ -1584,6 +1711,17 @@ void lm_init (TState &state, int pack_level, ush *flags)
 
     state.ds.strstart = 0;
     state.ds.block_start = 0L;
+    state.ds.match_available = 0;
+    state.ds.match_length = MIN_MATCH-1;
+    state.ds.starved = 0;
+    state.ds.partial = 0;
+    state.ds.opt_costs = 0, state.ds.opt_trees = 0;
+
+    /* When streaming, the window is filled as the data is pushed (see stream_refill) */
+    if (state.ds.streaming) {
+       state.ds.eofile = 0, state.ds.lookahead = 0;
+       return;
+    }
 
     j = WSIZE;
     j <<= 1; // Can read 64K in one step
@@ -1598,12 +1736,27 @@ void lm_init (TState &state, int pack_level, ush *flags)
      * if input comes from a device such as a tty.
      */
     if (state.ds.lookahead < MIN_LOOKAHEAD) fill_window(state);
+}
 
-    state.ds.ins_h = 0;
-    for (j=0; j<MIN_MATCH-1; j++) UPDATE_HASH(state.ds.ins_h, state.ds.window[j]);
-    /* If lookahead < MIN_MATCH, ins_h is garbage, but this is
-     * not important since only literal bytes will be emitted.
-     */
+
+/* ===========================================================================
+ * Take the first dictlen bytes of the input, which lm_init has read, as the
+ * dictionary: they're hashed but not compressed, so that the rest can refer
+ * to them. Used for the chunks of an item deflated in parallel.
+ */
+void lm_dict(TState &state, unsigned dictlen)
+{
+    IPos hash_head;
+    unsigned n;
+
+    Assert(state,!state.ds.streaming && dictlen <= WSIZE && dictlen <= state.ds.lookahead, "bad dictionary");
+    for (n = 0; n < dictlen && n + HASH_BYTES <= state.ds.lookahead; n++) {
+        INSERT_STRING(n, hash_head);
+    }
+    state.ds.strstart = dictlen;
+    state.ds.block_start = (long)dictlen;
+    state.ds.lookahead -= dictlen;
+    if (state.ds.lookahead < MIN_LOOKAHEAD && !state.ds.eofile) fill_window(state);
 }
 
 
@@ -1630,15 +1783,9 @@ int longest_match(TState &state,IPos cur_match)
      * we prevent matches with the string of window index 0.
      */
 
-  // The code is optimized for HASH_BITS >= 8 and MAX_MATCH-2 multiple of 16.
-  // It is easy to get rid of this optimization if necessary.
-    Assert(state,HASH_BITS>=8 && MAX_MATCH==258,"Code too clever");
-
-
-
-    uch far *strend = state.ds.window + state.ds.strstart + MAX_MATCH;
-    uch scan_end1  = scan[best_len-1];
-    uch scan_end   = scan[best_len];
+    ush scan_start, scan_end;
+    memcpy(&scan_start, scan, 2);
+    memcpy(&scan_end, scan+best_len-1, 2);
 
     /* Do not waste too much time if we already have a good match: */
     if (state.ds.prev_length >= state.ds.good_match) {
@@ -1646,49 +1793,30 @@ int longest_match(TState &state,IPos cur_match)
     }
 
     Assert(state,state.ds.strstart <= state.ds.window_size-MIN_LOOKAHEAD, "insufficient lookahead");
+    Assert(state,scan + MAX_MATCH + WPAD <= state.ds.window + sizeof(state.ds.window), "wild scan");
 
     do {
+        ush m;
         Assert(state,cur_match < state.ds.strstart, "no future");
         match = state.ds.window + cur_match;
 
         /* Skip to next match if the match length cannot increase
-         * or if the match length is less than 2:
-         */
-        if (match[best_len]   != scan_end  ||
-            match[best_len-1] != scan_end1 ||
-            *match            != *scan     ||
-            *++match          != scan[1])      continue;
-
-        /* The check at best_len-1 can be removed because it will be made
-         * again later. (This heuristic is not always a win.)
-         * It is not necessary to compare scan[2] and match[2] since they
-         * are always equal when the other bytes match, given that
-         * the hash keys are equal and that HASH_BITS >= 8.
+         * or if the match length is less than 2. The hash is of HASH_BYTES
+         * bytes, but equal keys don't imply equal bytes, so nothing is
+         * assumed of the bytes in between: they are compared a word at a time.
          */
-        scan += 2, match++;
-
-        /* We check for insufficient lookahead only every 8th comparison;
-         * the 256th check will be made at strstart+258.
-         */
-        do {
-        } while (*++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 scan < strend);
-
-        Assert(state,scan <= state.ds.window+(unsigned)(state.ds.window_size-1), "wild scan");
-
-        len = MAX_MATCH - (int)(strend - scan);
-        scan = strend - MAX_MATCH;
+        memcpy(&m, match+best_len-1, 2);
+        if (m != scan_end) continue;
+        memcpy(&m, match, 2);
+        if (m != scan_start) continue;
 
+        len = (int)match_len(scan, match);
 
         if (len > best_len) {
             state.ds.match_start = cur_match;
             best_len = len;
             if (len >= state.ds.nice_match) break;
-            scan_end1  = scan[best_len-1];
-            scan_end   = scan[best_len];
+            memcpy(&scan_end, scan+best_len-1, 2);
         }
     } while ((cur_match = state.ds.prev[cur_match & WMASK]) > limit
              && --chain_length != 0);
@@ -1726,7 +1854,7 @@ int longest_match(TState &state,IPos cur_match)
  */
 void fill_window(TState &state)
 {
-    unsigned n, m;
+    unsigned n;
     unsigned more;    /* Amount of free space at the end of the window. */
 
     do {
@@ -1750,23 +1878,7 @@ void fill_window(TState &state)
             /* By the IN assertion, the window is not empty so we can't confuse
              * more == 0 with more == 64K on a 16 bit machine.
              */
-            memcpy((char*)state.ds.window, (char*)state.ds.window+WSIZE, (unsigned)WSIZE);
-            state.ds.match_start -= WSIZE;
-            state.ds.strstart    -= WSIZE; /* we now have strstart >= MAX_DIST: */
-
-            state.ds.block_start -= (long) WSIZE;
-
-            for (n = 0; n < HASH_SIZE; n++) {
-                m = state.ds.head[n];
-                state.ds.head[n] = (Pos)(m >= WSIZE ? m-WSIZE : NIL);
-            }
-            for (n = 0; n < WSIZE; n++) {
-                m = state.ds.prev[n];
-                state.ds.prev[n] = (Pos)(m >= WSIZE ? m-WSIZE : NIL);
-                /* If n is not on any hash chain, prev[n] is garbage but
-                 * its value will never be used.
-                 */
-            }
+            slide_window(state);
             more += WSIZE;
         }
         if (state.ds.eofile) return;
@@ -1787,11 +1899,55 @@ void fill_window(TState &state)
         n = state.readfunc(state, (char*)state.ds.window+state.ds.strstart+state.ds.lookahead, more);
 
         if (n == 0 || n == (unsigned)EOF) {
-            state.ds.eofile = 1;
+            if (state.ds.streaming && !state.ds.finishing) state.ds.starved = 1;
+            else state.ds.eofile = 1;
         } else {
             state.ds.lookahead += n;
         }
-    } while (state.ds.lookahead < MIN_LOOKAHEAD && !state.ds.eofile);
+    } while (state.ds.lookahead < MIN_LOOKAHEAD && !state.ds.eofile && !state.ds.starved);
+}
+
+/* ===========================================================================
+ * Move the upper half of the window to the lower half to make room for new
+ * input, and update the hash chains accordingly.
+ * IN assertion: strstart >= WSIZE+MAX_DIST, so no useful match is lost.
+ */
+void slide_window(TState &state)
+{
+    unsigned n, m;
+
+    memcpy((char*)state.ds.window, (char*)state.ds.window+WSIZE, (unsigned)WSIZE);
+    state.ds.match_start -= WSIZE;
+    state.ds.strstart    -= WSIZE; /* we now have strstart >= MAX_DIST: */
+
+    state.ds.block_start -= (long) WSIZE;
+
+    for (n = 0; n < HASH_SIZE; n++) {
+        m = state.ds.head[n];
+        state.ds.head[n] = (Pos)(m >= WSIZE ? m-WSIZE : NIL);
+    }
+    for (n = 0; n < WSIZE; n++) {
+        m = state.ds.prev[n];
+        state.ds.prev[n] = (Pos)(m >= WSIZE ? m-WSIZE : NIL);
+        /* If n is not on any hash chain, prev[n] is garbage but
+         * its value will never be used.
+         */
+    }
+}
+
+/* ===========================================================================
+ * Streaming: pull the data pushed so far into the window. Returns false if
+ * there is not yet enough lookahead, in which case the deflater must return
+ * and wait for the next piece of input. Otherwise either lookahead >=
+ * MIN_LOOKAHEAD or the input is finished, exactly as in the pull mode, so
+ * the compressed output does not depend on how the input was split.
+ */
+int stream_refill(TState &state)
+{
+    state.ds.starved = 0;
+    if (state.ds.lookahead < MIN_LOOKAHEAD && !state.ds.eofile) fill_window(state);
+    if (state.ds.starved) return 0;
+    return 1;
 }
 
 /* ===========================================================================
@@ -1802,13 +1958,28 @@ void fill_window(TState &state)
    flush_block(state,state.ds.block_start >= 0L ? (char*)&state.ds.window[(unsigned)state.ds.block_start] : \
                 (char*)NULL, (long)state.ds.strstart - state.ds.block_start, (eof))
 
+/* ===========================================================================
+ * Flush the last block of the input. It's the final block of the deflate
+ * data, unless the input is a partial chunk: then it's followed by an empty
+ * stored block instead, which ends the output on a byte boundary (a sync
+ * flush), so that the output of the next chunk can just be appended.
+ */
+uzoff_t flush_last(TState &state)
+{
+    if (!state.ds.partial) return FLUSH_BLOCK(state,1);
+    FLUSH_BLOCK(state,0);
+    send_bits(state,STORED_BLOCK<<1,3);
+    copy_block(state,(char*)NULL,0,1); /* with header, and flushed */
+    return state.ts.cmpr_bytelen;
+}
+
 /* ===========================================================================
  * Processes a new input file and return its compressed length. This
  * function does not perform lazy evaluation of matches and inserts
  * new strings in the dictionary only for unmatched strings or for short
  * matches. It is used only for the fast compression options.
  */
-ulg deflate_fast(TState &state)
+uzoff_t deflate_fast(TState &state)
 {
     IPos hash_head = NIL;       /* head of the hash chain */
     int flush;                  /* set if current block must be flushed */
@@ -1819,7 +1990,7 @@ ulg deflate_fast(TState &state)
         /* Insert the string window[strstart .. strstart+2] in the
          * dictionary, and set hash_head to the head of the hash chain:
          */
-        if (state.ds.lookahead >= MIN_MATCH)
+        if (state.ds.lookahead >= HASH_BYTES)
         INSERT_STRING(state.ds.strstart, hash_head);
 
         /* Find the longest match, discarding those <= prev_length.
@@ -1849,7 +2020,7 @@ ulg deflate_fast(TState &state)
              * is not too large. This saves time but degrades compression.
              */
             if (match_length <= state.ds.max_insert_length
-                && state.ds.lookahead >= MIN_MATCH) {
+                && state.ds.lookahead >= HASH_BYTES-1) {
                 match_length--; /* string at strstart already in hash table */
                 do {
                     state.ds.strstart++;
@@ -1862,9 +2033,6 @@ ulg deflate_fast(TState &state)
             } else {
                 state.ds.strstart += match_length;
                 match_length = 0;
-                state.ds.ins_h = state.ds.window[state.ds.strstart];
-                UPDATE_HASH(state.ds.ins_h, state.ds.window[state.ds.strstart+1]);
-                Assert(state,MIN_MATCH==3,"Call UPDATE_HASH() MIN_MATCH-3 more times");
             }
         } else {
             /* No match, output a literal byte */
@@ -1880,8 +2048,9 @@ ulg deflate_fast(TState &state)
          * string following the next match.
          */
         if (state.ds.lookahead < MIN_LOOKAHEAD) fill_window(state);
+        if (state.ds.starved) return 0; /* streaming: wait for more input */
     }
-    return FLUSH_BLOCK(state,1); /* eof */
+    return flush_last(state); /* eof */
 }
 
 /* ===========================================================================
@@ -1889,22 +2058,24 @@ ulg deflate_fast(TState &state)
  * evaluation for matches: a match is finally adopted only if there is
  * no better match at the next window position.
  */
-ulg deflate(TState &state)
+uzoff_t deflate(TState &state)
 {
     IPos hash_head = NIL;       /* head of hash chain */
     IPos prev_match;            /* previous match */
     int flush;                  /* set if current block must be flushed */
-    int match_available = 0;    /* set if previous match exists */
-    unsigned match_length = MIN_MATCH-1; /* length of best match */
+    int match_available = state.ds.match_available; /* set if previous match exists */
+    unsigned match_length = state.ds.match_length;  /* length of best match */
 
+    if (state.ds.streaming && !stream_refill(state)) return 0;
     if (state.level <= 3) return deflate_fast(state); /* optimized for speed */
+    if (state.level >= 9) return deflate_opt(state);  /* optimized for size */
 
     /* Process the input block. */
     while (state.ds.lookahead != 0) {
         /* Insert the string window[strstart .. strstart+2] in the
          * dictionary, and set hash_head to the head of the hash chain:
          */
-        if (state.ds.lookahead >= MIN_MATCH)
+        if (state.ds.lookahead >= HASH_BYTES)
         INSERT_STRING(state.ds.strstart, hash_head);
 
         /* Find the longest match, discarding those <= prev_length.
@@ -1938,7 +2109,7 @@ ulg deflate(TState &state)
          * match is not better, output the previous match:
          */
         if (state.ds.prev_length >= MIN_MATCH && match_length <= state.ds.prev_length) {
-            unsigned max_insert = state.ds.strstart + state.ds.lookahead - MIN_MATCH;
+            unsigned max_insert = state.ds.strstart + state.ds.lookahead - HASH_BYTES;
             check_match(state,state.ds.strstart-1, prev_match, state.ds.prev_length);
             flush = ct_tally(state,state.ds.strstart-1-prev_match, state.ds.prev_length - MIN_MATCH);
 
@@ -1987,10 +2158,166 @@ ulg deflate(TState &state)
          * string following the next match.
          */
         if (state.ds.lookahead < MIN_LOOKAHEAD) fill_window(state);
+        if (state.ds.starved) {
+            /* streaming: keep the lazy match state and wait for more input */
+            state.ds.match_available = match_available;
+            state.ds.match_length = match_length;
+            return 0;
+        }
     }
     if (match_available) ct_tally (state,0, state.ds.window[state.ds.strstart-1]);
 
-    return FLUSH_BLOCK(state,1); /* eof */
+    return flush_last(state); /* eof */
+}
+
+/* ===========================================================================
+ * Read until there are need bytes of lookahead or the input ends. Returns
+ * false if the streamed input is exhausted.
+ * IN assertion: strstart+need <= window_size
+ */
+int opt_fill(TState &state, unsigned need)
+{
+    while (state.ds.lookahead < need && !state.ds.eofile) {
+        unsigned more = (unsigned)(state.ds.window_size - (ulg)state.ds.lookahead - (ulg)state.ds.strstart);
+        unsigned n = state.readfunc(state, (char*)state.ds.window+state.ds.strstart+state.ds.lookahead, more);
+        if (n == 0 || n == (unsigned)EOF) {
+            if (state.ds.streaming && !state.ds.finishing) {state.ds.starved = 1; return 0;}
+            state.ds.eofile = 1;
+        } else {
+            state.ds.lookahead += n;
+        }
+    }
+    return 1;
+}
+
+/* ===========================================================================
+ * Bit costs of the symbols for deflate_opt(): the code lengths of the last
+ * block, which are still in the dynamic trees, or rough guesses for the first
+ * block and for the symbols the last block didn't use.
+ */
+void opt_setcosts(TState &state)
+{
+    int n, code;
+    const ct_data *lt = state.ts.dyn_ltree, *dt = state.ts.dyn_dtree;
+    int trees = state.ds.opt_trees;
+
+    for (n = 0; n < LITERALS; n++) {
+        state.ds.opt_litcost[n] = !trees ? 8 : lt[n].dl.len ? lt[n].dl.len : 12;
+    }
+    for (n = MIN_MATCH; n <= MAX_MATCH; n++) {
+        code = state.ts.length_code[n-MIN_MATCH];
+        state.ds.opt_lencost[n] = extra_lbits[code] + (!trees ? 7 : lt[code+LITERALS+1].dl.len ? lt[code+LITERALS+1].dl.len : 10);
+    }
+    for (code = 0; code < D_CODES; code++) {
+        state.ds.opt_distcost[code] = extra_dbits[code] + (!trees ? 5 : dt[code].dl.len ? dt[code].dl.len : 8);
+    }
+    state.ds.opt_costs = 1;
+}
+
+/* ===========================================================================
+ * Same as deflate(), but the matches are chosen by the cost of the whole
+ * chunk instead of greedily: all the matches of increasing lengths at each
+ * position are collected, then the cheapest path through the chunk is found
+ * backwards, so that a long match may start with a literal, or a match may
+ * be shortened in favor of a longer next one.
+ */
+uzoff_t deflate_opt(TState &state)
+{
+    IPos hash_head;             /* head of hash chain */
+    int flush;                  /* set if current block must be flushed */
+
+    for (;;) {
+        unsigned s, e, end, p, i, n, len, best, skip;
+
+        /* The chunk and the MAX_MATCH bytes beyond must be in the window */
+        if (state.ds.sliding && state.ds.strstart >= WSIZE+MAX_DIST) slide_window(state);
+        s = state.ds.strstart;
+        e = (s | (OPT_CHUNK-1)) + 1;
+        if (e > state.ds.window_size-MIN_LOOKAHEAD) e = (unsigned)state.ds.window_size-MIN_LOOKAHEAD;
+        if (!opt_fill(state, e-s+MIN_LOOKAHEAD)) return 0; /* streaming: wait for more input */
+        if (state.ds.lookahead == 0) break;
+        end = s+state.ds.lookahead;
+        if (e > end) e = end;
+
+        if (state.ts.last_lit + (e-s) >= LIT_BUFSIZE-1) {
+            FLUSH_BLOCK(state,0), state.ds.block_start = state.ds.strstart;
+            state.ds.opt_costs = 0, state.ds.opt_trees = 1;
+        }
+        if (!state.ds.opt_costs) opt_setcosts(state);
+
+        /* Collect the matches, inserting all the strings of the chunk */
+        for (p = s, skip = 0; p < e; p++) {
+            uch *nm = state.ds.opt_nmatch + (p-s);
+            ush *ml = state.ds.opt_len + (p-s)*OPT_MATCHES, *md = state.ds.opt_dist + (p-s)*OPT_MATCHES;
+            unsigned chain = OPT_CHAIN, maxlen = e-p;
+            IPos limit = p > (IPos)MAX_DIST ? p - (IPos)MAX_DIST : NIL;
+            const uch *scan = state.ds.window + p;
+            ush scan_end;
+
+            *nm = 0;
+            if (p+HASH_BYTES > end) continue;
+            INSERT_STRING(p, hash_head);
+            if (skip) {skip--; continue;}
+            if (maxlen > MAX_MATCH) maxlen = MAX_MATCH;
+            if (maxlen < MIN_MATCH) continue;
+            best = MIN_MATCH-1;
+            memcpy(&scan_end, scan+best-1, 2);
+            for (; hash_head > limit && chain != 0; hash_head = state.ds.prev[hash_head & WMASK], chain--) {
+                const uch *match = state.ds.window + hash_head;
+                ush m;
+                memcpy(&m, match+best-1, 2);
+                if (m != scan_end) continue;
+                len = match_len(scan, match);
+                if (len <= best) continue;
+                if (len > maxlen) len = maxlen;
+                n = *nm < OPT_MATCHES ? (*nm)++ : OPT_MATCHES-1;
+                ml[n] = (ush)len, md[n] = (ush)(p-hash_head);
+                best = len;
+                if (len >= OPT_NICE || len == maxlen) break;
+                memcpy(&scan_end, scan+best-1, 2);
+            }
+            if (best >= OPT_NICE) skip = best-1;
+        }
+
+        /* Find the cheapest parse from the end of the chunk backwards */
+        state.ds.opt_price[e-s] = 0;
+        for (p = e; p-- > s; ) {
+            unsigned k = p-s, shorter = MIN_MATCH-1;
+            ulg price = state.ds.opt_litcost[state.ds.window[p]] + state.ds.opt_price[k+1];
+            ush choice = 1, choicedist = 0;
+            for (i = 0; i < state.ds.opt_nmatch[k]; i++) {
+                unsigned d = state.ds.opt_dist[k*OPT_MATCHES+i];
+                ulg dcost = state.ds.opt_distcost[d_code(d-1)];
+                len = state.ds.opt_len[k*OPT_MATCHES+i];
+                for (n = shorter+1; n <= len; n++) {
+                    ulg c = state.ds.opt_lencost[n] + dcost + state.ds.opt_price[k+n];
+                    if (c < price) price = c, choice = (ush)n, choicedist = (ush)d;
+                }
+                shorter = len;
+            }
+            state.ds.opt_price[k] = price;
+            state.ds.opt_choice[k] = choice, state.ds.opt_choicedist[k] = choicedist;
+        }
+
+        /* Send it */
+        while (state.ds.strstart < e) {
+            unsigned k = state.ds.strstart-s;
+            len = state.ds.opt_choice[k];
+            if (len >= MIN_MATCH) {
+                check_match(state,state.ds.strstart, state.ds.strstart-state.ds.opt_choicedist[k], len);
+                flush = ct_tally(state,state.ds.opt_choicedist[k], len - MIN_MATCH);
+            } else {
+                flush = ct_tally (state,0, state.ds.window[state.ds.strstart]);
+            }
+            state.ds.strstart += len;
+            state.ds.lookahead -= len;
+            if (flush) {
+                FLUSH_BLOCK(state,0), state.ds.block_start = state.ds.strstart;
+                state.ds.opt_costs = 0, state.ds.opt_trees = 1;
+            }
+        }
+    }
+    return flush_last(state); /* eof */
 }
 
 
@@ -2006,14 +2333,20 @@ ulg deflate(TState &state)
 
 int putlocal(struct zlist far *z, WRITEFUNC wfunc,void *param)
 { // Write a local header described by *z to file *f.  Return a ZE_ error code.
+  // With the Zip64 extra field (the last one in z->extra) the sizes go into it.
+  if (z->zip64)
+  { char *x = z->extra + z->ext - EB_L_ZIP64_SIZE;
+    x[0]=(char)EF_ZIP64; x[1]=0; x[2]=(char)(EB_L_ZIP64_SIZE-EB_HEADSIZE); x[3]=0;
+    for (int i=0; i<8; i++) {x[EB_HEADSIZE+i]=(char)(z->len>>(8*i)); x[EB_HEADSIZE+8+i]=(char)(z->siz>>(8*i));}
+  }
   PUTLG(LOCSIG, f);
   PUTSH(z->ver, f);
   PUTSH(z->lflg, f);
   PUTSH(z->how, f);
   PUTLG(z->tim, f);
   PUTLG(z->crc, f);
-  PUTLG(z->siz, f);
-  PUTLG(z->len, f);
+  PUTLG(z->zip64 ? ZIP64_LIMIT : (ulg)z->siz, f);
+  PUTLG(z->zip64 ? ZIP64_LIMIT : (ulg)z->len, f);
   PUTSH(z->nam, f);
   PUTSH(z->ext, f);
   size_t res = (size_t)wfunc(param, z->iname, (unsigned int)z->nam);
@@ -2025,50 +2358,100 @@ int putlocal(struct zlist far *z, WRITEFUNC wfunc,void *param)
   return ZE_OK;
 }
 
+extent extendedsize(struct zlist far *z)
+{ // Length of the extended local header: the sizes are 8 bytes long for Zip64
+  if (z->zip64 || z->siz>=ZIP64_LIMIT || z->len>=ZIP64_LIMIT) return 24;
+  return 16;
+}
+
 int putextended(struct zlist far *z, WRITEFUNC wfunc, void *param)
 { // Write an extended local header described by *z to file *f. Returns a ZE_ code
   PUTLG(EXTLOCSIG, f);
   PUTLG(z->crc, f);
-  PUTLG(z->siz, f);
-  PUTLG(z->len, f);
+  if (extendedsize(z)==24)
+  { PUTLL(z->siz, f);
+    PUTLL(z->len, f);
+  }
+  else
+  { PUTLG((ulg)z->siz, f);
+    PUTLG((ulg)z->len, f);
+  }
   return ZE_OK;
 }
 
+extent zip64central(struct zlist far *z, char *x)
+{ // Fill the Zip64 extra field of the central header with the values which
+  // do not fit into 32 bits. Returns its length, 0 if it is not needed.
+  uzoff_t v[3]; int n=0;
+  if (z->len>=ZIP64_LIMIT) v[n++]=z->len;
+  if (z->siz>=ZIP64_LIMIT) v[n++]=z->siz;
+  if (z->off>=ZIP64_LIMIT) v[n++]=z->off;
+  if (n==0) return 0;
+  x[0]=(char)EF_ZIP64; x[1]=0; x[2]=(char)(8*n); x[3]=0;
+  for (int i=0; i<n; i++) for (int b=0; b<8; b++) x[EB_HEADSIZE+8*i+b]=(char)(v[i]>>(8*b));
+  return EB_HEADSIZE+8*n;
+}
+
 int putcentral(struct zlist far *z, WRITEFUNC wfunc, void *param)
 { // Write a central header entry of *z to file *f. Returns a ZE_ code.
+  char x64[EB_C_ZIP64_SIZE]; extent n64=zip64central(z,x64);
   PUTLG(CENSIG, f);
   PUTSH(z->vem, f);
-  PUTSH(z->ver, f);
+  PUTSH((n64!=0 && z->ver<45) ? 45 : z->ver, f);
   PUTSH(z->flg, f);
   PUTSH(z->how, f);
   PUTLG(z->tim, f);
   PUTLG(z->crc, f);
-  PUTLG(z->siz, f);
-  PUTLG(z->len, f);
+  PUTLG(z->siz>=ZIP64_LIMIT ? ZIP64_LIMIT : (ulg)z->siz, f);
+  PUTLG(z->len>=ZIP64_LIMIT ? ZIP64_LIMIT : (ulg)z->len, f);
   PUTSH(z->nam, f);
-  PUTSH(z->cext, f);
+  PUTSH(z->cext+n64, f);
   PUTSH(z->com, f);
   PUTSH(z->dsk, f);
   PUTSH(z->att, f);
   PUTLG(z->atx, f);
-  PUTLG(z->off, f);
+  PUTLG(z->off>=ZIP64_LIMIT ? ZIP64_LIMIT : (ulg)z->off, f);
   if ((size_t)wfunc(param, z->iname, (unsigned int)z->nam) != z->nam ||
       (z->cext && (size_t)wfunc(param, z->cextra, (unsigned int)z->cext) != z->cext) ||
+      (n64 && (size_t)wfunc(param, x64, (unsigned int)n64) != n64) ||
       (z->com && (size_t)wfunc(param, z->comment, (unsigned int)z->com) != z->com))
     return ZE_TEMP;
   return ZE_OK;
 }
 
 
-int putend(int n, ulg s, ulg c, extent m, char *z, WRITEFUNC wfunc, void *param)
+bool needzip64end(uzoff_t n, uzoff_t s, uzoff_t c)
+{ // the number of entries, the size or the offset of the central directory does not fit the end record
+  return n>=ZIP64_ENTRIES || s>=ZIP64_LIMIT || c>=ZIP64_LIMIT;
+}
+
+int putend(uzoff_t n, uzoff_t s, uzoff_t c, extent m, char *z, WRITEFUNC wfunc, void *param)
 { // write the end of the central-directory-data to file *f.
+  // If needed, the Zip64 end record and its locator go first; they follow the
+  // central directory, so the Zip64 end record is at offset c+s.
+  if (needzip64end(n,s,c))
+  { PUTLG(ZIP64ENDSIG, f);
+    PUTLL(ZIP64ENDHEAD-8, f);
+    PUTSH(45, f);
+    PUTSH(45, f);
+    PUTLG(0, f);
+    PUTLG(0, f);
+    PUTLL(n, f);
+    PUTLL(n, f);
+    PUTLL(s, f);
+    PUTLL(c, f);
+    PUTLG(ZIP64LOCSIG, f);
+    PUTLG(0, f);
+    PUTLL(c+s, f);
+    PUTLG(1, f);
+  }
   PUTLG(ENDSIG, f);
   PUTSH(0, f);
   PUTSH(0, f);
-  PUTSH(n, f);
-  PUTSH(n, f);
-  PUTLG(s, f);
-  PUTLG(c, f);
+  PUTSH(n>=ZIP64_ENTRIES ? ZIP64_ENTRIES : n, f);
+  PUTSH(n>=ZIP64_ENTRIES ? ZIP64_ENTRIES : n, f);
+  PUTLG(s>=ZIP64_LIMIT ? ZIP64_LIMIT : (ulg)s, f);
+  PUTLG(c>=ZIP64_LIMIT ? ZIP64_LIMIT : (ulg)c, f);
   PUTSH(m, f);
   // Write the comment, if any
   if (m && wfunc(param, z, (unsigned int)m) != m) return ZE_TEMP;
@@ -2136,17 +2519,135 @@ const ulg crc_table[256] = {
 };
 
 #define CRC32(c, b) (crc_table[((int)(c) ^ (b)) & 0xff] ^ ((c) >> 8))
-#define DO1(buf)  crc = CRC32(crc, *buf++)
-#define DO2(buf)  DO1(buf); DO1(buf)
-#define DO4(buf)  DO2(buf); DO2(buf)
-#define DO8(buf)  DO4(buf); DO4(buf)
+
+// Slicing-by-8/16: crc_slices()[k][n] is the crc of the byte n followed by k zero bytes,
+// so 8 or 16 bytes are folded at once by independent lookups instead of a chain of
+// dependent ones. The words are assembled bytewise, which works on any byte order.
+typedef struct TCrcSlices
+{ ulg t[16][256];
+  TCrcSlices()
+  { for (int n=0; n<256; n++) t[0][n]=crc_table[n];
+    for (int k=1; k<16; k++) for (int n=0; n<256; n++) t[k][n] = CRC32(t[k-1][n],0);
+  }
+} TCrcSlices;
+static const ulg (*crc_slices())[256]
+{ static const TCrcSlices slices; // built by the first call (thread-safe)
+  return slices.t;
+}
+
+#define CRCWORD(b) ((ulg)(b)[0] | ((ulg)(b)[1]<<8) | ((ulg)(b)[2]<<16) | ((ulg)(b)[3]<<24))
+
+// These take and return the crc inverted, as it is while being computed
+static ulg crc32_slice8(ulg crc, const uch *buf, extent len)
+{ const ulg (*t)[256] = crc_slices();
+  while (len >= 8)
+  { ulg a = crc ^ CRCWORD(buf), b = CRCWORD(buf+4);
+    crc = t[7][a&0xff] ^ t[6][(a>>8)&0xff] ^ t[5][(a>>16)&0xff] ^ t[4][a>>24] ^
+          t[3][b&0xff] ^ t[2][(b>>8)&0xff] ^ t[1][(b>>16)&0xff] ^ t[0][b>>24];
+    buf += 8; len -= 8;
+  }
+  while (len--) crc = (crc>>8) ^ t[0][(crc^*buf++)&0xff];
+  return crc;
+}
+static ulg crc32_slice16(ulg crc, const uch *buf, extent len)
+{ const ulg (*t)[256] = crc_slices();
+  while (len >= 16)
+  { ulg a = crc ^ CRCWORD(buf), b = CRCWORD(buf+4), c = CRCWORD(buf+8), d = CRCWORD(buf+12);
+    crc = t[15][a&0xff] ^ t[14][(a>>8)&0xff] ^ t[13][(a>>16)&0xff] ^ t[12][a>>24] ^
+          t[11][b&0xff] ^ t[10][(b>>8)&0xff] ^ t[ 9][(b>>16)&0xff] ^ t[ 8][b>>24] ^
+          t[ 7][c&0xff] ^ t[ 6][(c>>8)&0xff] ^ t[ 5][(c>>16)&0xff] ^ t[ 4][c>>24] ^
+          t[ 3][d&0xff] ^ t[ 2][(d>>8)&0xff] ^ t[ 1][(d>>16)&0xff] ^ t[ 0][d>>24];
+    buf += 16; len -= 16;
+  }
+  return crc32_slice8(crc,buf,len);
+}
+
+#ifdef ZIP_CRC_PCLMUL
+// Folding with carry-less multiplication, from "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction" (Gopal et al., Intel 2009), with the
+// bit-reflected constants of its appendix. 64 bytes are folded per step into four
+// 128-bit lanes, which are then folded into one and Barrett-reduced to 32 bits.
+#ifdef __GNUC__
+__attribute__((target("pclmul,sse2")))
+#endif
+static ulg crc32_fold(ulg crc, const uch *buf, extent len) // len>=64, multiple of 16
+{ // k1 0x154442bd4, k2 0x1c6e41596, k3 0x1751997d0, k4 0xccaa009e, k5 0x163cd6124, P' 0x1f7011641, P 0x1db710641
+  const __m128i k1k2 = _mm_setr_epi32((int)0x54442bd4, 1, (int)0xc6e41596, 1);
+  const __m128i k3k4 = _mm_setr_epi32((int)0x751997d0, 1, (int)0xccaa009e, 0);
+  const __m128i k5   = _mm_setr_epi32((int)0x63cd6124, 1, 0, 0);
+  const __m128i poly = _mm_setr_epi32((int)0xdb710641, 1, (int)0xf7011641, 1);
+  const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+  __m128i x1 = _mm_loadu_si128((const __m128i*)(buf+0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i*)(buf+0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i*)(buf+0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i*)(buf+0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  buf += 64; len -= 64;
+  for (; len >= 64; buf += 64, len -= 64)
+  { __m128i y1 = _mm_clmulepi64_si128(x1, k1k2, 0x00), y2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    __m128i y3 = _mm_clmulepi64_si128(x3, k1k2, 0x00), y4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11); x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11); x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, y1), _mm_loadu_si128((const __m128i*)(buf+0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, y2), _mm_loadu_si128((const __m128i*)(buf+0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, y3), _mm_loadu_si128((const __m128i*)(buf+0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, y4), _mm_loadu_si128((const __m128i*)(buf+0x30)));
+  }
+  // fold the four lanes into one, then the remaining 16-byte blocks into it
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x2);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x3);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x4);
+  for (; len >= 16; buf += 16, len -= 16)
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)),
+                       _mm_loadu_si128((const __m128i*)buf));
+  // 128 to 64 bits
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5, 0x00), x2);
+  // Barrett reduction to 32 bits
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+  x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return (ulg)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+static ulg crc32_pclmul(ulg crc, const uch *buf, extent len)
+{ if (len >= 64)
+  { extent n = len & ~(extent)15;
+    crc = crc32_fold(crc,buf,n);
+    buf += n; len -= n;
+  }
+  return crc32_slice16(crc,buf,len);
+}
+
+static bool has_pclmul()
+{
+#ifdef _MSC_VER
+  int info[4]; __cpuid(info,1);
+  return (info[2] & (1<<1)) != 0;
+#else
+  unsigned int a,b,c,d;
+  if (!__get_cpuid(1,&a,&b,&c,&d)) return false;
+  return (c & bit_PCLMUL) != 0;
+#endif
+}
+#endif  // ZIP_CRC_PCLMUL
+
+typedef ulg (*TCrc32)(ulg crc, const uch *buf, extent len);
+static TCrc32 crc32_select()
+{
+#ifdef ZIP_CRC_PCLMUL
+  if (has_pclmul()) return crc32_pclmul;
+#endif
+  // 16 lookups at once need more registers than 32-bit x86 has
+  return sizeof(void*)>=8 ? crc32_slice16 : crc32_slice8;
+}
 
 ulg crc32(ulg crc, const uch *buf, extent len)
 { if (buf==NULL) return 0L;
-  crc = crc ^ 0xffffffffL;
-  while (len >= 8) {DO8(buf); len -= 8;}
-  if (len) do {DO1(buf);} while (--len);
-  return crc ^ 0xffffffffL;  // (instead of ~c for 64-bit machines)
+  static const TCrc32 impl = crc32_select();
+  return impl(crc ^ 0xffffffffL, buf, len) ^ 0xffffffffL;  // (instead of ~c for 64-bit machines)
 }
 
 
@@ -2207,7 +2708,7 @@ void filetime2dosdatetime(const FILETIME ft, WORD *dosdate,WORD *dostime)
 #endif
 
 
-ZRESULT GetFileInfo(HANDLE hf, ulg *attr, long *size, iztimes *times, ulg *timestamp)
+ZRESULT GetFileInfo(HANDLE hf, ulg *attr, zoff_t *size, iztimes *times, ulg *timestamp)
 { // The handle must be a handle to a file
   // The date and time is returned in a long with the date most significant to allow
   // unsigned integer comparison of absolute times. The attributes have two
@@ -2230,7 +2731,7 @@ ZRESULT GetFileInfo(HANDLE hf, ulg *attr, long *size, iztimes *times, ulg *times
   a|=0x01000000;      // readable
   if (fa&FILE_ATTRIBUTE_READONLY) {} else a|=0x00800000; // writeable
   // now just a small heuristic to check if it's an executable:
-  DWORD red, hsize=GetFileSize(hf,NULL); if (hsize>40)
+  DWORD red, hsizehigh=0, hsize=GetFileSize(hf,&hsizehigh); if (hsize>40)
   { SetFilePointer(hf,0,NULL,FILE_BEGIN); unsigned short magic; ReadFile(hf,&magic,sizeof(magic),&red,NULL);
     SetFilePointer(hf,36,NULL,FILE_BEGIN); unsigned long hpos;  ReadFile(hf,&hpos,sizeof(hpos),&red,NULL);
     if (magic==0x54AD && hsize>hpos+4+20+28)
@@ -2243,7 +2744,7 @@ ZRESULT GetFileInfo(HANDLE hf, ulg *attr, long *size, iztimes *times, ulg *times
   }
   //
   if (attr!=NULL) *attr = a;
-  if (size!=NULL) *size = hsize;
+  if (size!=NULL) *size = ((zoff_t)hsizehigh<<32) | hsize;
   if (times!=NULL)
   { // lutime_t is 32bit number of seconds elapsed since 0:0:0GMT, Jan1, 1970.
     // but FILETIME is 64bit number of 100-nanosecs since Jan1, 1601
@@ -2304,16 +2805,251 @@ ZRESULT GetFileInfo(HANDLE hf, ulg *attr, long *size, iztimes *times, ulg *times
 
 
 
+// The deflate of this file as a TZipCodec (ZIP_CODEC_BUILTIN). The pieces are
+// pushed in the streaming mode of deflate(), which pulls them through sread and
+// returns once it has consumed each, so the output doesn't depend on how the
+// content of an item was split.
+class TDeflateCodec : public TZipCodec
+{ public:
+  TDeflateCodec() : state(0), in(0), inlen(0) {}
+  ~TDeflateCodec() {if (state!=0) delete state; state=0;}
+  bool Begin(int level, ZIPCODECOUT out, void *param);
+  bool Write(const char *buf, unsigned int len, bool last);
+
+  TState *state;            // allocated by the first Begin. It's a very big object! 500k!
+  ZIPCODECOUT out; void *outparam; bool outfailed;
+  const char *in; unsigned int inlen; // the piece being compressed
+  ush att, flg;             // what ct_init and lm_init tell about the item, unused
+  char obuf[16384];         // the output bit buffer
+  static unsigned sread(TState &s,char *buf,unsigned size);
+  static unsigned sflush(void *param,const char *buf, unsigned *size);
+};
+
+bool TDeflateCodec::Begin(int level, ZIPCODECOUT o, void *param)
+{ if (level<1 || level>9) return false;
+  if (state==0) state=new TState();
+  out=o; outparam=param; outfailed=false; in=0; inlen=0;
+  state->readfunc=sread; state->flush_outbuf=sflush;
+  state->param=this; state->level=level; state->seekable=false; state->err=NULL;
+  // the following line will make ct_init realise it has to perform the init
+  state->ts.static_dtree[0].dl.len = 0;
+  // Thanks to Alvin77 for this crucial fix:
+  state->ds.window_size=0;
+  state->ds.streaming=1; state->ds.finishing=0;
+  att=(ush)BINARY; flg=0;
+  bi_init(*state,obuf,sizeof(obuf),TRUE);
+  ct_init(*state,&att);
+  lm_init(*state,level,&flg);
+  return state->err==NULL;
+}
+
+bool TDeflateCodec::Write(const char *buf, unsigned int len, bool last)
+{ if (state==0) return false;
+  in=buf; inlen=len;
+  if (last) state->ds.finishing=1;
+  deflate(*state);
+  in=0; inlen=0;
+  return state->err==NULL && !outfailed;
+}
+
+unsigned TDeflateCodec::sread(TState &s,char *buf,unsigned size)
+{ // static
+  TDeflateCodec *c = (TDeflateCodec*)s.param;
+  unsigned int red = c->inlen; if (red>size) red=size;
+  if (red>0) memcpy(buf, c->in, red);
+  c->in += red; c->inlen -= red;
+  return red;
+}
+
+unsigned TDeflateCodec::sflush(void *param,const char *buf, unsigned *size)
+{ // static
+  if (*size==0) return 0;
+  TDeflateCodec *c = (TDeflateCodec*)param;
+  unsigned int writ = *size;
+  if (!c->outfailed && !c->out(c->outparam,buf,writ)) c->outfailed=true;
+  *size=0;
+  return writ;
+}
+
+TZipCodec *NewBuiltinZipCodec()
+{ return new TDeflateCodec();
+}
+
+
+
+// The deflate of this file on several threads (see ZipSetThreads). The content
+// is cut into chunks of ZIP_PARALLEL_CHUNK bytes, which the workers deflate
+// each in its own state, primed with the last WSIZE bytes of the previous chunk
+// (lm_dict), and ended with a sync flush (flush_last) except for the last one.
+// The outputs are passed on in order by the thread that calls Write. At most
+// two chunks per worker are in flight, so the memory used is bounded.
+typedef struct
+{ std::vector<char> in;     // the dictionary, then the chunk
+  unsigned int dictlen, pos; bool last;
+  std::vector<char> out;
+  bool done, failed;
+} TParallelJob;
+
+class TParallelDeflateCodec : public TZipCodec
+{ public:
+  TParallelDeflateCodec(unsigned int threads);
+  ~TParallelDeflateCodec();
+  bool Begin(int level, ZIPCODECOUT out, void *param);
+  bool Write(const char *buf, unsigned int len, bool last);
+
+  int level; ZIPCODECOUT out; void *outparam; bool failed;
+  std::vector<char> cur; unsigned int curdict; // the chunk being gathered, after its dictionary
+  std::deque<TParallelJob*> queue, inflight;   // the chunks waiting for a worker, and all in order
+  std::vector<std::thread> workers;
+  std::mutex mutex; std::condition_variable work, done;
+  bool stop;
+
+  bool submit(bool last);
+  bool emit(bool all);
+  void run();
+  static unsigned jobread(TState &s,char *buf,unsigned size);
+  static unsigned jobflush(void *param,const char *buf, unsigned *size);
+};
+
+TParallelDeflateCodec::TParallelDeflateCodec(unsigned int threads) : level(0), failed(false), curdict(0), stop(false)
+{ for (unsigned int i=0; i<threads; i++) workers.push_back(std::thread(&TParallelDeflateCodec::run,this));
+}
+
+TParallelDeflateCodec::~TParallelDeflateCodec()
+{ failed=true; emit(true); // what's left of an unfinished item is dropped
+  { std::lock_guard<std::mutex> lock(mutex); stop=true;}
+  work.notify_all();
+  for (size_t i=0; i<workers.size(); i++) workers[i].join();
+}
+
+bool TParallelDeflateCodec::Begin(int l, ZIPCODECOUT o, void *param)
+{ if (l<1 || l>9) return false;
+  failed=true; emit(true); // what's left of an unfinished item is dropped
+  level=l; out=o; outparam=param; failed=false;
+  cur.clear(); curdict=0;
+  return true;
+}
+
+bool TParallelDeflateCodec::Write(const char *buf, unsigned int len, bool last)
+{ while (len>0 && !failed)
+  { // a full chunk waits for more input, so that the last one is known when it's submitted
+    if (cur.size()-curdict==ZIP_PARALLEL_CHUNK && !submit(false)) break;
+    unsigned int n = ZIP_PARALLEL_CHUNK-(unsigned int)(cur.size()-curdict); if (n>len) n=len;
+    cur.insert(cur.end(),buf,buf+n);
+    buf+=n; len-=n;
+  }
+  if (last && !failed && submit(true)) emit(true);
+  return !failed;
+}
+
+bool TParallelDeflateCodec::submit(bool last)
+{ TParallelJob *job = new TParallelJob;
+  job->in.swap(cur); job->dictlen=curdict; job->pos=0; job->last=last;
+  job->done=false; job->failed=false;
+  curdict=0;
+  if (!last)
+  { unsigned int d = (unsigned int)(job->in.size()-job->dictlen); if (d>WSIZE) d=WSIZE;
+    cur.assign(job->in.end()-d,job->in.end()); cur.reserve(d+ZIP_PARALLEL_CHUNK); curdict=d;
+  }
+  { std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(job); inflight.push_back(job);
+  }
+  work.notify_one();
+  return emit(false);
+}
+
+bool TParallelDeflateCodec::emit(bool all)
+{ // passes on the outputs of the chunks done, in order; waits for the first one
+  // if all are wanted, or if too many are in flight
+  for (;;)
+  { TParallelJob *job;
+    { std::unique_lock<std::mutex> lock(mutex);
+      if (inflight.empty()) break;
+      job = inflight.front();
+      while (!job->done && (all || inflight.size()>2*workers.size())) done.wait(lock);
+      if (!job->done) break;
+      inflight.pop_front();
+    }
+    if (job->failed) failed=true;
+    if (!failed && !job->out.empty() && !out(outparam,&job->out[0],(unsigned int)job->out.size())) failed=true;
+    delete job;
+  }
+  return !failed;
+}
+
+void TParallelDeflateCodec::run()
+{ TState *state = 0; // allocated for the first chunk, it's big
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;)
+  { while (queue.empty() && !stop) work.wait(lock);
+    if (queue.empty()) break;
+    TParallelJob *job = queue.front(); queue.pop_front();
+    int l = level;
+    lock.unlock();
+
+    if (state==0) state=new TState();
+    char obuf[16384]; ush att=(ush)BINARY, flg=0;
+    bool ok = true;
+    // deflate_opt guesses the costs of the first block, which here is most of the chunk:
+    // the chunk is parsed once more with the costs of the trees the first pass ended with
+    for (int pass = l>=9 ? 0 : 1; pass<2 && ok; pass++)
+    { state->readfunc=jobread; state->flush_outbuf=jobflush;
+      state->param=job; state->level=l; state->seekable=false; state->err=NULL;
+      state->ts.static_dtree[0].dl.len = 0;
+      state->ds.window_size=0;
+      state->ds.streaming=0; state->ds.finishing=0;
+      job->pos=0; job->out.clear();
+      bi_init(*state,obuf,sizeof(obuf),TRUE);
+      ct_init(*state,&att);
+      lm_init(*state,l,&flg);
+      lm_dict(*state,job->dictlen);
+      state->ds.partial = !job->last;
+      if (pass==1 && l>=9) state->ds.opt_trees=1;
+      deflate(*state);
+      ok = (state->err==NULL);
+    }
+
+    lock.lock();
+    job->done=true; job->failed=!ok;
+    done.notify_all();
+  }
+  lock.unlock();
+  if (state!=0) delete state;
+}
+
+unsigned TParallelDeflateCodec::jobread(TState &s,char *buf,unsigned size)
+{ // static
+  TParallelJob *job = (TParallelJob*)s.param;
+  unsigned int red = (unsigned int)job->in.size()-job->pos; if (red>size) red=size;
+  if (red>0) memcpy(buf,&job->in[job->pos],red);
+  job->pos += red;
+  return red;
+}
 
+unsigned TParallelDeflateCodec::jobflush(void *param,const char *buf, unsigned *size)
+{ // static
+  unsigned int writ = *size;
+  if (writ==0) return 0;
+  TParallelJob *job = (TParallelJob*)param;
+  job->out.insert(job->out.end(),buf,buf+writ);
+  *size=0;
+  return writ;
+}
 
 
 
 
+typedef struct
+{ ZIPWRITEFUNC func;
+  void *param;
+} TZipWriter; // what CreateZipWriter passes to TZip::Create
+
+
 class TZip
 { public:
   //TZip(const char *pwd) : hfout(0),mustclosehfout(false),hmapout(0),zfis(0),obuf(0),hfin(0),writ(0),oerr(false),hasputcen(false),ooffset(0),encwriting(false),encbuf(0),password(0), state(0) {if (pwd!=0 && *pwd!=0) {password=new char[strlen(pwd)+1]; strcpy(password,pwd);}}
-    TZip(const char *pwd) : password(0),hfout(0),mustclosehfout(false),hmapout(0),ooffset(0),oerr(false),writ(0),obuf(0),hasputcen(false),encwriting(false),encbuf(0),zfis(0), state(0),hfin(0) {if (pwd!=0 && *pwd!=0) {password=new char[strlen(pwd)+1]; strcpy(password,pwd);}}
-  ~TZip() {if (state!=0) delete state; state=0; if (encbuf!=0) delete[] encbuf; encbuf=0; if (password!=0) delete[] password; password=0;}
+    TZip(const char *pwd) : password(0),hfout(0),mustclosehfout(false),hmapout(0),ooffset(0),oerr(false),writ(0),obuf(0),hasputcen(false),encwriting(false),encbuf(0),zfis(0), level(ZIP_LEVEL_DEFAULT),adaptrate(ZIP_ADAPTIVE_RATE),codec(0),codecid(ZIP_CODEC_DEFAULT),owncodec(false),threads(1),wfunc(0),wparam(0),wbuf(0),wlen(0),hfin(0),streaming(false) {if (pwd!=0 && *pwd!=0) {password=new char[strlen(pwd)+1]; strcpy(password,pwd);}}
+  ~TZip() {if (owncodec) delete codec; codec=0; if (wbuf!=0) delete[] wbuf; wbuf=0; if (encbuf!=0) delete[] encbuf; encbuf=0; if (password!=0) delete[] password; password=0;}
 
   // These variables say about the file we're writing into
   // We can write to pipe, file-by-handle, file-by-name, memory-to-memmapfile
@@ -2321,9 +3057,9 @@ class TZip
   HANDLE hfout;             // if valid, we'll write here (for files or pipes)
   bool mustclosehfout;      // if true, we are responsible for closing hfout
   HANDLE hmapout;           // otherwise, we'll write here (for memmap)
-  unsigned ooffset;         // for hfout, this is where the pointer was initially
+  uzoff_t ooffset;          // for hfout, this is where the pointer was initially
   ZRESULT oerr;             // did a write operation give rise to an error?
-  unsigned writ;            // how far have we written. This is maintained by Add, not write(), to avoid confusion over seeks
+  uzoff_t writ;             // how far have we written. This is maintained by Add, not write(), to avoid confusion over seeks
   bool ocanseek;            // can we seek?
   char *obuf;               // this is where we've locked mmap to view.
   unsigned int opos;        // current pos in the mmap
@@ -2335,13 +3071,20 @@ class TZip
   unsigned int encbufsize;  // (to be used and resized inside write(), and deleted in the destructor)
   //
   TZipFileInfo *zfis;       // each file gets added onto this list, for writing the table at the end
-  TState *state;            // we use just one state object per zip, because it's big (500k)
+  int level;                // level of the items added from now on: 0..9 or ZIP_LEVEL_ADAPTIVE
+  double adaptrate;         // output rate (bytes per second) ZIP_LEVEL_ADAPTIVE optimises for
+  TZipCodec *codec;         // the deflate engine, created for the first item that needs it (it's big)
+  int codecid; bool owncodec; // which engine that is (-1 for a custom one), and whether we delete it
+  unsigned int threads;     // of the built-in engine, see ZipSetThreads
+  ZIPWRITEFUNC wfunc; void *wparam; // if valid, we'll write through this function (never seeks)
+  char *wbuf; unsigned int wlen; // what's gathered for it, passed when full and when an item is finished
 
   ZRESULT Create(void *z,unsigned int len,DWORD flags);
-  static unsigned sflush(void *param,const char *buf, unsigned *size);
+  static bool scodecout(void *param,const char *buf, unsigned int len);
   static unsigned swrite(void *param,const char *buf, unsigned size);
   unsigned int write(const char *buf,unsigned int size);
-  bool oseek(unsigned int pos);
+  bool oseek(uzoff_t pos);
+  bool wflush();
   ZRESULT GetMemory(void **pbuf, unsigned long *plen);
   ZRESULT Close();
 
@@ -2349,12 +3092,12 @@ class TZip
   // I haven't done it object-orientedly here, just put them all
   // together, since OO didn't seem to make the design any clearer.
   ulg attr; iztimes times; ulg timestamp;  // all open_* methods set these
-  bool iseekable; long isize,ired;         // size is not set until close() on pips
+  bool iseekable; zoff_t isize,ired;       // size is not set until close() on pips
   ulg crc;                                 // crc is not set until close(). iwrit is cumulative
   HANDLE hfin; bool selfclosehf;           // for input files and pipes
   const char *bufin; unsigned int lenin,posin; // for memory
   // and a variable for what we've done with the input: (i.e. compressed it!)
-  ulg csize;                               // compressed size, set by the compression routines
+  uzoff_t csize;                           // compressed size, set by the compression routines
   // and this is used by some of the compression routines
   char buf[16384];
 
@@ -2363,14 +3106,32 @@ class TZip
   ZRESULT open_handle(HANDLE hf,unsigned int len);
   ZRESULT open_mem(void *src,unsigned int len);
   ZRESULT open_dir();
-  static unsigned sread(TState &s,char *buf,unsigned size);
   unsigned read(char *buf, unsigned size);
   ZRESULT iclose();
 
-  ZRESULT ideflate(TZipFileInfo *zfi);
+  ZRESULT usecodec();
+  ZRESULT ideflateinit(TZipFileInfo *zfi, int ilevel);
+  ZRESULT ideflate(TZipFileInfo *zfi, int ilevel);
   ZRESULT istore();
+  ZRESULT iraw(TZipFileInfo *zfi, int ilevel);
+  ulg rawcrc; uzoff_t rawsize; // the content of the ZIP_DEFLATED item being added
+  ZRESULT istoreblocks(const char *src, unsigned int len, bool last);
+  int samplelevel(const char *sample, unsigned int len);
+  int adaptivelevel();
+
+  // the item currently being streamed by StreamBegin/StreamWrite/StreamEnd
+  bool streaming; int slevel; // slevel is ZIP_LEVEL_ADAPTIVE until the first piece is sampled
+  TZipFileInfo szfi; char sxloc[EB_L_UT_SIZE+EB_L_ZIP64_SIZE], sxcen[EB_C_UT_SIZE];
+
+  void initfileinfo(TZipFileInfo &zfi, const char *dstzn, bool needs_trailing_slash, bool isdir, int method, int passex, char *xloc, char *xcen, bool zip64);
+  ZRESULT putheader(TZipFileInfo &zfi, bool isdir);
+  void keepfileinfo(TZipFileInfo &zfi);
 
   ZRESULT Add(const char *odstzn, void *src, unsigned int len, DWORD flags);
+  ZRESULT AddDeflated(const char *odstzn, void *src, unsigned int len, ulg crc, uzoff_t size);
+  ZRESULT StreamBegin(const char *odstzn);
+  ZRESULT StreamWrite(const void *src, unsigned int len);
+  ZRESULT StreamEnd();
   ZRESULT AddCentral();
 
 };
@@ -2379,7 +3140,7 @@ class TZip
 
 ZRESULT TZip::Create(void *z,unsigned int len,DWORD flags)
 {
-  if (hfout!=0 || hmapout!=0 || obuf!=0 || writ!=0 || oerr!=ZR_OK || hasputcen) return ZR_NOTINITED;
+  if (hfout!=0 || hmapout!=0 || obuf!=0 || wfunc!=0 || writ!=0 || oerr!=ZR_OK || hasputcen) return ZR_NOTINITED;
   //
   if (flags==ZIP_HANDLE)
   {
@@ -2394,14 +3155,14 @@ ZRESULT TZip::Create(void *z,unsigned int len,DWORD flags)
     // now we have hfout. Either we duplicated the handle and we close it ourselves
     // (while the caller closes h themselves), or we couldn't duplicate it.
 #ifdef _WIN32
-    DWORD res = SetFilePointer(hfout,0,0,FILE_CURRENT);
-    ocanseek = (res!=0xFFFFFFFF);
-    if (ocanseek) ooffset=res; else ooffset=0;
+    LONG high=0; DWORD res = SetFilePointer(hfout,0,&high,FILE_CURRENT);
+    ocanseek = (res!=0xFFFFFFFF || GetLastError()==NO_ERROR);
+    if (ocanseek) ooffset=((uzoff_t)(DWORD)high<<32) | res; else ooffset=0;
 #else
     (void)len;
-    int res = fseek((FILE*)hfout, 0, SEEK_CUR);
+    int res = fseeko((FILE*)hfout, 0, SEEK_CUR);
     ocanseek = (res == 0);
-    if (ocanseek) ooffset=ftell((FILE*)hfout); else ooffset=0;
+    if (ocanseek) ooffset=ftello((FILE*)hfout); else ooffset=0;
 #endif
 
     return ZR_OK;
@@ -2421,6 +3182,15 @@ ZRESULT TZip::Create(void *z,unsigned int len,DWORD flags)
     mustclosehfout=true;
     return ZR_OK;
   }
+  else if (flags==ZIP_WRITER)
+  { const TZipWriter *w = (const TZipWriter*)z;
+    if (w==0 || w->func==0) return ZR_ARGS;
+    wfunc=w->func; wparam=w->param;
+    wbuf=new char[ZIP_WRITER_BUFFER]; wlen=0;
+    ocanseek=false;
+    ooffset=0;
+    return ZR_OK;
+  }
 #ifdef _WIN32
   else if (flags==ZIP_MEMORY)
   {
@@ -2443,13 +3213,13 @@ ZRESULT TZip::Create(void *z,unsigned int len,DWORD flags)
   else return ZR_ARGS;
 }
 
-unsigned TZip::sflush(void *param,const char *buf, unsigned *size)
-{ // static
-  if (*size==0) return 0;
+bool TZip::scodecout(void *param,const char *buf, unsigned int len)
+{ // static: the deflate engine's output, which makes up the compressed size
   TZip *zip = (TZip*)param;
-  unsigned int writ = zip->write(buf,*size);
-  if (writ!=0) *size=0;
-  return writ;
+  if (len==0) return true;
+  if (zip->write(buf,len)!=len) return false;
+  zip->csize += len;
+  return true;
 }
 unsigned TZip::swrite(void *param,const char *buf, unsigned size)
 { // static
@@ -2481,22 +3251,41 @@ unsigned int TZip::write(const char *buf,unsigned int size)
 #endif  // _WIN32
     return writ;
   }
+  else if (wfunc!=0)
+  { if (wlen+size>ZIP_WRITER_BUFFER && !wflush()) return 0;
+    if (size>=ZIP_WRITER_BUFFER)
+    { if (!wfunc(wparam,srcbuf,size)) {oerr=ZR_WRITE; return 0;}
+      return size;
+    }
+    memcpy(wbuf+wlen, srcbuf, size);
+    wlen+=size;
+    return size;
+  }
   oerr=ZR_NOTINITED; return 0;
 }
 
-bool TZip::oseek(unsigned int pos)
+bool TZip::wflush()
+{ // passes what's gathered for the write function, e.g. at the end of an item so the reader gets it now
+  if (wfunc==0 || wlen==0) return true;
+  unsigned int n=wlen; wlen=0;
+  if (!wfunc(wparam,wbuf,n)) {oerr=ZR_WRITE; return false;}
+  return true;
+}
+
+bool TZip::oseek(uzoff_t pos)
 { if (!ocanseek) {oerr=ZR_SEEK; return false;}
   if (obuf!=0)
   { if (pos>=mapsize) {oerr=ZR_MEMSIZE; return false;}
-    opos=pos;
+    opos=(unsigned int)pos;
     return true;
   }
   else if (hfout!=0)
   {
 #ifdef _WIN32
-    SetFilePointer(hfout,pos+ooffset,NULL,FILE_BEGIN);
+    LONG high=(LONG)((pos+ooffset)>>32);
+    SetFilePointer(hfout,(LONG)(pos+ooffset),&high,FILE_BEGIN);
 #else
-    fseek((FILE*)hfout, pos+ooffset, SEEK_SET);
+    fseeko((FILE*)hfout, (off_t)(pos+ooffset), SEEK_SET);
 #endif  // _WIN32
     return true;
   }
@@ -2507,18 +3296,21 @@ ZRESULT TZip::GetMemory(void **pbuf, unsigned long *plen)
 { // When the user calls GetMemory, they're presumably at the end
   // of all their adding. In any case, we have to add the central
   // directory now, otherwise the memory we tell them won't be complete.
+  if (streaming) StreamEnd();
   if (!hasputcen) AddCentral();
   hasputcen=true;
   if (pbuf!=NULL) *pbuf=(void*)obuf;
-  if (plen!=NULL) *plen=writ;
+  if (plen!=NULL) *plen=(unsigned long)writ;
   if (obuf==NULL) return ZR_NOTMMAP;
   return ZR_OK;
 }
 
 ZRESULT TZip::Close()
 { // if the directory hadn't already been added through a call to GetMemory,
-  // then we do it now
-  ZRESULT res=ZR_OK; if (!hasputcen) res=AddCentral(); hasputcen=true;
+  // then we do it now (and finish an item which is still being streamed)
+  ZRESULT res=ZR_OK; if (streaming) res=StreamEnd();
+  if (!hasputcen) {ZRESULT cres=AddCentral(); if (res==ZR_OK) res=cres;} hasputcen=true;
+  if (!wflush() && res==ZR_OK) res=ZR_WRITE;
 
 #ifdef _WIN32
   if (obuf!=0 && hmapout!=0) UnmapViewOfFile(obuf);
@@ -2535,6 +3327,7 @@ ZRESULT TZip::Close()
     #endif  // _WIN32
   }
   hfout=0; mustclosehfout=false;
+  wfunc=0; wparam=0;
   return res;
 }
 
@@ -2564,10 +3357,10 @@ ZRESULT TZip::open_handle(HANDLE hf,unsigned int len)
   if (hf==0) return ZR_ARGS;
 #ifdef _WIN32
   if (hf==INVALID_HANDLE_VALUE) return ZR_ARGS;
-  DWORD res = SetFilePointer(hfout,0,0,FILE_CURRENT);
+  DWORD res = SetFilePointer(hf,0,0,FILE_CURRENT);
   if (res!=0xFFFFFFFF)
 #else
-  int res = fseek((FILE*)hfout,0,SEEK_CUR);
+  int res = fseek((FILE*)hf,0,SEEK_CUR);
   if (res==0)
 #endif // _WIN32
   { ZRESULT res = GetFileInfo(hf,&attr,&isize,&times,&timestamp);
@@ -2640,12 +3433,6 @@ ZRESULT TZip::open_dir()
   return ZR_OK;
 }
 
-unsigned TZip::sread(TState &s,char *buf,unsigned size)
-{ // static
-  TZip *zip = (TZip*)s.param;
-  return zip->read(buf,size);
-}
-
 unsigned TZip::read(char *buf, unsigned size)
 { if (bufin!=0)
   { if (posin>=lenin) return 0; // end of input
@@ -2670,6 +3457,7 @@ unsigned TZip::read(char *buf, unsigned size)
     crc = crc32(crc, (uch*)buf, red);
     return red;
   }
+  else if (streaming) return 0; // nothing has been pushed yet
   else {oerr=ZR_NOTINITED; return 0;}
 }
 
@@ -2691,30 +3479,46 @@ ZRESULT TZip::iclose()
 
 
 
-ZRESULT TZip::ideflate(TZipFileInfo *zfi)
-{ if (state==0) state=new TState();
-  // It's a very big object! 500k! We allocate it on the heap, because PocketPC's
-  // stack breaks if we try to put it all on the stack. It will be deleted lazily
-  state->err=0;
-  state->readfunc=sread; state->flush_outbuf=sflush;
-  state->param=this; state->level=8; state->seekable=iseekable; state->err=NULL;
-  // the following line will make ct_init realise it has to perform the init
-  state->ts.static_dtree[0].dl.len = 0;
-  // Thanks to Alvin77 for this crucial fix:
-  state->ds.window_size=0;
-  //  I think that covers everything that needs to be initted.
-  //
-  bi_init(*state,buf, sizeof(buf), TRUE); // it used to be just 1024-size, not 16384 as here
-  ct_init(*state,&zfi->att);
-  lm_init(*state,state->level, &zfi->flg);
-  ulg sz = deflate(*state);
-  csize=sz;
-  ZRESULT r=ZR_OK; if (state->err!=NULL) r=ZR_FLATE;
-  return r;
+ZRESULT TZip::usecodec()
+{ if (codec!=0) return ZR_OK;
+  if (codecid==ZIP_CODEC_BUILTIN && threads>1) codec = new TParallelDeflateCodec(threads);
+  else codec = NewZipCodec(codecid);
+  owncodec = true;
+  return codec!=0 ? ZR_OK : ZR_NOCODEC;
+}
+
+ZRESULT TZip::ideflateinit(TZipFileInfo *zfi, int ilevel)
+{ ZRESULT r = usecodec(); if (r!=ZR_OK) return r;
+  if (ilevel<=2) zfi->flg |= FAST; else if (ilevel>=8) zfi->flg |= SLOW;
+  csize=0;
+  if (!codec->Begin(ilevel,scodecout,this)) return oerr!=ZR_OK ? oerr : ZR_FLATE;
+  return ZR_OK;
+}
+
+ZRESULT TZip::ideflate(TZipFileInfo *zfi, int ilevel)
+{ // the input is pushed into the engine: an item in memory in one piece, others as they're read
+  ZRESULT r = ideflateinit(zfi,ilevel); if (r!=ZR_OK) return r;
+  bool ok;
+  if (bufin!=0)
+  { unsigned int len = lenin-posin;
+    if (len>0) crc = crc32(crc, (const uch*)bufin+posin, len);
+    ired += len;
+    ok = codec->Write(bufin+posin,len,true);
+    posin = lenin;
+  }
+  else
+  { for (;;)
+    { unsigned int cin=read(buf,sizeof(buf)); if (cin==(unsigned int)EOF) cin=0;
+      ok = codec->Write(buf,cin,cin==0);
+      if (!ok || cin==0) break;
+    }
+  }
+  if (oerr!=ZR_OK) return oerr;
+  return ok ? ZR_OK : ZR_FLATE;
 }
 
 ZRESULT TZip::istore()
-{ ulg size=0;
+{ uzoff_t size=0;
   for (;;)
   { unsigned int cin=read(buf,16384); if (cin<=0 || cin==(unsigned int)EOF) break;
     unsigned int cout = write(buf,cin); if (cout!=cin) return ZR_MISSIZE;
@@ -2724,40 +3528,84 @@ ZRESULT TZip::istore()
   return ZR_OK;
 }
 
+ZRESULT TZip::iraw(TZipFileInfo *zfi, int ilevel)
+{ // the content has been deflated already, so the data is just copied (and encrypted)
+  if (ilevel<=2) zfi->flg |= FAST; else if (ilevel>=8) zfi->flg |= SLOW;
+  unsigned int cout = write(bufin,lenin); if (cout!=lenin) return ZR_WRITE;
+  posin=lenin; csize=lenin;
+  crc=rawcrc; ired=isize;
+  return ZR_OK;
+}
+
+ZRESULT TZip::istoreblocks(const char *src, unsigned int len, bool last)
+{ // a streamed item of level 0 is deflated as stored blocks: each is just a 5-byte header
+  // (final flag, len, ~len) and the bytes, and the stream stays byte-aligned between them
+  if (len>0) crc = crc32(crc, (const uch*)src, len); // (crc32 of NULL is 0)
+  ired += len;
+  do
+  { unsigned int n = len>0xFFFF ? 0xFFFF : len;
+    char h[5]; h[0]=(char)(last && n==len);
+    h[1]=(char)(n&0xFF); h[2]=(char)(n>>8); h[3]=(char)~h[1]; h[4]=(char)~h[2];
+    if (write(h,5)!=5) return ZR_WRITE;
+    if (n>0 && write(src,n)!=n) return ZR_WRITE;
+    csize += 5+n; src+=n; len-=n;
+  } while (len>0);
+  return ZR_OK;
+}
 
+// ZIP_LEVEL_ADAPTIVE deflates the sample into nowhere, just counting the bytes
+static bool samplecount(void *param,const char *,unsigned int len)
+{ *(uzoff_t*)param += len;
+  return true;
+}
 
+int TZip::samplelevel(const char *sample, unsigned int len)
+{ // the cost of a level is the time to compress the sample plus the time to output the result
+  static const int levels[] = {1, 3, 6, 9};
+  if (len==0 || usecodec()!=ZR_OK) return ZIP_LEVEL_DEFAULT;
+  int best=0; double bestcost=len/adaptrate; // storing it costs no compression time
+  for (unsigned int i=0; i<sizeof(levels)/sizeof(levels[0]); i++)
+  { uzoff_t out=0;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    if (!codec->Begin(levels[i],samplecount,&out) || !codec->Write(sample,len,true)) continue;
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+    double cost = secs + out/adaptrate;
+    if (cost<bestcost) {best=levels[i]; bestcost=cost;}
+  }
+  return best;
+}
 
+int TZip::adaptivelevel()
+{ // picks the level for the input that has just been opened, and puts the input back
+  if (isize>=0 && isize<ZIP_SAMPLE_MIN) return ZIP_LEVEL_DEFAULT;
+  if (bufin!=0) return samplelevel(bufin, lenin<ZIP_SAMPLE_SIZE ? lenin : ZIP_SAMPLE_SIZE);
+  if (hfin==0 || !iseekable) return ZIP_LEVEL_DEFAULT; // a pipe can't be read twice
+  char *sample = new char[ZIP_SAMPLE_SIZE];
+  DWORD red=0;
+#ifdef _WIN32
+  LONG high=0; DWORD low=SetFilePointer(hfin,0,&high,FILE_CURRENT);
+  BOOL ok = ReadFile(hfin,sample,ZIP_SAMPLE_SIZE,&red,NULL);
+  SetFilePointer(hfin,(LONG)low,&high,FILE_BEGIN);
+#else
+  off_t pos = ftello((FILE*)hfin);
+  red = fread(sample, 1, ZIP_SAMPLE_SIZE, (FILE*)hfin);
+  BOOL ok = (ferror((FILE*)hfin) == 0);
+  fseeko((FILE*)hfin, pos, SEEK_SET);
+#endif  // _WIN32
+  int l = ok ? samplelevel(sample,red) : ZIP_LEVEL_DEFAULT;
+  delete[] sample;
+  return l;
+}
 
-bool has_seeded=false;
-ZRESULT TZip::Add(const char *odstzn, void *src,unsigned int len, DWORD flags)
-{ if (oerr) return ZR_FAILED;
-  if (hasputcen) return ZR_ENDED;
 
-  // if we use password encryption, then every isize and csize is 12 bytes bigger
-  int passex=0; if (password!=0 && flags!=ZIP_FOLDER) passex=12;
 
-  // zip has its own notion of what its names should look like: i.e. dir/file.stuff
-  char dstzn[MAX_PATH]; strcpy(dstzn,odstzn);
-  if (*dstzn==0) return ZR_ARGS;
-  char *d=dstzn; while (*d!=0) {if (*d=='\\') *d='/'; d++;}
-  bool isdir = (flags==ZIP_FOLDER);
-  bool needs_trailing_slash = (isdir && dstzn[strlen(dstzn)-1]!='/');
-  int method=DEFLATE; if (isdir || HasZipSuffix(dstzn)) method=STORE;
 
-  // now open whatever was our input source:
-  ZRESULT openres;
-  if (flags==ZIP_FILENAME) openres=open_file((const char *)src);
-  else if (flags==ZIP_HANDLE) openres=open_handle((HANDLE)src,len);
-  else if (flags==ZIP_MEMORY) openres=open_mem(src,len);
-  else if (flags==ZIP_FOLDER) openres=open_dir();
-  else return ZR_ARGS;
-  if (openres!=ZR_OK) return openres;
 
-  // A zip "entry" consists of a local header (which includes the file name),
-  // then the compressed data, and possibly an extended local header.
+bool has_seeded=false;
 
-  // Initialize the local header
-  TZipFileInfo zfi; zfi.nxt=NULL;
+void TZip::initfileinfo(TZipFileInfo &zfi, const char *dstzn, bool needs_trailing_slash, bool isdir, int method, int passex, char *xloc, char *xcen, bool zip64)
+{ // Initialize the local header
+  zfi.nxt=NULL;
   strcpy(zfi.name,"");
   strcpy(zfi.iname,dstzn);
 
@@ -2779,16 +3627,16 @@ ZRESULT TZip::Add(const char *odstzn, void *src,unsigned int len, DWORD flags)
   if (password!=0 && !isdir) zfi.flg=9;  // and 1 means 'password-encrypted'
   zfi.lflg = zfi.flg;     // to be updated later
   zfi.how = (ush)method;  // to be updated later
-  zfi.siz = (ulg)(method==STORE && isize>=0 ? isize+passex : 0); // to be updated later
-  zfi.len = (ulg)(isize);  // to be updated later
+  zfi.siz = (uzoff_t)(method==STORE && isize>=0 ? isize+passex : 0); // to be updated later
+  zfi.len = (uzoff_t)(isize>=0 ? isize : 0);  // to be updated later
   zfi.dsk = 0;
   zfi.atx = attr;
   zfi.off = writ+ooffset;         // offset within file of the start of this local record
   // stuff the 'times' structure into zfi.extra
 
   // nb. apparently there's a problem with PocketPC CE(zip)->CE(unzip) fails. And removing the following block fixes it up.
-  char xloc[EB_L_UT_SIZE]; zfi.extra=xloc;  zfi.ext=EB_L_UT_SIZE;
-  char xcen[EB_C_UT_SIZE]; zfi.cextra=xcen; zfi.cext=EB_C_UT_SIZE;
+  zfi.extra=xloc;  zfi.ext=EB_L_UT_SIZE;
+  zfi.cextra=xcen; zfi.cext=EB_C_UT_SIZE;
   xloc[0]  = 'U';
   xloc[1]  = 'T';
   xloc[2]  = EB_UT_LEN(3);       // length of data part of e.f.
@@ -2808,13 +3656,17 @@ ZRESULT TZip::Add(const char *odstzn, void *src,unsigned int len, DWORD flags)
   xloc[16] = (char)(times.ctime >> 24);
   memcpy(zfi.cextra,zfi.extra,EB_C_UT_SIZE);
   zfi.cextra[EB_LEN] = EB_UT_LEN(1);
+  // the sizes of a big item go into the Zip64 extra field after UT, filled by putlocal
+  zfi.zip64 = zip64;
+  if (zip64) {zfi.ext += EB_L_ZIP64_SIZE; zfi.ver = (ush)45;}
+}
 
-
-  // (1) Start by writing the local header:
+ZRESULT TZip::putheader(TZipFileInfo &zfi, bool isdir)
+{ // (1) Start by writing the local header:
   int r = putlocal(&zfi,swrite,this);
-  if (r!=ZE_OK) {iclose(); return ZR_WRITE;}
+  if (r!=ZE_OK) return ZR_WRITE;
   writ += 4 + LOCHEAD + (unsigned int)zfi.nam + (unsigned int)zfi.ext;
-  if (oerr!=ZR_OK) {iclose(); return oerr;}
+  if (oerr!=ZR_OK) return oerr;
 
   // (1.5) if necessary, write the encryption header
   keys[0]=305419896L;
@@ -2834,11 +3686,64 @@ ZRESULT TZip::Add(const char *odstzn, void *src,unsigned int len, DWORD flags)
   encbuf[11] = (char)((zfi.tim>>8)&0xff);
   for (int ei=0; ei<12; ei++) encbuf[ei]=zencode(keys,encbuf[ei]);
   if (password!=0 && !isdir) {swrite(this,encbuf,12); writ+=12;}
+  return ZR_OK;
+}
+
+void TZip::keepfileinfo(TZipFileInfo &zfi)
+{ // Keep a copy of the zipfileinfo, for our end-of-zip directory
+  char *cextra = new char[zfi.cext]; memcpy(cextra,zfi.cextra,zfi.cext); zfi.cextra=cextra;
+  TZipFileInfo *pzfi = new TZipFileInfo; memcpy(pzfi,&zfi,sizeof(zfi));
+  if (zfis==NULL) zfis=pzfi;
+  else {TZipFileInfo *z=zfis; while (z->nxt!=NULL) z=z->nxt; z->nxt=pzfi;}
+}
+
+ZRESULT TZip::Add(const char *odstzn, void *src,unsigned int len, DWORD flags)
+{ if (oerr) return ZR_FAILED;
+  if (hasputcen) return ZR_ENDED;
+  if (streaming) return ZR_STREAMING;
+
+  // if we use password encryption, then every isize and csize is 12 bytes bigger
+  int passex=0; if (password!=0 && flags!=ZIP_FOLDER) passex=12;
+
+  // zip has its own notion of what its names should look like: i.e. dir/file.stuff
+  char dstzn[MAX_PATH]; strcpy(dstzn,odstzn);
+  if (*dstzn==0) return ZR_ARGS;
+  char *d=dstzn; while (*d!=0) {if (*d=='\\') *d='/'; d++;}
+  bool isdir = (flags==ZIP_FOLDER);
+  bool needs_trailing_slash = (isdir && dstzn[strlen(dstzn)-1]!='/');
+  int method=DEFLATE; if (isdir || (flags!=ZIP_DEFLATED && (HasZipSuffix(dstzn) || level==ZIP_LEVEL_STORE))) method=STORE;
+
+  // now open whatever was our input source:
+  ZRESULT openres;
+  if (flags==ZIP_FILENAME) openres=open_file((const char *)src);
+  else if (flags==ZIP_HANDLE) openres=open_handle((HANDLE)src,len);
+  else if (flags==ZIP_MEMORY || flags==ZIP_DEFLATED) openres=open_mem(src,len);
+  else if (flags==ZIP_FOLDER) openres=open_dir();
+  else return ZR_ARGS;
+  if (openres!=ZR_OK) return openres;
+  int ilevel=level;
+  if (flags==ZIP_DEFLATED) {isize=(zoff_t)rawsize; if (ilevel<=ZIP_LEVEL_STORE) ilevel=ZIP_LEVEL_DEFAULT;} // the level only sets the flags
+  else if (method==DEFLATE && ilevel==ZIP_LEVEL_ADAPTIVE) ilevel=adaptivelevel();
+  if (ilevel==ZIP_LEVEL_STORE) method=STORE;
+
+  // A zip "entry" consists of a local header (which includes the file name),
+  // then the compressed data, and possibly an extended local header.
+
+  // Initialize the local header
+  TZipFileInfo zfi;
+  char xloc[EB_L_UT_SIZE+EB_L_ZIP64_SIZE], xcen[EB_C_UT_SIZE];
+  bool zip64 = (isize>=0 && (uzoff_t)isize+passex>=ZIP64_LOCAL_LIMIT);
+  initfileinfo(zfi,dstzn,needs_trailing_slash,isdir,method,passex,xloc,xcen,zip64);
+
+  // (1) Start by writing the local header, and the encryption header if necessary
+  ZRESULT hres = putheader(zfi,isdir);
+  if (hres!=ZR_OK) {iclose(); return hres;}
 
   //(2) Write deflated/stored file to zip file
   ZRESULT writeres=ZR_OK;
   encwriting = (password!=0 && !isdir);  // an object member variable to say whether we write to disk encrypted
-  if (!isdir && method==DEFLATE) writeres=ideflate(&zfi);
+  if (!isdir && flags==ZIP_DEFLATED) writeres=iraw(&zfi,ilevel);
+  else if (!isdir && method==DEFLATE) writeres=ideflate(&zfi,ilevel);
   else if (!isdir && method==STORE) writeres=istore();
   else if (isdir) csize=0;
   encwriting = false;
@@ -2852,7 +3757,10 @@ ZRESULT TZip::Add(const char *odstzn, void *src,unsigned int len, DWORD flags)
   zfi.crc = crc;
   zfi.siz = csize+passex;
   zfi.len = isize;
-  if (ocanseek && (password==0 || isdir))
+  // (the sizes of an item of unknown size may have outgrown the local header without Zip64)
+  bool header_fits = zfi.zip64 || (zfi.siz<ZIP64_LIMIT && zfi.len<ZIP64_LIMIT);
+  int r;
+  if (ocanseek && (password==0 || isdir) && header_fits)
   { zfi.how = (ush)method;
     if ((zfi.flg & 1) == 0) zfi.flg &= ~8; // clear the extended local header flag
     zfi.lflg = zfi.flg;
@@ -2866,23 +3774,132 @@ ZRESULT TZip::Add(const char *odstzn, void *src,unsigned int len, DWORD flags)
     if (zfi.how != (ush) method) return ZR_NOCHANGE;
     if (method==STORE && !first_header_has_size_right) return ZR_NOCHANGE;
     if ((r = putextended(&zfi, swrite,this)) != ZE_OK) return ZR_WRITE;
-    writ += 16L;
+    writ += extendedsize(&zfi);
     zfi.flg = zfi.lflg; // if flg modified by inflate, for the central index
   }
   if (oerr!=ZR_OK) return oerr;
 
-  // Keep a copy of the zipfileinfo, for our end-of-zip directory
-  char *cextra = new char[zfi.cext]; memcpy(cextra,zfi.cextra,zfi.cext); zfi.cextra=cextra;
-  TZipFileInfo *pzfi = new TZipFileInfo; memcpy(pzfi,&zfi,sizeof(zfi));
-  if (zfis==NULL) zfis=pzfi;
-  else {TZipFileInfo *z=zfis; while (z->nxt!=NULL) z=z->nxt; z->nxt=pzfi;}
+  keepfileinfo(zfi);
+  if (!wflush()) return oerr;
+  return ZR_OK;
+}
+
+ZRESULT TZip::AddDeflated(const char *odstzn, void *src, unsigned int len, ulg crc, uzoff_t size)
+{ rawcrc=crc; rawsize=size;
+  return Add(odstzn,src,len,ZIP_DEFLATED);
+}
+
+ZRESULT TZip::StreamBegin(const char *odstzn)
+{ if (oerr) return ZR_FAILED;
+  if (hasputcen) return ZR_ENDED;
+  if (streaming) return ZR_STREAMING;
+
+  int passex=0; if (password!=0) passex=12;
+  char dstzn[MAX_PATH]; strcpy(dstzn,odstzn);
+  if (*dstzn==0) return ZR_ARGS;
+  char *d=dstzn; while (*d!=0) {if (*d=='\\') *d='/'; d++;}
+
+  // the input is pushed by StreamWrite, so it's like an item from a pipe of unknown size
+  hfin=0; bufin=0; selfclosehf=false; crc=CRCVAL_INITIAL; csize=0; ired=0;
+  lenin=0; posin=0;
+  attr= 0x80000000; // just a normal file
+  isize = -1;
+  iseekable=false;
+#ifdef _WIN32
+    SYSTEMTIME st; GetLocalTime(&st);
+    FILETIME ft;   SystemTimeToFileTime(&st,&ft);
+    WORD dosdate,dostime; filetime2dosdatetime(ft,&dosdate,&dostime);
+    timestamp = (WORD)dostime | (((DWORD)dosdate)<<16);
+    times.atime = filetime2timet(ft);
+#else
+    times.atime = time(NULL);
+    times.mtime = times.atime;
+    times.ctime = times.atime;
+    timestamp = 0;
+#endif  // _WIN32
+
+  // The sizes and crc are unknown until the end, so they always go into
+  // the extended local header (data descriptor) and the zip is never seeked.
+  initfileinfo(szfi,dstzn,false,false,DEFLATE,passex,sxloc,sxcen,false);
+  ZRESULT hres = putheader(szfi,false);
+  if (hres!=ZR_OK) return hres;
+
+  streaming = true;
+  encwriting = (password!=0);
+  slevel = level; // an adaptive level is chosen by the first StreamWrite
+  ZRESULT r = ZR_OK;
+  if (slevel>ZIP_LEVEL_STORE) r=ideflateinit(&szfi,slevel);
+  if (oerr!=ZR_OK) r=oerr;
+  if (r!=ZR_OK) {streaming=false; encwriting=false; return r;}
+  return ZR_OK;
+}
+
+ZRESULT TZip::StreamWrite(const void *src, unsigned int len)
+{ if (!streaming) return ZR_ARGS;
+  if (oerr) return ZR_FAILED;
+  if (len==0) return ZR_OK;
+  if (slevel==ZIP_LEVEL_ADAPTIVE)
+  { slevel = samplelevel((const char*)src, len<ZIP_SAMPLE_SIZE ? len : ZIP_SAMPLE_SIZE);
+    if (slevel>ZIP_LEVEL_STORE)
+    { ZRESULT r = ideflateinit(&szfi,slevel);
+      if (r!=ZR_OK) {if (oerr==ZR_OK) oerr=r; return r;}
+    }
+  }
+  encwriting = (password!=0);
+  if (slevel==ZIP_LEVEL_STORE)
+  { ZRESULT r = istoreblocks((const char*)src,len,false);
+    encwriting = false;
+    if (r!=ZR_OK) {if (oerr==ZR_OK) oerr=r; return r;}
+    return ZR_OK;
+  }
+  crc = crc32(crc, (const uch*)src, len);
+  ired += len;
+  bool ok = codec->Write((const char*)src,len,false);
+  encwriting = false;
+  if (oerr!=ZR_OK) return oerr;
+  if (!ok) {oerr=ZR_FLATE; return ZR_FLATE;}
+  return ZR_OK;
+}
+
+ZRESULT TZip::StreamEnd()
+{ if (!streaming) return ZR_ARGS;
+  if (oerr) {streaming=false; return ZR_FAILED;}
+  if (slevel==ZIP_LEVEL_ADAPTIVE) slevel=ZIP_LEVEL_STORE; // nothing was written: one empty stored block
+  encwriting = (password!=0);
+  if (slevel==ZIP_LEVEL_STORE)
+  { ZRESULT r = istoreblocks(0,0,true);
+    encwriting = false; streaming = false;
+    if (r!=ZR_OK) return r;
+  }
+  else
+  { bool ok = codec->Write(0,0,true);
+    encwriting = false;
+    streaming = false;
+    if (oerr!=ZR_OK) return oerr;
+    if (!ok) return ZR_FLATE;
+  }
+  isize=ired;
+  writ += csize;
+  if (oerr!=ZR_OK) return oerr;
+
+  int passex=0; if (password!=0) passex=12;
+  szfi.crc = crc;
+  szfi.siz = csize+passex;
+  szfi.len = isize;
+  if (putextended(&szfi, swrite,this) != ZE_OK) return ZR_WRITE;
+  writ += extendedsize(&szfi);
+  szfi.flg = szfi.lflg; // if flg modified by inflate, for the central index
+  if (oerr!=ZR_OK) return oerr;
+
+  keepfileinfo(szfi);
+  if (!wflush()) return oerr;
   return ZR_OK;
 }
 
 ZRESULT TZip::AddCentral()
 { // write central directory
-  int numentries = 0;
-  ulg pos_at_start_of_central = writ;
+  uzoff_t numentries = 0;
+  uzoff_t pos_at_start_of_central = writ;
   //ulg tot_unc_size=0, tot_compressed_size=0;
   bool okay=true;
   for (TZipFileInfo *zfi=zfis; zfi!=NULL; )
@@ -2890,7 +3907,8 @@ ZRESULT TZip::AddCentral()
     { int res = putcentral(zfi, swrite,this);
       if (res!=ZE_OK) okay=false;
     }
-    writ += 4 + CENHEAD + (unsigned int)zfi->nam + (unsigned int)zfi->cext + (unsigned int)zfi->com;
+    char x64[EB_C_ZIP64_SIZE];
+    writ += 4 + CENHEAD + zfi->nam + zfi->cext + zip64central(zfi,x64) + zfi->com;
     //tot_unc_size += zfi->len;
     //tot_compressed_size += zfi->siz;
     numentries++;
@@ -2900,10 +3918,11 @@ ZRESULT TZip::AddCentral()
     delete zfi;
     zfi = zfinext;
   }
-  ulg center_size = writ - pos_at_start_of_central;
+  uzoff_t center_size = writ - pos_at_start_of_central;
   if (okay)
   { int res = putend(numentries, center_size, pos_at_start_of_central+ooffset, 0, NULL, swrite,this);
     if (res!=ZE_OK) okay=false;
+    if (needzip64end(numentries, center_size, pos_at_start_of_central+ooffset)) writ += 4 + ZIP64ENDHEAD + 4 + ZIP64LOCHEAD;
     writ += 4 + ENDHEAD + 0;
   }
   if (!okay) return ZR_WRITE;
@@ -2914,7 +3933,8 @@ ZRESULT TZip::AddCentral()
 
 
 
-ZRESULT lasterrorZ=ZR_OK;
+// per thread, so that archives made at once on different threads do not overwrite the results of each other
+thread_local ZRESULT lasterrorZ=ZR_OK;
 
 unsigned int FormatZipMessageZ(ZRESULT code, char *buf,unsigned int len)
 { if (code==ZR_RECENT) code=lasterrorZ;
@@ -2936,6 +3956,8 @@ unsigned int FormatZipMessageZ(ZRESULT code, char *buf,unsigned int len)
     case ZR_FAILED: msg="Caller: there was a previous error"; break;
     case ZR_ENDED: msg="Caller: additions to the zip have already been ended"; break;
     case ZR_ZMODE: msg="Caller: mixing creation and opening of zip"; break;
+    case ZR_STREAMING: msg="Caller: an item is still being streamed"; break;
+    case ZR_NOCODEC: msg="Caller: that deflate engine wasn't compiled in"; break;
     case ZR_NOTINITED: msg="Zip-bug: internal initialisation not completed"; break;
     case ZR_SEEK: msg="Zip-bug: trying to seek the unseekable"; break;
     case ZR_MISSIZE: msg="Zip-bug: the anticipated size turned out wrong"; break;
@@ -2967,6 +3989,10 @@ HZIP CreateZipInternal(void *z,unsigned int len,DWORD flags, const char *passwor
 HZIP CreateZipHandle(HANDLE h, const char *password) {return CreateZipInternal(h,0,ZIP_HANDLE,password);}
 HZIP CreateZip(const char *fn, const char *password) {return CreateZipInternal((void*)fn,0,ZIP_FILENAME,password);}
 HZIP CreateZip(void *z,unsigned int len, const char *password) {return CreateZipInternal(z,len,ZIP_MEMORY,password);}
+HZIP CreateZipWriter(ZIPWRITEFUNC write, void *param, const char *password)
+{ TZipWriter w; w.func=write; w.param=param;
+  return CreateZipInternal(&w,0,ZIP_WRITER,password);
+}
 
 
 ZRESULT ZipAddInternal(HZIP hz,const char *dstzn, void *src,unsigned int len, DWORD flags)
@@ -2982,6 +4008,89 @@ ZRESULT ZipAdd(HZIP hz,const char *dstzn, void *src,unsigned int len) {return Zi
 ZRESULT ZipAddHandle(HZIP hz,const char *dstzn, HANDLE h) {return ZipAddInternal(hz,dstzn,h,0,ZIP_HANDLE);}
 ZRESULT ZipAddHandle(HZIP hz,const char *dstzn, HANDLE h, unsigned int len) {return ZipAddInternal(hz,dstzn,h,len,ZIP_HANDLE);}
 ZRESULT ZipAddFolder(HZIP hz,const char *dstzn) {return ZipAddInternal(hz,dstzn,0,0,ZIP_FOLDER);}
+ZRESULT ZipAddDeflated(HZIP hz,const char *dstzn, void *src,unsigned int len, unsigned long crc, unsigned long long size)
+{ if (hz==0) {lasterrorZ=ZR_ARGS;return ZR_ARGS;}
+  TZipHandleData *han = (TZipHandleData*)hz;
+  if (han->flag!=2) {lasterrorZ=ZR_ZMODE;return ZR_ZMODE;}
+  lasterrorZ = han->zip->AddDeflated(dstzn,src,len,(ulg)crc,(uzoff_t)size);
+  return lasterrorZ;
+}
+
+TZip *GetZipInternal(HZIP hz)
+{ if (hz==0) {lasterrorZ=ZR_ARGS;return 0;}
+  TZipHandleData *han = (TZipHandleData*)hz;
+  if (han->flag!=2) {lasterrorZ=ZR_ZMODE;return 0;}
+  return han->zip;
+}
+ZRESULT ZipAddStreamBegin(HZIP hz,const char *dstzn)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  lasterrorZ = zip->StreamBegin(dstzn);
+  return lasterrorZ;
+}
+ZRESULT ZipAddStreamWrite(HZIP hz,const void *src,unsigned int len)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  lasterrorZ = zip->StreamWrite(src,len);
+  return lasterrorZ;
+}
+ZRESULT ZipAddStreamEnd(HZIP hz)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  lasterrorZ = zip->StreamEnd();
+  return lasterrorZ;
+}
+unsigned long ZipCrc32(unsigned long crc, const void *buf, unsigned int len)
+{ return crc32((ulg)crc,(const uch*)buf,len);
+}
+ZRESULT ZipSetLevel(HZIP hz, int level)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  if (level<ZIP_LEVEL_ADAPTIVE || level>ZIP_LEVEL_BEST) {lasterrorZ=ZR_ARGS; return ZR_ARGS;}
+  zip->level = level;
+  lasterrorZ = ZR_OK;
+  return lasterrorZ;
+}
+ZRESULT ZipSetAdaptiveRate(HZIP hz, double bytespersec)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  if (!(bytespersec>0)) {lasterrorZ=ZR_ARGS; return ZR_ARGS;}
+  zip->adaptrate = bytespersec;
+  lasterrorZ = ZR_OK;
+  return lasterrorZ;
+}
+ZRESULT ZipSetCodec(HZIP hz, int codec)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  if (zip->streaming) {lasterrorZ=ZR_STREAMING; return ZR_STREAMING;}
+  lasterrorZ = ZR_OK;
+  if (codec==zip->codecid) return lasterrorZ;
+  TZipCodec *c = NewZipCodec(codec);
+  if (c==0) {lasterrorZ=ZR_NOCODEC; return ZR_NOCODEC;}
+  if (zip->owncodec) delete zip->codec;
+  zip->codec=c; zip->codecid=codec; zip->owncodec=true;
+  return lasterrorZ;
+}
+ZRESULT ZipGetCodec(HZIP hz, int *codec)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  *codec = zip->codecid;
+  lasterrorZ = ZR_OK;
+  return lasterrorZ;
+}
+ZRESULT ZipSetThreads(HZIP hz, unsigned int threads)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  if (zip->streaming) {lasterrorZ=ZR_STREAMING; return ZR_STREAMING;}
+  if (threads==0) threads=std::thread::hardware_concurrency();
+  if (threads==0) threads=1;
+  lasterrorZ = ZR_OK;
+  if (threads==zip->threads) return lasterrorZ;
+  zip->threads=threads;
+  if (zip->owncodec && zip->codecid==ZIP_CODEC_BUILTIN) {delete zip->codec; zip->codec=0;} // made again for the next item
+  return lasterrorZ;
+}
+ZRESULT ZipSetCustomCodec(HZIP hz, TZipCodec *codec)
+{ TZip *zip = GetZipInternal(hz); if (zip==0) return lasterrorZ;
+  if (codec==0) {lasterrorZ=ZR_ARGS; return ZR_ARGS;}
+  if (zip->streaming) {lasterrorZ=ZR_STREAMING; return ZR_STREAMING;}
+  if (zip->owncodec) delete zip->codec;
+  zip->codec=codec; zip->codecid=-1; zip->owncodec=false;
+  lasterrorZ = ZR_OK;
+  return lasterrorZ;
+}
 
 
 
@@ -25,6 +25,8 @@ typedef unsigned long ZRESULT;
 HZIP CreateZip(const char *fn, const char *password);
 HZIP CreateZip(void *buf,unsigned int len, const char *password);
 HZIP CreateZipHandle(HANDLE h, const char *password);
+typedef bool (*ZIPWRITEFUNC)(void *param, const char *buf, unsigned int len);
+HZIP CreateZipWriter(ZIPWRITEFUNC write, void *param, const char *password);
 // CreateZip - call this to start the creation of a zip file.
 // As the zip is being created, it will be stored somewhere:
 // to a pipe:              CreateZipHandle(hpipe_write);
@@ -32,11 +34,17 @@ HZIP CreateZipHandle(HANDLE h, const char *password);
 // in a file (by name):    CreateZip("c:\\test.zip");
 // in memory:              CreateZip(buf, len);
 // or in pagefile memory:  CreateZip(0, len);
+// through a function:     CreateZipWriter(write, param);
 // The final case stores it in memory backed by the system paging file,
 // where the zip may not exceed len bytes. This is a bit friendlier than
 // allocating memory with new[]: it won't lead to fragmentation, and the
 // memory won't be touched unless needed. That means you can give very
 // large estimates of the maximum-size without too much worry.
+// The function of CreateZipWriter gets all the bytes of the zip in order, e.g. to
+// append them to a growing buffer or to send them, and returns false to fail the
+// write. It can't seek, so the zip is made like one into a pipe (see below).
+// The bytes come in blocks of up to 64k, and each item is passed on as soon as
+// it's finished, so that a reader at the other end of a socket can start early.
 // As for the password, it lets you encrypt every file in the archive.
 // (This api doesn't support per-file encryption.)
 // Note: because pipes don't allow random access, the structure of a zipfile
@@ -75,6 +83,96 @@ ZRESULT ZipAddFolder(HZIP hz,const char *dstzn);
 // compressed item itself, which in turn makes it easier when unzipping the
 // zipfile from a pipe.
 
+ZRESULT ZipAddDeflated(HZIP hz, const char *dstzn, void *src, unsigned int len, unsigned long crc, unsigned long long size);
+// ZipAddDeflated - adds an item whose content has been deflated already, e.g.
+// by a TZipCodec on another thread: src,len is the raw deflate data, crc (see
+// ZipCrc32) and size are those of the content. The data is written as it is;
+// the level set by ZipSetLevel only goes into the header's flags.
+
+ZRESULT ZipAddStreamBegin(HZIP hz,const char *dstzn);
+ZRESULT ZipAddStreamWrite(HZIP hz,const void *src,unsigned int len);
+ZRESULT ZipAddStreamEnd(HZIP hz);
+// ZipAddStream - add an item whose content is produced piece by piece, e.g.
+// while it is being generated, instead of staging it in a file first.
+// Each piece is deflated as soon as it is written. The sizes and crc are not
+// known until the end, so they are stored after the item in an extended local
+// header (data descriptor) and the zip never has to be seeked back.
+// Only one item can be streamed at a time, and no other item can be added
+// until ZipAddStreamEnd (ZR_STREAMING). CloseZip ends an unfinished stream.
+//     ZipAddStreamBegin(hz,"xl/worksheets/sheet1.xml");
+//     while (...) ZipAddStreamWrite(hz,buf,len);
+//     ZipAddStreamEnd(hz);
+// Items and zipfiles bigger than 4GB, or with more than 65535 items, get the
+// Zip64 extensions (extra fields, 64-bit data descriptor, Zip64 end record)
+// automatically; smaller zipfiles are written in the classic format.
+
+#define ZIP_LEVEL_STORE     0
+#define ZIP_LEVEL_FASTEST   1
+#define ZIP_LEVEL_DEFAULT   8
+#define ZIP_LEVEL_BEST      9
+#define ZIP_LEVEL_ADAPTIVE  (-1)
+ZRESULT ZipSetLevel(HZIP hz, int level);
+ZRESULT ZipSetAdaptiveRate(HZIP hz, double bytespersec);
+// ZipSetLevel - sets the compression level of the items added after the call:
+// 0 stores them, 1..9 deflate them from the fastest to the smallest (8 is the
+// default). A streamed item of level 0 is deflated as stored blocks, so that it
+// can still be written without seeking. Items with a zip suffix are always stored.
+// ZIP_LEVEL_ADAPTIVE compresses a sample from the start of each item (the first
+// piece of a streamed one) at a few levels, and takes the level that minimises
+// the compression time plus the time to output the result at the rate given by
+// ZipSetAdaptiveRate (bytes per second). A slow output, e.g. a download, favours
+// the smaller results; a fast one favours speed. Small items get the default level.
+
+typedef bool (*ZIPCODECOUT)(void *param, const char *buf, unsigned int len);
+class TZipCodec
+{ public:
+  virtual ~TZipCodec() {}
+  virtual bool Begin(int level, ZIPCODECOUT out, void *param) = 0;
+  virtual bool Write(const char *buf, unsigned int len, bool last) = 0;
+};
+// TZipCodec - a deflate engine, which the zip hands the content of the items to.
+// Begin starts the raw deflate data (without a zlib or gzip wrapper) of an item
+// at level 1..9; Write compresses the next piece of it, or the last piece, which
+// may be empty, and finishes the data. The result is passed to out(param,...)
+// as it's made. They return false on failure, e.g. when out did. An engine is
+// used for one item at a time, and may be reused for any number of items.
+
+#define ZIP_CODEC_BUILTIN     0
+#define ZIP_CODEC_ZLIB        1
+#define ZIP_CODEC_LIBDEFLATE  2
+ZRESULT ZipSetCodec(HZIP hz, int codec);
+ZRESULT ZipSetCustomCodec(HZIP hz, TZipCodec *codec);
+TZipCodec *NewZipCodec(int codec);
+ZRESULT ZipGetCodec(HZIP hz, int *codec);
+// ZipSetCodec - sets the deflate engine of the items added after the call: the
+// one of this file, zlib's, or libdeflate's, which compresses an item in one
+// shot (so a streamed item is kept in memory until ZipAddStreamEnd). The other
+// libraries' engines are in zipcodec.cpp, compiled with ZIP_WITH_ZLIB or
+// ZIP_WITH_LIBDEFLATE; without them ZipSetCodec returns ZR_NOCODEC. A new zip
+// has the engine ZIP_CODEC_DEFAULT, which zip.cpp may be compiled with (it's
+// ZIP_CODEC_BUILTIN otherwise). ZipSetCustomCodec plugs in any other engine;
+// it stays the caller's, who mustn't delete it before CloseZip.
+// NewZipCodec - a new engine, e.g. to compare them, or NULL if it's not compiled
+// in. The caller deletes it.
+// ZipGetCodec - the engine the zip deflates with, -1 for a custom one.
+
+ZRESULT ZipSetThreads(HZIP hz, unsigned int threads);
+// ZipSetThreads - deflates the items with the built-in engine on this many
+// threads (0 for one per cpu; 1, the default, deflates in the calling thread).
+// The content is cut into chunks of 256K, each deflated on its own with the end
+// of the previous one as dictionary, and ended on a byte boundary (an empty
+// stored block), so that the results just follow each other as a single deflate
+// stream. It's a little bigger, and the same for any number of threads. Level 9
+// parses each chunk twice, to learn its costs. The chunks in flight take up to
+// 2*threads*(256K+32K) of memory.
+
+unsigned long ZipCrc32(unsigned long crc, const void *buf, unsigned int len);
+// ZipCrc32 - the crc-32 which the zip stores for the items. Start with crc=0,
+// and pass the result back in to continue with the next piece. It's computed
+// with carry-less multiplication (PCLMULQDQ) where the cpu has it, and by
+// slicing-by-16 (slicing-by-8 on 32-bit cpus) otherwise. Compiling zip.cpp
+// with ZIP_NO_PCLMUL leaves out the former.
+
 ZRESULT ZipGetMemory(HZIP hz, void **buf, unsigned long *len);
 // ZipGetMemory - If the zip was created in memory, via ZipCreate(0,len),
 // then this function will return information about that memory block.
@@ -114,6 +212,8 @@ unsigned int FormatZipMessage(ZRESULT code, char *buf,unsigned int len);
 #define ZR_MISSIZE    0x00060000     // the indicated input file size turned out mistaken
 #define ZR_PARTIALUNZ 0x00070000     // the file had already been partially unzipped
 #define ZR_ZMODE      0x00080000     // tried to mix creating/opening a zip
+#define ZR_STREAMING  0x00090000     // tried to add an item while another one is still being streamed
+#define ZR_NOCODEC    0x000A0000     // the deflate engine asked for wasn't compiled in
 // The following come from bugs within the zip library itself
 #define ZR_BUGMASK    0xFF000000
 #define ZR_NOTINITED  0x01000000     // initialisation didn't work
@@ -0,0 +1,118 @@
+// Deflate engines of other libraries for the zip (see ZipSetCodec in zip.h),
+// and NewZipCodec which makes any of them. They're kept apart from zip.cpp,
+// whose deflate() and crc32() would clash with zlib's.
+//
+// ZIP_WITH_ZLIB        compiles ZIP_CODEC_ZLIB, to be linked with zlib (-lz)
+// ZIP_WITH_LIBDEFLATE  compiles ZIP_CODEC_LIBDEFLATE, to be linked with libdeflate (-ldeflate)
+
+#include <string.h>
+#include <vector>
+#include "zip.h"
+
+#ifdef ZIP_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ZIP_WITH_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+TZipCodec *NewBuiltinZipCodec(); // zip.cpp
+
+
+
+#ifdef ZIP_WITH_ZLIB
+// zlib's deflate, raw (negative window bits). The pieces are compressed as
+// they come; the stream is reset rather than reallocated for the next item.
+class TZlibCodec : public TZipCodec
+{ public:
+  TZlibCodec() : started(false), zlevel(0) {memset(&zs,0,sizeof(zs));}
+  ~TZlibCodec() {if (started) deflateEnd(&zs);}
+  bool Begin(int level, ZIPCODECOUT out, void *param);
+  bool Write(const char *buf, unsigned int len, bool last);
+
+  z_stream zs; bool started; int zlevel;
+  ZIPCODECOUT out; void *outparam;
+  char obuf[16384];
+};
+
+bool TZlibCodec::Begin(int level, ZIPCODECOUT o, void *param)
+{ if (level<1 || level>9) return false;
+  out=o; outparam=param;
+  if (started && level==zlevel) return deflateReset(&zs)==Z_OK;
+  if (started) deflateEnd(&zs);
+  memset(&zs,0,sizeof(zs));
+  started = deflateInit2(&zs,level,Z_DEFLATED,-MAX_WBITS,8,Z_DEFAULT_STRATEGY)==Z_OK;
+  zlevel=level;
+  return started;
+}
+
+bool TZlibCodec::Write(const char *buf, unsigned int len, bool last)
+{ if (!started) return false;
+  zs.next_in=(Bytef*)buf; zs.avail_in=len;
+  int r;
+  do
+  { zs.next_out=(Bytef*)obuf; zs.avail_out=sizeof(obuf);
+    r = deflate(&zs, last ? Z_FINISH : Z_NO_FLUSH);
+    if (r==Z_STREAM_ERROR) return false;
+    unsigned int n = sizeof(obuf)-zs.avail_out;
+    if (n>0 && !out(outparam,obuf,n)) return false;
+  } while (zs.avail_out==0 || (last && r!=Z_STREAM_END));
+  return true;
+}
+#endif  // ZIP_WITH_ZLIB
+
+
+
+#ifdef ZIP_WITH_LIBDEFLATE
+// libdeflate compresses a whole buffer in one call: an item that comes in one
+// piece (e.g. ZipAdd from memory) is compressed straight from it, the pieces of
+// others are gathered first. The compressor of the last level is kept.
+class TLibdeflateCodec : public TZipCodec
+{ public:
+  TLibdeflateCodec() : c(0), clevel(0) {}
+  ~TLibdeflateCodec() {if (c!=0) libdeflate_free_compressor(c);}
+  bool Begin(int level, ZIPCODECOUT out, void *param);
+  bool Write(const char *buf, unsigned int len, bool last);
+
+  struct libdeflate_compressor *c; int clevel;
+  ZIPCODECOUT out; void *outparam;
+  std::vector<char> pending, compressed;
+};
+
+bool TLibdeflateCodec::Begin(int level, ZIPCODECOUT o, void *param)
+{ if (level<1 || level>9) return false;
+  out=o; outparam=param; pending.clear();
+  if (c!=0 && level==clevel) return true;
+  if (c!=0) libdeflate_free_compressor(c);
+  c = libdeflate_alloc_compressor(level); clevel=level;
+  return c!=0;
+}
+
+bool TLibdeflateCodec::Write(const char *buf, unsigned int len, bool last)
+{ if (c==0) return false;
+  if (len>0 && (!last || !pending.empty())) pending.insert(pending.end(),buf,buf+len);
+  if (!last) return true;
+  const char *src = pending.empty() ? buf : &pending[0];
+  size_t srclen = pending.empty() ? len : pending.size();
+  compressed.resize(libdeflate_deflate_compress_bound(c,srclen));
+  size_t n = libdeflate_deflate_compress(c,src,srclen,&compressed[0],compressed.size());
+  std::vector<char>().swap(pending); // an item may be big, don't keep it
+  if (n==0) return false;
+  return out(outparam,&compressed[0],(unsigned int)n);
+}
+#endif  // ZIP_WITH_LIBDEFLATE
+
+
+
+TZipCodec *NewZipCodec(int codec)
+{ switch (codec)
+  { case ZIP_CODEC_BUILTIN: return NewBuiltinZipCodec();
+#ifdef ZIP_WITH_ZLIB
+    case ZIP_CODEC_ZLIB: return new TZlibCodec();
+#endif
+#ifdef ZIP_WITH_LIBDEFLATE
+    case ZIP_CODEC_LIBDEFLATE: return new TLibdeflateCodec();
+#endif
+    default: return 0;
+  }
+}